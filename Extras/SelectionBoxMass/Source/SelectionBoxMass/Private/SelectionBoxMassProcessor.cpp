@@ -0,0 +1,115 @@
+// Copyright 2021 Gareth Cross.
+#include "SelectionBoxMassProcessor.h"
+
+#include "MassCommonFragments.h"
+#include "MassCommonTypes.h"
+#include "MassExecutionContext.h"
+#include "SelectionBoxFunctionLibrary.h"
+#include "SelectionBoxMassSubsystem.h"
+#include "SelectionBoxMassTypes.h"
+
+namespace {
+
+// Boxes tested at a time. The default allocator of TBitArray holds this many bits inline, so neither the batch nor
+// the results touch the heap.
+constexpr int32 BlockSize = 128;
+
+// Batch of up to BlockSize boxes, on the stack (about 13KB).
+struct FBlockBatch {
+  TArray<FVector, TInlineAllocator<BlockSize>> Positions;
+  TArray<FQuat, TInlineAllocator<BlockSize>> Rotations;
+  TArray<FVector, TInlineAllocator<BlockSize>> Origins;
+  TArray<FVector, TInlineAllocator<BlockSize>> Extents;
+
+  void Reset() {
+    Positions.Reset();
+    Rotations.Reset();
+    Origins.Reset();
+    Extents.Reset();
+  }
+
+  // Same as FSelectionBoxBatchData::Add.
+  void Add(const FTransform& BoxTransform, const FVector& Origin, const FVector& Extent) {
+    const FVector Scale = BoxTransform.GetScale3D();
+    Positions.Add(BoxTransform.GetTranslation());
+    Rotations.Add(BoxTransform.GetRotation());
+    Origins.Add(Origin * Scale);
+    Extents.Add(Extent * Scale.GetAbs());
+  }
+
+  FSelectionBoxBatch GetView() const { return FSelectionBoxBatch{Positions, Rotations, Origins, Extents}; }
+};
+
+}  // namespace
+
+USelectionBoxMassProcessor::USelectionBoxMassProcessor() : EntityQuery(*this), SelectedQuery(*this) {
+  // Selection is made by the local player, so there is nothing to do on a dedicated server.
+  ExecutionFlags = static_cast<int32>(EProcessorExecutionFlags::Client | EProcessorExecutionFlags::Standalone);
+  ProcessingPhase = EMassProcessingPhase::PrePhysics;
+  // Test against this frame's transforms.
+  ExecutionOrder.ExecuteAfter.Add(UE::Mass::ProcessorGroupNames::Movement);
+}
+
+void USelectionBoxMassProcessor::ConfigureQueries() {
+  EntityQuery.AddRequirement<FTransformFragment>(EMassFragmentAccess::ReadOnly);
+  EntityQuery.AddRequirement<FSelectionBoxBoundsFragment>(EMassFragmentAccess::ReadOnly);
+  SelectedQuery.AddTagRequirement<FSelectionBoxSelectedTag>(EMassFragmentPresence::All);
+}
+
+void USelectionBoxMassProcessor::Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) {
+  USelectionBoxMassSubsystem* const Subsystem =
+      UWorld::GetSubsystem<USelectionBoxMassSubsystem>(EntityManager.GetWorld());
+  if (!Subsystem) {
+    return;
+  }
+  TRACE_CPUPROFILER_EVENT_SCOPE(USelectionBoxMassProcessor::Execute);
+  if (Subsystem->bClearPending) {
+    Subsystem->bClearPending = false;
+    SelectedQuery.ForEachEntityChunk(EntityManager, Context, [](FMassExecutionContext& ChunkContext) {
+      for (const FMassEntityHandle Entity : ChunkContext.GetEntities()) {
+        ChunkContext.Defer().RemoveTag<FSelectionBoxSelectedTag>(Entity);
+      }
+    });
+  }
+  if (!Subsystem->bHasRegion) {
+    return;
+  }
+
+  // Copied, so the chunks do not read the subsystem while game code may be changing it.
+  const FSelectionRegion Region = Subsystem->Region;
+  const FSelectionQueryOptions Options = Subsystem->Options;
+  const FRegionPlanes Planes = Region.ComputePlanes();
+  EntityQuery.ParallelForEachEntityChunk(EntityManager, Context, [&](FMassExecutionContext& ChunkContext) {
+    TRACE_CPUPROFILER_EVENT_SCOPE(USelectionBoxMassProcessor::Chunk);
+    const int32 NumEntities = ChunkContext.GetNumEntities();
+    const TConstArrayView<FTransformFragment> Transforms = ChunkContext.GetFragmentView<FTransformFragment>();
+    const TConstArrayView<FSelectionBoxBoundsFragment> Bounds =
+        ChunkContext.GetFragmentView<FSelectionBoxBoundsFragment>();
+
+    // Tested in blocks, so that the buffers have a fixed size and can live on the stack.
+    const bool bSelected = ChunkContext.DoesArchetypeHaveTag<FSelectionBoxSelectedTag>();
+    FBlockBatch Boxes;
+    TBitArray<> Overlapping;
+    for (int32 Start = 0; Start < NumEntities; Start += BlockSize) {
+      const int32 End = FMath::Min(Start + BlockSize, NumEntities);
+      Boxes.Reset();
+      for (int32 i = Start; i < End; ++i) {
+        Boxes.Add(Transforms[i].GetTransform(), Bounds[i].Origin, Bounds[i].Extent);
+      }
+      USelectionBoxFunctionLibrary::SelectionRegionOverlapsTransformedBoxBatch(Region, Planes, Boxes.GetView(),
+                                                                               Overlapping, Options);
+
+      // Only entities that change state need a command.
+      for (int32 i = Start; i < End; ++i) {
+        if (Overlapping[i - Start] == bSelected) {
+          continue;
+        }
+        if (bSelected) {
+          ChunkContext.Defer().RemoveTag<FSelectionBoxSelectedTag>(ChunkContext.GetEntity(i));
+        } else {
+          ChunkContext.Defer().AddTag<FSelectionBoxSelectedTag>(ChunkContext.GetEntity(i));
+        }
+      }
+    }
+  });
+}
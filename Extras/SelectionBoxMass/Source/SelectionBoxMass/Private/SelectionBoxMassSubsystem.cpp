@@ -0,0 +1,17 @@
+// Copyright 2021 Gareth Cross.
+#include "SelectionBoxMassSubsystem.h"
+
+void USelectionBoxMassSubsystem::SetSelectionRegion(const FSelectionRegion& InRegion,
+                                                    const FSelectionQueryOptions& InOptions) {
+  Region = InRegion;
+  Options = InOptions;
+  bHasRegion = true;
+  bClearPending = false;
+}
+
+void USelectionBoxMassSubsystem::ClearSelectionRegion() { bHasRegion = false; }
+
+void USelectionBoxMassSubsystem::ClearSelection() {
+  bHasRegion = false;
+  bClearPending = true;
+}
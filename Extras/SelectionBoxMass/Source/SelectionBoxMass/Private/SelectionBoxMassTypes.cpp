@@ -0,0 +1,11 @@
+// Copyright 2021 Gareth Cross.
+#include "SelectionBoxMassTypes.h"
+
+#include "MassCommonFragments.h"
+#include "MassEntityTemplateRegistry.h"
+
+void USelectionBoxMassTrait::BuildTemplate(FMassEntityTemplateBuildContext& BuildContext,
+                                           const UWorld& World) const {
+  BuildContext.RequireFragment<FTransformFragment>();
+  BuildContext.AddFragment_GetRef<FSelectionBoxBoundsFragment>() = Bounds;
+}
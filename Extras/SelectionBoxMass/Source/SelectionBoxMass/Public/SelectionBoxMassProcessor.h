@@ -0,0 +1,36 @@
+// Copyright 2021 Gareth Cross.
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityQuery.h"
+#include "MassProcessor.h"
+#include "SelectionBoxMassProcessor.generated.h"
+
+/**
+ * Applies the region of USelectionBoxMassSubsystem to every entity with a FTransformFragment and a
+ * FSelectionBoxBoundsFragment, adding or removing FSelectionBoxSelectedTag as needed.
+ *
+ * Chunks are processed in parallel. The boxes of a chunk are copied from its fragment arrays into batches of up to
+ * 128, which are tested with USelectionBoxFunctionLibrary::SelectionRegionOverlapsTransformedBoxBatch, so Mass
+ * agents get the same test (and options) as actors, without any UObjects involved. Since the tag is part of the
+ * archetype, the entities of a chunk are either all selected or all not, and only the ones that change get a
+ * deferred command. The batches and results live on the stack, so testing a chunk allocates nothing.
+ *
+ * Does nothing on frames where the subsystem has no region and no pending clear.
+ */
+UCLASS()
+class SELECTIONBOXMASS_API USelectionBoxMassProcessor : public UMassProcessor {
+  GENERATED_BODY()
+public:
+  USelectionBoxMassProcessor();
+
+protected:
+  // UMassProcessor implementation
+  virtual void ConfigureQueries() override;
+  virtual void Execute(FMassEntityManager& EntityManager, FMassExecutionContext& Context) override;
+
+private:
+  FMassEntityQuery EntityQuery;
+  // Entities that are selected, for ClearSelection.
+  FMassEntityQuery SelectedQuery;
+};
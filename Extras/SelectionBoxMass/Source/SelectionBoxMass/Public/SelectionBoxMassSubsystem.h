@@ -0,0 +1,48 @@
+// Copyright 2021 Gareth Cross.
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SelectionBoxFunctionLibrary.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "SelectionBoxMassSubsystem.generated.h"
+
+/**
+ * Holds the selection region that USelectionBoxMassProcessor applies to the Mass entities of a world.
+ *
+ * While a region is set, the processor keeps FSelectionBoxSelectedTag on exactly the entities that overlap it, so
+ * it can be updated every frame of a drag. Clearing the region keeps the last selection. Use ClearSelection to
+ * remove the tag from every entity.
+ */
+UCLASS()
+class SELECTIONBOXMASS_API USelectionBoxMassSubsystem : public UWorldSubsystem {
+  GENERATED_BODY()
+public:
+  // Select the entities that overlap `Region`, from the next time the processor runs.
+  UFUNCTION(BlueprintCallable)
+  void SetSelectionRegion(const FSelectionRegion& Region, const FSelectionQueryOptions& Options);
+
+  // Stop updating the selection. The entities selected so far keep their tag.
+  UFUNCTION(BlueprintCallable)
+  void ClearSelectionRegion();
+
+  // Stop updating the selection, and deselect every entity.
+  UFUNCTION(BlueprintCallable)
+  void ClearSelection();
+
+  UFUNCTION(BlueprintCallable, BlueprintPure)
+  bool HasSelectionRegion() const { return bHasRegion; }
+
+  const FSelectionRegion& GetSelectionRegion() const { return Region; }
+  const FSelectionQueryOptions& GetQueryOptions() const { return Options; }
+
+  // True if ClearSelection was called and the processor has not run since.
+  bool IsClearPending() const { return bClearPending; }
+
+private:
+  friend class USelectionBoxMassProcessor;
+
+  FSelectionRegion Region;
+  FSelectionQueryOptions Options;
+  bool bHasRegion{false};
+  bool bClearPending{false};
+};
@@ -0,0 +1,48 @@
+// Copyright 2021 Gareth Cross.
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MassEntityTraitBase.h"
+#include "MassEntityTypes.h"
+#include "SelectionBoxMassTypes.generated.h"
+
+/**
+ * Selectable box of a Mass entity, in the frame of its FTransformFragment. Same convention as the `Origin` and
+ * `Extent` arguments of USelectionBoxFunctionLibrary::SelectionRegionOverlapsTransformedBox.
+ */
+USTRUCT()
+struct SELECTIONBOXMASS_API FSelectionBoxBoundsFragment : public FMassFragment {
+  GENERATED_BODY()
+public:
+  UPROPERTY(EditAnywhere)
+  FVector Origin{FVector::ZeroVector};
+
+  UPROPERTY(EditAnywhere)
+  FVector Extent{50.0};
+};
+
+/**
+ * Added to the entities inside the selection region by USelectionBoxMassProcessor, and removed from those that
+ * leave it.
+ */
+USTRUCT()
+struct SELECTIONBOXMASS_API FSelectionBoxSelectedTag : public FMassTag {
+  GENERATED_BODY()
+};
+
+/**
+ * Makes the entities of a config selectable, by giving them a FSelectionBoxBoundsFragment (and requiring a
+ * FTransformFragment).
+ */
+UCLASS(meta=(DisplayName="Selectable Box"))
+class SELECTIONBOXMASS_API USelectionBoxMassTrait : public UMassEntityTraitBase {
+  GENERATED_BODY()
+public:
+  // Box of each entity, relative to its transform.
+  UPROPERTY(EditAnywhere, Category="Selection")
+  FSelectionBoxBoundsFragment Bounds;
+
+protected:
+  // UMassEntityTraitBase implementation
+  virtual void BuildTemplate(FMassEntityTemplateBuildContext& BuildContext, const UWorld& World) const override;
+};
@@ -0,0 +1,24 @@
+// Copyright 2021 Gareth Cross.
+
+using UnrealBuildTool;
+
+public class SelectionBoxMass : ModuleRules
+{
+	public SelectionBoxMass(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		PublicDependencyModuleNames.AddRange(
+			new string[]
+			{
+				"Core",
+				"CoreUObject",
+				"Engine",
+				"MassEntity",
+				"MassCommon",
+				"MassSpawner",
+				"SelectionBox",
+			}
+			);
+	}
+}
@@ -1,12 +1,61 @@
 // Copyright 2021 Gareth Cross.
 #include "SelectionBox.h"
 
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
+#include "SelectionBoxBoundsCache.h"
+#include "SelectionBoxRecorder.h"
+#include "SelectionBoxStats.h"
+
+DEFINE_STAT(STAT_SelectionBox_OverlapsActor);
+DEFINE_STAT(STAT_SelectionBox_OverlapsComponent);
+DEFINE_STAT(STAT_SelectionBox_OverlapsActorComponents);
+DEFINE_STAT(STAT_SelectionBox_OverlapsInstances);
+DEFINE_STAT(STAT_SelectionBox_OverlapsTransformedBox);
+DEFINE_STAT(STAT_SelectionBox_Batch);
+DEFINE_STAT(STAT_SelectionBox_BatchParallel);
+DEFINE_STAT(STAT_SelectionBox_SubsystemQuery);
+DEFINE_STAT(STAT_SelectionBox_DragUpdate);
+DEFINE_STAT(STAT_SelectionBox_AsyncSnapshot);
+DEFINE_STAT(STAT_SelectionBox_AsyncMerge);
+DEFINE_STAT(STAT_SelectionBox_Pick);
+DEFINE_STAT(STAT_SelectionBox_TopK);
+DEFINE_STAT(STAT_SelectionBox_Record);
+DEFINE_STAT(STAT_SelectionBox_CellsCulled);
+DEFINE_STAT(STAT_SelectionBox_BlocksCulled);
+DEFINE_STAT(STAT_SelectionBox_CellsInside);
+DEFINE_STAT(STAT_SelectionBox_ClustersCulled);
+DEFINE_STAT(STAT_SelectionBox_ClustersInside);
+DEFINE_STAT(STAT_SelectionBox_SphereRejected);
+DEFINE_STAT(STAT_SelectionBox_ClipRejected);
+DEFINE_STAT(STAT_SelectionBox_OutcodeRejected);
+DEFINE_STAT(STAT_SelectionBox_SphereAccepted);
+DEFINE_STAT(STAT_SelectionBox_BoxInside);
+DEFINE_STAT(STAT_SelectionBox_CornerInside);
+DEFINE_STAT(STAT_SelectionBox_EdgeCrossesPlane);
+DEFINE_STAT(STAT_SelectionBox_CornerRayHitsBox);
+DEFINE_STAT(STAT_SelectionBox_RayRejected);
+DEFINE_STAT(STAT_SelectionBox_PickBoxesTested);
+DEFINE_STAT(STAT_SelectionBox_TopKSkipped);
+DEFINE_STAT(STAT_SelectionBox_ActorsRefined);
+DEFINE_STAT(STAT_SelectionBox_BoundsCacheHit);
+DEFINE_STAT(STAT_SelectionBox_BoundsCacheMiss);
+DEFINE_STAT(STAT_SelectionBox_SubsystemMemory);
+
 #define LOCTEXT_NAMESPACE "FSelectionBoxModule"
 
 void FSelectionBoxModule::StartupModule() {
+  FSelectionBoxBoundsCache::Get().Startup();
+
+  FString RecordFilename;
+  if (FParse::Value(FCommandLine::Get(), TEXT("SelectionBoxRecord="), RecordFilename)) {
+    FSelectionBoxRecorder::Get().Start(RecordFilename);
+  }
 }
 
 void FSelectionBoxModule::ShutdownModule() {
+  FSelectionBoxRecorder::Get().Stop();
+  FSelectionBoxBoundsCache::Get().Shutdown();
 }
 
 #undef LOCTEXT_NAMESPACE
@@ -0,0 +1,57 @@
+// Copyright 2021 Gareth Cross.
+#include "SelectionBoxAsyncQuery.h"
+
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "SelectionBoxSubsystem.h"
+
+USelectionBoxAsyncQuery* USelectionBoxAsyncQuery::QueryActorsAsync(UObject* const WorldContextObject,
+                                                                   const FSelectionRegion& Region) {
+  return Create(WorldContextObject, Region, true);
+}
+
+USelectionBoxAsyncQuery* USelectionBoxAsyncQuery::QueryComponentsAsync(UObject* const WorldContextObject,
+                                                                       const FSelectionRegion& Region) {
+  return Create(WorldContextObject, Region, false);
+}
+
+USelectionBoxAsyncQuery* USelectionBoxAsyncQuery::Create(UObject* const WorldContextObject,
+                                                         const FSelectionRegion& Region, const bool bActors) {
+  USelectionBoxAsyncQuery* const Action = NewObject<USelectionBoxAsyncQuery>();
+  if (const UWorld* const World =
+          GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull)) {
+    Action->Subsystem = World->GetSubsystem<USelectionBoxSubsystem>();
+  }
+  Action->Region = Region;
+  Action->bActors = bActors;
+  Action->RegisterWithGameInstance(WorldContextObject);
+  return Action;
+}
+
+void USelectionBoxAsyncQuery::Activate() {
+  USelectionBoxSubsystem* const Target = Subsystem.Get();
+  if (!Target) {
+    Complete({}, {});
+    return;
+  }
+  // The subsystem calls back even if it is torn down in the meantime, so the action is always completed.
+  TWeakObjectPtr<USelectionBoxAsyncQuery> WeakThis{this};
+  if (bActors) {
+    Target->QueryActorsAsync(Region, [WeakThis](TArray<AActor*>&& Actors) {
+      if (USelectionBoxAsyncQuery* const This = WeakThis.Get()) {
+        This->Complete(Actors, {});
+      }
+    });
+  } else {
+    Target->QueryComponentsAsync(Region, [WeakThis](TArray<USceneComponent*>&& Components) {
+      if (USelectionBoxAsyncQuery* const This = WeakThis.Get()) {
+        This->Complete({}, Components);
+      }
+    });
+  }
+}
+
+void USelectionBoxAsyncQuery::Complete(const TArray<AActor*>& Actors, const TArray<USceneComponent*>& Components) {
+  OnCompleted.Broadcast(Actors, Components);
+  SetReadyToDestroy();
+}
@@ -0,0 +1,164 @@
+// Copyright 2021 Gareth Cross.
+#include "SelectionBoxBoundsCache.h"
+
+#include "Components/ActorComponent.h"
+#include "Components/SkinnedMeshComponent.h"
+#include "GameFramework/Actor.h"
+#include "HAL/IConsoleManager.h"
+#include "SelectionBoxStats.h"
+#include "UObject/UObjectGlobals.h"
+
+static TAutoConsoleVariable<bool> CVarCacheActorBounds(
+    TEXT("SelectionBox.CacheActorBounds"), true,
+    TEXT("Cache the local bounds of actors between selection queries, instead of recomputing them from every "
+         "component on each query."));
+
+FSelectionBoxBoundsCache& FSelectionBoxBoundsCache::Get() {
+  static FSelectionBoxBoundsCache Instance;
+  return Instance;
+}
+
+void FSelectionBoxBoundsCache::Startup() {
+  MarkRenderStateDirtyHandle =
+      UActorComponent::MarkRenderStateDirtyEvent.AddRaw(this, &FSelectionBoxBoundsCache::HandleMarkRenderStateDirty);
+  CreatePhysicsHandle =
+      UActorComponent::GlobalCreatePhysicsDelegate.AddRaw(this, &FSelectionBoxBoundsCache::HandlePhysicsStateChanged);
+  DestroyPhysicsHandle =
+      UActorComponent::GlobalDestroyPhysicsDelegate.AddRaw(this, &FSelectionBoxBoundsCache::HandlePhysicsStateChanged);
+  PostGarbageCollectHandle =
+      FCoreUObjectDelegates::GetPostGarbageCollect().AddRaw(this, &FSelectionBoxBoundsCache::HandlePostGarbageCollect);
+}
+
+void FSelectionBoxBoundsCache::Shutdown() {
+  UActorComponent::MarkRenderStateDirtyEvent.Remove(MarkRenderStateDirtyHandle);
+  UActorComponent::GlobalCreatePhysicsDelegate.Remove(CreatePhysicsHandle);
+  UActorComponent::GlobalDestroyPhysicsDelegate.Remove(DestroyPhysicsHandle);
+  FCoreUObjectDelegates::GetPostGarbageCollect().Remove(PostGarbageCollectHandle);
+  Reset();
+}
+
+FSelectionBoxBoundsCache::FBounds FSelectionBoxBoundsCache::GetActorBounds(const AActor& Actor,
+                                                                           const bool bIncludeFromNonColliding,
+                                                                           const bool bIncludeChildActors) {
+  if (!IsInGameThread() || !CVarCacheActorBounds.GetValueOnGameThread()) {
+    return ComputeBounds(Actor, bIncludeFromNonColliding, bIncludeChildActors);
+  }
+  const FObjectKey Key(&Actor);
+  FEntry* Entry = Entries.Find(Key);
+  // Components that neither render nor collide send no event when they are added or removed.
+  if (Entry && Entry->NumComponents != Actor.GetComponents().Num()) {
+    RemoveEntry(Key);
+    Entry = nullptr;
+  }
+  if (!Entry) {
+    Entry = &Entries.Add(Key);
+    BindEntry(Actor, *Entry);
+  }
+  if (!Entry->bCacheable) {
+    return ComputeBounds(Actor, bIncludeFromNonColliding, bIncludeChildActors);
+  }
+  FVariant& Variant = Entry->Variants[(bIncludeFromNonColliding ? 1 : 0) | (bIncludeChildActors ? 2 : 0)];
+  if (Variant.bValid) {
+    INC_DWORD_STAT(STAT_SelectionBox_BoundsCacheHit);
+    return Variant.Bounds;
+  }
+  INC_DWORD_STAT(STAT_SelectionBox_BoundsCacheMiss);
+  Variant.Bounds = ComputeBounds(Actor, bIncludeFromNonColliding, bIncludeChildActors);
+  Variant.bValid = true;
+  return Variant.Bounds;
+}
+
+void FSelectionBoxBoundsCache::Invalidate(const AActor* const Actor) {
+  if (Actor) {
+    RemoveEntry(FObjectKey(Actor));
+  }
+}
+
+void FSelectionBoxBoundsCache::Reset() {
+  for (const auto& Pair : Entries) {
+    UnbindEntry(Pair.Value);
+  }
+  Entries.Empty();
+}
+
+FSelectionBoxBoundsCache::FBounds FSelectionBoxBoundsCache::ComputeBounds(const AActor& Actor,
+                                                                          const bool bIncludeFromNonColliding,
+                                                                          const bool bIncludeChildActors) {
+  FBounds Bounds;
+  Bounds.LocalBox = Actor.CalculateComponentsBoundingBoxInLocalSpace(bIncludeFromNonColliding, bIncludeChildActors);
+  Bounds.SphereRadius = Bounds.LocalBox.GetExtent().Size();
+  return Bounds;
+}
+
+void FSelectionBoxBoundsCache::BindEntry(const AActor& Actor, FEntry& Entry) {
+  Entry.NumComponents = Actor.GetComponents().Num();
+  // Animation moves the bounds of skinned meshes without telling anyone.
+  Actor.ForEachComponent<USkinnedMeshComponent>(/*bIncludeFromChildActors=*/true, [&](const USkinnedMeshComponent*) {
+    Entry.bCacheable = false;
+  });
+  if (!Entry.bCacheable) {
+    return;
+  }
+  // Child actors are bound too, since their components may be part of the bounds. Moving the root of this actor
+  // moves the actor, not its bounds, so it is left out.
+  Actor.ForEachComponent<USceneComponent>(/*bIncludeFromChildActors=*/true, [&](USceneComponent* Component) {
+    if (Component != Actor.GetRootComponent()) {
+      Entry.TransformBindings.Emplace(
+          Component, Component->TransformUpdated.AddRaw(this, &FSelectionBoxBoundsCache::HandleTransformUpdated));
+    }
+  });
+}
+
+void FSelectionBoxBoundsCache::RemoveEntry(const FObjectKey Key) {
+  if (const FEntry* const Entry = Entries.Find(Key)) {
+    UnbindEntry(*Entry);
+    Entries.Remove(Key);
+  }
+}
+
+void FSelectionBoxBoundsCache::UnbindEntry(const FEntry& Entry) {
+  for (const auto& Binding : Entry.TransformBindings) {
+    if (USceneComponent* const Component = Binding.Key.Get()) {
+      Component->TransformUpdated.Remove(Binding.Value);
+    }
+  }
+}
+
+void FSelectionBoxBoundsCache::InvalidateOwners(const UActorComponent& Component) {
+  if (Entries.Num() == 0) {
+    return;
+  }
+  // The bounds of actors this one is attached to (or spawned by, for child actors) may include it too.
+  for (const AActor* Actor = Component.GetOwner(); Actor;
+       Actor = Actor->GetParentActor() ? Actor->GetParentActor() : Actor->GetAttachParentActor()) {
+    RemoveEntry(FObjectKey(Actor));
+  }
+}
+
+void FSelectionBoxBoundsCache::HandleMarkRenderStateDirty(UActorComponent& Component) {
+  InvalidateOwners(Component);
+}
+
+void FSelectionBoxBoundsCache::HandlePhysicsStateChanged(UActorComponent* const Component) {
+  if (Component) {
+    InvalidateOwners(*Component);
+  }
+}
+
+void FSelectionBoxBoundsCache::HandleTransformUpdated(USceneComponent* const Component,
+                                                      const EUpdateTransformFlags Flags, ETeleportType) {
+  // Passing on a move of the parent leaves the component where it was within its actor.
+  if (!Component || EnumHasAnyFlags(Flags, EUpdateTransformFlags::PropagateFromParent)) {
+    return;
+  }
+  InvalidateOwners(*Component);
+}
+
+void FSelectionBoxBoundsCache::HandlePostGarbageCollect() {
+  for (auto It = Entries.CreateIterator(); It; ++It) {
+    if (!It.Key().ResolveObjectPtr()) {
+      UnbindEntry(It.Value());
+      It.RemoveCurrent();
+    }
+  }
+}
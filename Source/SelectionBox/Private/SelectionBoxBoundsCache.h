@@ -0,0 +1,90 @@
+// Copyright 2021 Gareth Cross.
+#pragma once
+
+#include "Components/SceneComponent.h"
+#include "CoreMinimal.h"
+#include "UObject/ObjectKey.h"
+
+class AActor;
+class UActorComponent;
+
+/**
+ * Caches the local-space bounds of actors, so that selection queries do not walk every component of every
+ * candidate each time. Entries are keyed by actor and by the flags passed to
+ * AActor::CalculateComponentsBoundingBoxInLocalSpace. A hit is a map lookup plus a check of the actor's component
+ * count; the components themselves are only visited on a miss.
+ *
+ * Entries are dropped by events instead:
+ *  - A component of the actor (or of a child actor) marks its render state dirty, as when its mesh is swapped.
+ *  - A component creates or destroys its physics state, which happens when a colliding component is registered or
+ *    unregistered, or has its collision turned on or off. Unlike the render state, this also happens on a dedicated
+ *    server.
+ *  - A component other than the root moves relative to its parent, or is attached or detached. When an entry is
+ *    created, the cache binds to USceneComponent::TransformUpdated on these components. Updates that only pass on
+ *    a move of the parent are ignored, so moving the actor itself costs nothing.
+ *  - The actor has a different number of components from when the entry was created.
+ *
+ * Other changes to a component's bounds (such as editing the mesh asset) are not noticed. Use
+ * USelectionBoxFunctionLibrary::InvalidateCachedActorBounds for those. Actors with skinned meshes are never cached,
+ * since animation moves their bounds every frame.
+ *
+ * Only used from the game thread. Lookups from other threads bypass the cache.
+ */
+class FSelectionBoxBoundsCache {
+public:
+  struct FBounds {
+    FBox LocalBox{ForceInit};
+    // Radius of the sphere around the center of LocalBox that encloses it.
+    double SphereRadius{0};
+  };
+
+  static FSelectionBoxBoundsCache& Get();
+
+  // Bind to the engine events that invalidate entries. Called by the module.
+  void Startup();
+  void Shutdown();
+
+  // Look up the bounds of an actor, computing and caching them on a miss.
+  FBounds GetActorBounds(const AActor& Actor, bool bIncludeFromNonColliding, bool bIncludeChildActors);
+
+  // Drop the cached bounds of one actor, or of every actor.
+  void Invalidate(const AActor* Actor);
+  void Reset();
+
+private:
+  struct FVariant {
+    FBounds Bounds;
+    bool bValid{false};
+  };
+
+  struct FEntry {
+    // One variant per combination of the two include flags.
+    FVariant Variants[4];
+    int32 NumComponents{0};
+    // False if the actor has a skinned mesh, in which case nothing is stored.
+    bool bCacheable{true};
+    // TransformUpdated bindings, removed along with the entry.
+    TArray<TPair<TWeakObjectPtr<USceneComponent>, FDelegateHandle>> TransformBindings;
+  };
+
+  static FBounds ComputeBounds(const AActor& Actor, bool bIncludeFromNonColliding, bool bIncludeChildActors);
+
+  // Fill in a new entry for `Actor`, binding to the components whose movement would change its bounds.
+  void BindEntry(const AActor& Actor, FEntry& Entry);
+  void RemoveEntry(FObjectKey Key);
+  static void UnbindEntry(const FEntry& Entry);
+
+  // Drop the entries of the owner of `Component`, and of the actors it is a child actor of.
+  void InvalidateOwners(const UActorComponent& Component);
+
+  void HandleMarkRenderStateDirty(UActorComponent& Component);
+  void HandlePhysicsStateChanged(UActorComponent* Component);
+  void HandleTransformUpdated(USceneComponent* Component, EUpdateTransformFlags Flags, ETeleportType Teleport);
+  void HandlePostGarbageCollect();
+
+  TMap<FObjectKey, FEntry> Entries;
+  FDelegateHandle MarkRenderStateDirtyHandle;
+  FDelegateHandle CreatePhysicsHandle;
+  FDelegateHandle DestroyPhysicsHandle;
+  FDelegateHandle PostGarbageCollectHandle;
+};
@@ -0,0 +1,155 @@
+// Copyright 2021 Gareth Cross.
+#include "SelectionBoxDragSelection.h"
+
+#include "SelectionBoxStats.h"
+
+void FSelectionBoxDragSelection::Reset(FSelectionBoxBatchData InCandidates) {
+  Candidates = MoveTemp(InCandidates);
+  ensure(Candidates.GetView().IsValid());
+  Selection.Init(false, Candidates.Num());
+  Pending.Reset();
+  bHasLastRegion = false;
+  AccumulatedMovement = 0;
+  NumTestedLastUpdate = 0;
+}
+
+// True if the side planes of `A` and `B` have the same normals.
+static bool HaveSameSideNormals(const FRegionPlanes& A, const FRegionPlanes& B) {
+  return FVector{A.LeftPlane}.Equals(FVector{B.LeftPlane}) && FVector{A.RightPlane}.Equals(FVector{B.RightPlane}) &&
+         FVector{A.TopPlane}.Equals(FVector{B.TopPlane}) && FVector{A.BottomPlane}.Equals(FVector{B.BottomPlane});
+}
+
+void FSelectionBoxDragSelection::Update(const FSelectionRegion& Region) {
+  SCOPE_CYCLE_COUNTER(STAT_SelectionBox_DragUpdate);
+  TRACE_CPUPROFILER_EVENT_SCOPE(FSelectionBoxDragSelection::Update);
+  const FRegionPlanes Planes = Region.ComputePlanes();
+  // An orthographic region moves its origin with the selection box, so there it is the view that has to stay put.
+  const bool bSameView = Region.bOrthographic ? HaveSameSideNormals(Planes, LastPlanes)
+                                              : Region.CameraOrigin.Equals(LastRegion.CameraOrigin);
+  if (!bHasLastRegion || Region.bOrthographic != LastRegion.bOrthographic || !bSameView ||
+      !HaveSameClipPlanes(Planes, LastPlanes)) {
+    FullUpdate(Region, Planes);
+    return;
+  }
+
+  // How far did the planes move this frame? In a perspective view the normals turn about the camera origin, and in
+  // an orthographic one the planes slide along their normals.
+  const double Movement =
+      Region.bOrthographic
+          ? FMath::Max(FMath::Max(FMath::Abs(Planes.LeftPlane.W - LastPlanes.LeftPlane.W),
+                                  FMath::Abs(Planes.RightPlane.W - LastPlanes.RightPlane.W)),
+                       FMath::Max(FMath::Abs(Planes.TopPlane.W - LastPlanes.TopPlane.W),
+                                  FMath::Abs(Planes.BottomPlane.W - LastPlanes.BottomPlane.W)))
+          : FMath::Max(FMath::Max(FVector::Dist(FVector(Planes.LeftPlane), FVector(LastPlanes.LeftPlane)),
+                                  FVector::Dist(FVector(Planes.RightPlane), FVector(LastPlanes.RightPlane))),
+                       FMath::Max(FVector::Dist(FVector(Planes.TopPlane), FVector(LastPlanes.TopPlane)),
+                                  FVector::Dist(FVector(Planes.BottomPlane), FVector(LastPlanes.BottomPlane))));
+  LastRegion = Region;
+  LastPlanes = Planes;
+  NumTestedLastUpdate = 0;
+  if (Movement <= 0) {
+    return;
+  }
+  AccumulatedMovement += Movement;
+
+  // Pull out everyone whose margin has been used up. They are pushed back after testing, since candidates that
+  // straddle a plane are due again immediately.
+  Retest.Reset();
+  while (Pending.Num() > 0 && Pending.HeapTop().Threshold <= AccumulatedMovement) {
+    FPending Item;
+    Pending.HeapPop(Item);
+    Retest.Add(Item);
+  }
+  for (FPending& Item : Retest) {
+    Item.Threshold = AccumulatedMovement + Classify(Region, Planes, Item.Index);
+    Pending.HeapPush(Item);
+  }
+  NumTestedLastUpdate = Retest.Num();
+}
+
+void FSelectionBoxDragSelection::GetSelectedIndices(TArray<int32>& IndicesOut) const {
+  IndicesOut.Reset();
+  for (TConstSetBitIterator<> It(Selection); It; ++It) {
+    IndicesOut.Add(It.GetIndex());
+  }
+}
+
+double FSelectionBoxDragSelection::Classify(const FSelectionRegion& Region, const FRegionPlanes& Planes,
+                                            const int32 Index) {
+  const FVector& Position = Candidates.Positions[Index];
+  const FQuat& Rotation = Candidates.Rotations[Index];
+  const FVector& Origin = Candidates.Origins[Index];
+  const FVector& Extent = Candidates.Extents[Index];
+  const FVector Center = Position + Rotation.RotateVector(Origin);
+  const double Radius = Extent.Size();
+
+  // The clip planes stay put while this classification is in use (see Update), so a box entirely outside one of
+  // them never needs testing again, and a box straddling one is tested every time.
+  for (int32 p = 0; p < Planes.NumClipPlanes; ++p) {
+    const double Distance = Planes.ClipPlanes[p].PlaneDot(Center);
+    if (Distance - Radius > 0) {
+      Selection[Index] = false;
+      return TNumericLimits<double>::Max();
+    }
+    if (Distance + Radius > 0) {
+      return ClassifyExact(Region, Planes, Index);
+    }
+  }
+
+  // Every side plane of a perspective region passes through the camera origin, so the distances below all scale
+  // with the range to the camera. The planes of an orthographic region only slide, so there the margins are plain
+  // distances.
+  const double Range = Region.bOrthographic ? 1.0 : FVector::Dist(Center, Region.CameraOrigin);
+  const double MaxDistance =
+      FMath::Max(FMath::Max(Planes.LeftPlane.PlaneDot(Center), Planes.RightPlane.PlaneDot(Center)),
+                 FMath::Max(Planes.TopPlane.PlaneDot(Center), Planes.BottomPlane.PlaneDot(Center)));
+  if (MaxDistance - Radius > 0) {
+    // Entirely outside at least one plane. It stays outside while that plane still separates it.
+    Selection[Index] = false;
+    return Range > KINDA_SMALL_NUMBER ? (MaxDistance - Radius) / Range : 0;
+  }
+  if (-MaxDistance - Radius > 0) {
+    // The whole sphere is inside all four planes, and so is the box.
+    Selection[Index] = true;
+    return Range > KINDA_SMALL_NUMBER ? (-MaxDistance - Radius) / Range : 0;
+  }
+
+  // Straddling a plane: only the exact test will do.
+  return ClassifyExact(Region, Planes, Index);
+}
+
+double FSelectionBoxDragSelection::ClassifyExact(const FSelectionRegion& Region, const FRegionPlanes& Planes,
+                                                 const int32 Index) {
+  const FTransform BoxTransform{Candidates.Rotations[Index], Candidates.Positions[Index]};
+  Selection[Index] = USelectionBoxFunctionLibrary::SelectionRegionOverlapsTransformedBox2(
+                         Region, Planes, BoxTransform, Candidates.Origins[Index], Candidates.Extents[Index]) !=
+                     ETransformedBoxTestResult::NoIntersection;
+  // No margin, so it is due again at the next update.
+  return 0;
+}
+
+bool FSelectionBoxDragSelection::HaveSameClipPlanes(const FRegionPlanes& A, const FRegionPlanes& B) {
+  if (A.NumClipPlanes != B.NumClipPlanes) {
+    return false;
+  }
+  for (int32 p = 0; p < A.NumClipPlanes; ++p) {
+    if (!A.ClipPlanes[p].Equals(B.ClipPlanes[p])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void FSelectionBoxDragSelection::FullUpdate(const FSelectionRegion& Region, const FRegionPlanes& Planes) {
+  LastRegion = Region;
+  LastPlanes = Planes;
+  bHasLastRegion = true;
+  AccumulatedMovement = 0;
+
+  Pending.Reset(Candidates.Num());
+  for (int32 i = 0; i < Candidates.Num(); ++i) {
+    Pending.Add(FPending{Classify(Region, Planes, i), i});
+  }
+  Pending.Heapify();
+  NumTestedLastUpdate = Candidates.Num();
+}
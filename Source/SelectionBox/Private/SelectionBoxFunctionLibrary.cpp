@@ -1,27 +1,201 @@
 ﻿// Copyright 2021 Gareth Cross.
 #include "SelectionBoxFunctionLibrary.h"
 
+#include "Async/ParallelFor.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/NetSerialization.h"
+#include "Engine/StaticMesh.h"
+#include "HAL/IConsoleManager.h"
 #include "Kismet/GameplayStatics.h"
+#include "SelectionBoxBoundsCache.h"
+#include "SelectionBoxKernels.h"
+#include "SelectionBoxRecorder.h"
+#include "SelectionBoxStats.h"
+#include "Serialization/BitReader.h"
+#include "Serialization/BitWriter.h"
+
+static TAutoConsoleVariable<int32> CVarParallelMinBatchSize(
+    TEXT("SelectionBox.ParallelMinBatchSize"), 2048,
+    TEXT("Smallest number of boxes a worker thread is given by the parallel selection queries. Smaller queries run "
+         "on the calling thread."));
+
+void FSelectionBoxBatchData::Reset(const int32 ExpectedNum) {
+  Positions.Reset(ExpectedNum);
+  Rotations.Reset(ExpectedNum);
+  Origins.Reset(ExpectedNum);
+  Extents.Reset(ExpectedNum);
+}
+
+int32 FSelectionBoxBatchData::Add(const FTransform& BoxTransform, const FVector& Origin, const FVector& Extent) {
+  // Scale is applied in the local frame of the box, before rotation, so the scaled box is still axis-aligned.
+  const FVector Scale = BoxTransform.GetScale3D();
+  Rotations.Add(BoxTransform.GetRotation());
+  Origins.Add(Origin * Scale);
+  Extents.Add(Extent * Scale.GetAbs());
+  return Positions.Add(BoxTransform.GetTranslation());
+}
+
+// The Blueprint-facing types must stay interchangeable with those of the core.
+static_assert(static_cast<uint8>(ETransformedBoxTestResult::Overlaps) ==
+                  static_cast<uint8>(SelectionBox::EBoxTestResult::Overlaps),
+              "ETransformedBoxTestResult and SelectionBox::EBoxTestResult must match");
+static_assert(static_cast<uint8>(ESelectionOverlap::FullyInside) ==
+                  static_cast<uint8>(SelectionBox::EOverlap::Inside),
+              "ESelectionOverlap and SelectionBox::EOverlap must match");
 
 FRegionPlanes FSelectionRegion::ComputePlanes() const {
-  FRegionPlanes Result;
-  Result.LeftPlane = FPlane{
-      CameraOrigin, FVector::CrossProduct(BottomLeftRay, TopLeftRay).GetSafeNormal()
-  };
-  Result.RightPlane = FPlane{
-      CameraOrigin,
-      FVector::CrossProduct(TopRightRay, BottomRightRay).GetSafeNormal()
-  };
-  Result.TopPlane = FPlane{
-      CameraOrigin, FVector::CrossProduct(TopLeftRay, TopRightRay).GetSafeNormal()
-  };
-  Result.BottomPlane = FPlane{
-      CameraOrigin,
-      FVector::CrossProduct(BottomRightRay, BottomLeftRay).GetSafeNormal()
-  };
+  FRegionPlanes Result =
+      bOrthographic ? SelectionBox::FromCore(SelectionBox::ComputeOrthoRegionPlanes(SelectionBox::ToCoreOrtho(*this)))
+                    : SelectionBox::FromCore(SelectionBox::ComputeRegionPlanes(SelectionBox::ToCore(*this)));
+  if (NearDistance <= 0 && FarDistance <= 0 && ExtraPlanes.Num() == 0) {
+    return Result;
+  }
+  if (NearDistance > 0 || FarDistance > 0) {
+    FVector Forward = ViewDirection.GetSafeNormal();
+    if (Forward.IsZero()) {
+      Forward = (TopLeftRay + TopRightRay + BottomRightRay + BottomLeftRay).GetSafeNormal();
+    }
+    if (NearDistance > 0) {
+      Result.ClipPlanes[Result.NumClipPlanes++] = FPlane{CameraOrigin + Forward * NearDistance, -Forward};
+    }
+    if (FarDistance > 0) {
+      Result.ClipPlanes[Result.NumClipPlanes++] = FPlane{CameraOrigin + Forward * FarDistance, Forward};
+    }
+  }
+  ensureMsgf(ExtraPlanes.Num() <= MaxExtraPlanes, TEXT("Only %d extra planes are supported, got %d."),
+             MaxExtraPlanes, ExtraPlanes.Num());
+  for (int32 i = 0; i < FMath::Min(ExtraPlanes.Num(), MaxExtraPlanes); ++i) {
+    Result.ClipPlanes[Result.NumClipPlanes++] = ExtraPlanes[i];
+  }
   return Result;
 }
 
+// Send a unit vector in 32 bits, in octahedral form.
+static void SerializeUnitVector(FArchive& Ar, FVector& Vector) {
+  uint16 U = 0;
+  uint16 V = 0;
+  if (Ar.IsSaving()) {
+    SelectionBox::OctahedralEncode(Vector, U, V);
+  }
+  Ar << U << V;
+  if (Ar.IsLoading()) {
+    Vector = SelectionBox::OctahedralDecode<FVector>(U, V);
+  }
+}
+
+static void SerializeAsFloat(FArchive& Ar, double& Value) {
+  float Single = static_cast<float>(Value);
+  Ar << Single;
+  if (Ar.IsLoading()) {
+    Value = Single;
+  }
+}
+
+static void SerializePlane(FArchive& Ar, FPlane& Plane) {
+  FVector Normal = Plane;
+  SerializeUnitVector(Ar, Normal);
+  double W = Plane.W;
+  Ar << W;
+  if (Ar.IsLoading()) {
+    Plane = FPlane{Normal, W};
+  }
+}
+
+bool FRegionPlanes::NetSerialize(FArchive& Ar, UPackageMap* const Map, bool& bOutSuccess) {
+  for (FPlane* const Plane : {&LeftPlane, &RightPlane, &TopPlane, &BottomPlane}) {
+    SerializePlane(Ar, *Plane);
+  }
+  uint32 NumPlanes = NumClipPlanes;
+  Ar.SerializeInt(NumPlanes, MaxClipPlanes + 1);
+  NumClipPlanes = static_cast<int32>(NumPlanes);
+  for (int32 p = 0; p < NumClipPlanes; ++p) {
+    SerializePlane(Ar, ClipPlanes[p]);
+  }
+  bOutSuccess = !Ar.IsError();
+  return true;
+}
+
+bool FSelectionRegion::NetSerialize(FArchive& Ar, UPackageMap* const Map, bool& bOutSuccess) {
+  // Which of the optional fields follow.
+  enum : uint8 {
+    HasViewProjection = 1 << 0,
+    HasNearDistance = 1 << 1,
+    HasFarDistance = 1 << 2,
+    HasViewDirection = 1 << 3,
+    HasExtraPlanes = 1 << 4,
+    IsOrthographic = 1 << 5,
+  };
+  uint8 Flags = 0;
+  if (Ar.IsSaving()) {
+    Flags = static_cast<uint8>((bHasViewProjection ? HasViewProjection : 0) | (NearDistance > 0 ? HasNearDistance : 0) |
+                               (FarDistance > 0 ? HasFarDistance : 0) |
+                               (!ViewDirection.IsZero() ? HasViewDirection : 0) |
+                               (ExtraPlanes.Num() > 0 ? HasExtraPlanes : 0) | (bOrthographic ? IsOrthographic : 0));
+  }
+  Ar << Flags;
+  if (Ar.IsLoading()) {
+    bHasViewProjection = (Flags & HasViewProjection) != 0;
+    NearDistance = 0;
+    FarDistance = 0;
+    ViewDirection = FVector::ZeroVector;
+    ExtraPlanes.Reset();
+    bOrthographic = (Flags & IsOrthographic) != 0;
+    OrthoRightExtent = FVector::ZeroVector;
+    OrthoUpExtent = FVector::ZeroVector;
+  }
+
+  bOutSuccess = SerializePackedVector<10, 24>(CameraOrigin, Ar);
+  for (FVector* const Ray : {&TopLeftRay, &TopRightRay, &BottomLeftRay, &BottomRightRay}) {
+    SerializeUnitVector(Ar, *Ray);
+  }
+
+  if (Flags & HasViewProjection) {
+    for (int32 Row = 0; Row < 4; ++Row) {
+      for (int32 Col = 0; Col < 4; ++Col) {
+        SerializeAsFloat(Ar, ViewProjectionMatrix.M[Row][Col]);
+      }
+    }
+    SerializeAsFloat(Ar, ScreenMin.X);
+    SerializeAsFloat(Ar, ScreenMin.Y);
+    SerializeAsFloat(Ar, ScreenMax.X);
+    SerializeAsFloat(Ar, ScreenMax.Y);
+  }
+  if (Flags & HasNearDistance) {
+    Ar << NearDistance;
+  }
+  if (Flags & HasFarDistance) {
+    Ar << FarDistance;
+  }
+  if (Flags & HasViewDirection) {
+    SerializeUnitVector(Ar, ViewDirection);
+  }
+  if (Flags & IsOrthographic) {
+    bOutSuccess &= SerializePackedVector<10, 24>(OrthoRightExtent, Ar);
+    bOutSuccess &= SerializePackedVector<10, 24>(OrthoUpExtent, Ar);
+  }
+  if (Flags & HasExtraPlanes) {
+    uint32 NumPlanes = FMath::Min(ExtraPlanes.Num(), MaxExtraPlanes);
+    Ar.SerializeInt(NumPlanes, MaxExtraPlanes + 1);
+    if (Ar.IsLoading()) {
+      ExtraPlanes.SetNum(static_cast<int32>(NumPlanes));
+    }
+    for (int32 i = 0; i < static_cast<int32>(NumPlanes); ++i) {
+      Ar << ExtraPlanes[i];
+    }
+  }
+  bOutSuccess &= !Ar.IsError();
+  return true;
+}
+
+void FSelectionRegion::QuantizeForNetwork() {
+  FBitWriter Writer{0, true};
+  bool bSuccess = false;
+  NetSerialize(Writer, nullptr, bSuccess);
+  FBitReader Reader{Writer.GetData(), Writer.GetNumBits()};
+  NetSerialize(Reader, nullptr, bSuccess);
+}
+
 bool USelectionBoxFunctionLibrary::InBoxXY(const FVector& Vec, const FBox& Box) {
   return (Vec.X > Box.Min.X) && (Vec.Y > Box.Min.Y) && (Vec.X < Box.Max.X) && (Vec.Y < Box.Max.Y);
 }
@@ -41,248 +215,888 @@ bool USelectionBoxFunctionLibrary::RayIntersectsTransformedBox(const FVector& Ra
   // Convert origin and direction to box frame.
   const FVector OriginInBoxFrame = BoxTransform.InverseTransformPosition(RayOrigin);
   const FVector DirectionInBoxFrame = BoxTransform.InverseTransformVector(RayDirection.GetSafeNormal());
+  return SelectionBox::RayIntersectsLocalBox(OriginInBoxFrame, DirectionInBoxFrame, Origin - Extent,
+                                             Origin + Extent);
+}
 
-  // shorthand:
-  const FVector& P = OriginInBoxFrame;
-  const FVector& L = DirectionInBoxFrame;
-  const FBox LocalBox{Origin - Extent, Origin + Extent};
-
-  // check every face
-  if (FMath::Abs(L.Z) > SMALL_NUMBER) {
-    // +Z
-    {
-      // We intersect the top, check if it is in bounds:
-      const float W = LocalBox.Max.Z;
-      const float D = (-P.Z + W) / L.Z;
-      const FVector IntersectPt = P + L * D;
-      if (InBoxXY(IntersectPt, LocalBox)) {
-        return true;
-      }
-    }
-    // -Z
-    {
-      const float W = -1 * LocalBox.Min.Z;
-      const float D = -(P.Z + W) / L.Z;
-      const FVector IntersectPt = P + L * D;
-      if (InBoxXY(IntersectPt, LocalBox)) {
-        return true;
-      }
-    }
+bool USelectionBoxFunctionLibrary::RayIntersectsTransformedBoxDistance(const FVector& RayOrigin,
+                                                                       const FVector& RayDirection,
+                                                                       const FTransform& BoxTransform,
+                                                                       const FVector& Origin, const FVector& Extent,
+                                                                       double& DistanceOut, const double MaxDistance) {
+  // The transform is affine, so `t` along the ray in the box frame is also the distance along the world ray.
+  const FVector OriginInBoxFrame = BoxTransform.InverseTransformPosition(RayOrigin);
+  const FVector DirectionInBoxFrame = BoxTransform.InverseTransformVector(RayDirection.GetSafeNormal());
+  return SelectionBox::RayEntersLocalBox(OriginInBoxFrame, DirectionInBoxFrame, Origin - Extent, Origin + Extent,
+                                         MaxDistance, DistanceOut);
+}
+
+ETransformedBoxTestResult USelectionBoxFunctionLibrary::SelectionRegionOverlapsTransformedBox(
+    const FSelectionRegion& Region, const FTransform& BoxTransform, const FVector& Origin, const FVector& Extent) {
+  return SelectionRegionOverlapsTransformedBox2(Region, Region.ComputePlanes(), BoxTransform, Origin, Extent);
+}
+
+// Test a box against the region, given the world coordinates of its corners (ordered as in PointMultipliers).
+// The transform, origin and extent are only needed for the final ray checks.
+static ETransformedBoxTestResult TestBoxCorners(const FSelectionRegion& Region, const FRegionPlanes& Planes,
+                                                const SelectionBox::FPackedRegionPlanes& PackedPlanes,
+                                                const FVector (&WorldPts)[8], const FTransform& BoxTransform,
+                                                const FVector& Origin, const FVector& Extent) {
+  // Assign regions to points
+  const SelectionBox::FCornerOutcodes Outcodes = SelectionBox::ClassifyCorners(PackedPlanes, WorldPts);
+  if (Outcodes.AllOutside) {
+    INC_DWORD_STAT(STAT_SelectionBox_OutcodeRejected);
+    return ETransformedBoxTestResult::NoIntersection; // every corner is outside the same plane
   }
-  if (FMath::Abs(L.Y) > SMALL_NUMBER) {
-    // +Y
-    {
-      const float W = LocalBox.Max.Y;
-      const float D = (-P.Y + W) / L.Y;
-      const FVector IntersectPt = P + L * D;
-      if (InBoxXZ(IntersectPt, LocalBox)) {
-        return true;
-      }
+  if (Outcodes.AnyInside) {
+    INC_DWORD_STAT(STAT_SelectionBox_CornerInside);
+    return ETransformedBoxTestResult::BoxCornerInsideRegion; // early exit, one point is within the box
+  }
+
+  // Check the edges for intersection
+  if (SelectionBox::EdgesIntersectRegion(SelectionBox::ToCore(Planes), WorldPts, Outcodes)) {
+    INC_DWORD_STAT(STAT_SelectionBox_EdgeCrossesPlane);
+    return ETransformedBoxTestResult::BoxIntersectsPlane;
+  }
+
+  // Finally check all the rays, in the frame of the box. They share an origin, so it is only transformed once.
+  const FVector OriginInBoxFrame = BoxTransform.InverseTransformPosition(Region.CameraOrigin);
+  const FVector RaysInBoxFrame[4] = {
+      BoxTransform.InverseTransformVector(Region.TopLeftRay),
+      BoxTransform.InverseTransformVector(Region.TopRightRay),
+      BoxTransform.InverseTransformVector(Region.BottomLeftRay),
+      BoxTransform.InverseTransformVector(Region.BottomRightRay),
+  };
+  if (SelectionBox::AnyRayIntersectsLocalBox(OriginInBoxFrame, RaysInBoxFrame, Origin - Extent, Origin + Extent)) {
+    INC_DWORD_STAT(STAT_SelectionBox_CornerRayHitsBox);
+    return ETransformedBoxTestResult::SelectionCornerIntersectsBox;
+  }
+  INC_DWORD_STAT(STAT_SelectionBox_RayRejected);
+  return ETransformedBoxTestResult::NoIntersection;
+}
+
+// The box of SelectionRegionOverlapsTransformedBox, in world space. The scale is applied before the rotation, so the
+// scaled axes stay orthogonal.
+static SelectionBox::TOrientedBox<FVector> MakeOrientedBox(const FTransform& BoxTransform, const FVector& Origin,
+                                                           const FVector& Extent) {
+  return SelectionBox::TOrientedBox<FVector>{
+      BoxTransform.TransformPosition(Origin),
+      {BoxTransform.TransformVector(FVector{Extent.X, 0, 0}), BoxTransform.TransformVector(FVector{0, Extent.Y, 0}),
+       BoxTransform.TransformVector(FVector{0, 0, Extent.Z})}};
+}
+
+// Test a box against an orthographic region. Every query mode comes here for orthographic regions, since this test
+// is both exact and the cheapest.
+static ETransformedBoxTestResult TestBoxOrthographic(const SelectionBox::TOrthoRegion<FVector>& Ortho,
+                                                     const FRegionPlanes& Planes,
+                                                     const SelectionBox::TOrientedBox<FVector>& Box) {
+  switch (SelectionBox::ClassifyOrthoBox(Ortho, Planes, Box)) {
+    case SelectionBox::EOverlap::Inside:
+      INC_DWORD_STAT(STAT_SelectionBox_BoxInside);
+      return ETransformedBoxTestResult::BoxCornerInsideRegion;
+    case SelectionBox::EOverlap::Intersecting:
+      return ETransformedBoxTestResult::Overlaps;
+    default:
+      return ETransformedBoxTestResult::NoIntersection;
+  }
+}
+
+ETransformedBoxTestResult USelectionBoxFunctionLibrary::SelectionRegionOverlapsTransformedBox2(
+    const FSelectionRegion& Region, const FRegionPlanes& Planes, const FTransform& BoxTransform, const FVector& Origin,
+    const FVector& Extent) {
+  SCOPE_CYCLE_COUNTER(STAT_SelectionBox_OverlapsTransformedBox);
+  TRACE_CPUPROFILER_EVENT_SCOPE(SelectionRegionOverlapsTransformedBox2);
+  if (Region.bOrthographic) {
+    return TestBoxOrthographic(SelectionBox::ToCoreOrtho(Region), Planes,
+                               MakeOrientedBox(BoxTransform, Origin, Extent));
+  }
+  // Convert box corner points to world coordinates:
+  FVector WorldPts[8];
+  SelectionBox::ComputeCorners(BoxTransform, Origin, Extent, WorldPts);
+  if (Planes.HasClipPlanes() && SelectionBox::ClassifyClipCorners(Planes, WorldPts).AllOutside) {
+    INC_DWORD_STAT(STAT_SelectionBox_ClipRejected);
+    return ETransformedBoxTestResult::NoIntersection;
+  }
+  const SelectionBox::FPackedRegionPlanes PackedPlanes{Planes};
+  return TestBoxCorners(Region, Planes, PackedPlanes, WorldPts, BoxTransform, Origin, Extent);
+}
+
+// Classify a box by its bounding sphere, and then by the box itself if the sphere straddles a plane.
+template <typename FuncType>
+static SelectionBox::EOverlap ClassifyBoxTiers(const FRegionPlanes& Planes, const FVector& Center, const double Radius,
+                                               FuncType&& ClassifyBox) {
+  const SelectionBox::EOverlap SphereOverlap = SelectionBox::ClassifySphere(Planes, Center, Radius);
+  if (SphereOverlap == SelectionBox::EOverlap::Outside) {
+    INC_DWORD_STAT(STAT_SelectionBox_SphereRejected);
+    return SphereOverlap;
+  }
+  if (SphereOverlap == SelectionBox::EOverlap::Inside) {
+    INC_DWORD_STAT(STAT_SelectionBox_SphereAccepted);
+    return SphereOverlap;
+  }
+  const SelectionBox::EOverlap BoxOverlap = ClassifyBox();
+  if (BoxOverlap == SelectionBox::EOverlap::Inside) {
+    INC_DWORD_STAT(STAT_SelectionBox_BoxInside);
+  }
+  return BoxOverlap;
+}
+
+// A box that straddles a plane may still be outside the region (near its corners), which only `FullTest` can tell.
+template <typename FuncType>
+static ESelectionOverlap ResolveOverlap(const SelectionBox::EOverlap Overlap, FuncType&& FullTest) {
+  if (Overlap != SelectionBox::EOverlap::Intersecting) {
+    return static_cast<ESelectionOverlap>(Overlap);
+  }
+  return FullTest() != ETransformedBoxTestResult::NoIntersection ? ESelectionOverlap::Intersecting
+                                                                  : ESelectionOverlap::Outside;
+}
+
+ESelectionOverlap USelectionBoxFunctionLibrary::SelectionRegionClassifyTransformedBox(
+    const FSelectionRegion& Region, const FRegionPlanes& Planes, const FTransform& BoxTransform, const FVector& Origin,
+    const FVector& Extent) {
+  const SelectionBox::TOrientedBox<FVector> Box = MakeOrientedBox(BoxTransform, Origin, Extent);
+  const double Radius =
+      FMath::Sqrt(Box.Axes[0].SizeSquared() + Box.Axes[1].SizeSquared() + Box.Axes[2].SizeSquared());
+  const SelectionBox::EOverlap Overlap = ClassifyBoxTiers(
+      Planes, Box.Center, Radius, [&Planes, &Box]() { return SelectionBox::ClassifyOrientedBox(Planes, Box); });
+  return ResolveOverlap(Overlap, [&]() {
+    return SelectionRegionOverlapsTransformedBox2(Region, Planes, BoxTransform, Origin, Extent);
+  });
+}
+
+ESelectionOverlap USelectionBoxFunctionLibrary::SelectionRegionClassifyBounds(const FSelectionRegion& Region,
+                                                                              const FRegionPlanes& Planes,
+                                                                              const FBoxSphereBounds& Bounds) {
+  const SelectionBox::EOverlap Overlap =
+      ClassifyBoxTiers(Planes, Bounds.Origin, Bounds.SphereRadius, [&Planes, &Bounds]() {
+        return SelectionBox::ClassifyAlignedBox(Planes, Bounds.Origin, Bounds.BoxExtent);
+      });
+  return ResolveOverlap(Overlap, [&]() {
+    return SelectionRegionOverlapsTransformedBox2(Region, Planes, FTransform::Identity, Bounds.Origin,
+                                                  Bounds.BoxExtent);
+  });
+}
+
+ETransformedBoxTestResult USelectionBoxFunctionLibrary::SelectionRegionOverlapsTransformedBoxScreenSpace(
+    const FSelectionRegion& Region, const FTransform& BoxTransform, const FVector& Origin, const FVector& Extent) {
+  if (Region.bOrthographic) {
+    return TestBoxOrthographic(SelectionBox::ToCoreOrtho(Region), Region.ComputePlanes(),
+                               MakeOrientedBox(BoxTransform, Origin, Extent));
+  }
+  if (!Region.bHasViewProjection) {
+    return ETransformedBoxTestResult::NoIntersection;
+  }
+  FVector WorldPts[8];
+  SelectionBox::ComputeCorners(BoxTransform, Origin, Extent, WorldPts);
+  if (Region.NearDistance > 0 || Region.FarDistance > 0 || Region.ExtraPlanes.Num() > 0) {
+    // The clip planes are not part of the projection, so they are checked in 3D.
+    if (SelectionBox::ClassifyClipCorners(Region.ComputePlanes(), WorldPts).AllOutside) {
+      INC_DWORD_STAT(STAT_SelectionBox_ClipRejected);
+      return ETransformedBoxTestResult::NoIntersection;
     }
-    // -Y
-    {
-      const float W = -1 * LocalBox.Min.Y;
-      const float D = -(P.Y + W) / L.Y;
-      const FVector IntersectPt = P + L * D;
-      if (InBoxXZ(IntersectPt, LocalBox)) {
-        return true;
+  }
+  return SelectionBox::TestBoxCornersScreenSpace(Region, WorldPts);
+}
+
+ETransformedBoxTestResult USelectionBoxFunctionLibrary::SelectionRegionOverlapsTransformedBoxSeparatingAxis(
+    const FSelectionRegion& Region, const FRegionPlanes& Planes, const FTransform& BoxTransform, const FVector& Origin,
+    const FVector& Extent) {
+  if (Region.bOrthographic) {
+    return TestBoxOrthographic(SelectionBox::ToCoreOrtho(Region), Planes,
+                               MakeOrientedBox(BoxTransform, Origin, Extent));
+  }
+  FVector WorldPts[8];
+  SelectionBox::ComputeCorners(BoxTransform, Origin, Extent, WorldPts);
+  if (Planes.HasClipPlanes() && SelectionBox::ClassifyClipCorners(Planes, WorldPts).AllOutside) {
+    INC_DWORD_STAT(STAT_SelectionBox_ClipRejected);
+    return ETransformedBoxTestResult::NoIntersection;
+  }
+  const FVector Axes[3] = {
+      BoxTransform.TransformVector(FVector{Extent.X, 0, 0}),
+      BoxTransform.TransformVector(FVector{0, Extent.Y, 0}),
+      BoxTransform.TransformVector(FVector{0, 0, Extent.Z}),
+  };
+  const SelectionBox::FPackedRegionPlanes PackedPlanes{Planes};
+  return SelectionBox::TestBoxSeparatingAxis(Region, PackedPlanes, BoxTransform.TransformPosition(Origin), Axes,
+                                             WorldPts);
+}
+
+ETransformedBoxTestResult USelectionBoxFunctionLibrary::SelectionRegionOverlapsTransformedBoxWithMode(
+    const FSelectionRegion& Region, const FRegionPlanes& Planes, const FTransform& BoxTransform, const FVector& Origin,
+    const FVector& Extent, const ESelectionQueryMode Mode) {
+  if (Mode == ESelectionQueryMode::ScreenSpace && Region.bHasViewProjection && !Region.bOrthographic) {
+    if (Planes.HasClipPlanes()) {
+      FVector WorldPts[8];
+      SelectionBox::ComputeCorners(BoxTransform, Origin, Extent, WorldPts);
+      if (SelectionBox::ClassifyClipCorners(Planes, WorldPts).AllOutside) {
+        INC_DWORD_STAT(STAT_SelectionBox_ClipRejected);
+        return ETransformedBoxTestResult::NoIntersection;
       }
+      return SelectionBox::TestBoxCornersScreenSpace(Region, WorldPts);
     }
+    return SelectionRegionOverlapsTransformedBoxScreenSpace(Region, BoxTransform, Origin, Extent);
   }
-  if (FMath::Abs(L.X) > SMALL_NUMBER) {
-    // +X
-    {
-      const float W = LocalBox.Max.X;
-      const float D = (-P.X + W) / L.X;
-      const FVector IntersectPt = P + L * D;
-      if (InBoxYZ(IntersectPt, LocalBox)) {
-        return true;
-      }
+  if (Mode == ESelectionQueryMode::SeparatingAxis) {
+    return SelectionRegionOverlapsTransformedBoxSeparatingAxis(Region, Planes, BoxTransform, Origin, Extent);
+  }
+  return SelectionRegionOverlapsTransformedBox2(Region, Planes, BoxTransform, Origin, Extent);
+}
+
+// Test box `Index` of a batch: sphere check first, then the full corner test. The clip planes are only checked if
+// `bClipPlanes` is set, so that regions without them pay nothing extra.
+template <bool bClipPlanes>
+static bool BatchBoxOverlapsRegion(const FSelectionRegion& Region, const FRegionPlanes& Planes,
+                                   const SelectionBox::FPackedRegionPlanes& PackedPlanes,
+                                   const ESelectionQueryMode Mode, const FSelectionBoxBatch& Boxes,
+                                   const int32 Index) {
+  const FVector& Position = Boxes.Positions[Index];
+  const FQuat& Rotation = Boxes.Rotations[Index];
+  const FVector& Origin = Boxes.Origins[Index];
+  const FVector& Extent = Boxes.Extents[Index];
+
+  // Rotation does not change the bounding sphere, so we can cull (or accept) before computing any of the corners.
+  const FVector Center = Position + Rotation.RotateVector(Origin);
+  const SelectionBox::EOverlap SphereOverlap = SelectionBox::ClassifySphere(Planes, Center, Extent.Size());
+  if (SphereOverlap == SelectionBox::EOverlap::Outside) {
+    INC_DWORD_STAT(STAT_SelectionBox_SphereRejected);
+    return false;
+  }
+  if (SphereOverlap == SelectionBox::EOverlap::Inside) {
+    INC_DWORD_STAT(STAT_SelectionBox_SphereAccepted);
+    return true;
+  }
+
+  // Build the corners from the center and the three (scaled) box axes, rather than transforming all 8 points.
+  const FVector Axes[3] = {Rotation.GetAxisX() * Extent.X, Rotation.GetAxisY() * Extent.Y,
+                           Rotation.GetAxisZ() * Extent.Z};
+  FVector WorldPts[8];
+  SelectionBox::ComputeCorners(Center, Axes[0], Axes[1], Axes[2], WorldPts);
+  if constexpr (bClipPlanes) {
+    if (SelectionBox::ClassifyClipCorners(Planes, WorldPts).AllOutside) {
+      INC_DWORD_STAT(STAT_SelectionBox_ClipRejected);
+      return false;
     }
-    // -X
-    {
-      const float W = -1 * LocalBox.Min.X;
-      const float D = -(P.X + W) / L.X;
-      const FVector IntersectPt = P + L * D;
-      if (InBoxYZ(IntersectPt, LocalBox)) {
-        return true;
-      }
+  }
+  if (Mode == ESelectionQueryMode::ScreenSpace) {
+    return SelectionBox::TestBoxCornersScreenSpace(Region, WorldPts) != ETransformedBoxTestResult::NoIntersection;
+  }
+  if (Mode == ESelectionQueryMode::SeparatingAxis) {
+    return SelectionBox::TestBoxSeparatingAxis(Region, PackedPlanes, Center, Axes, WorldPts) !=
+           ETransformedBoxTestResult::NoIntersection;
+  }
+
+  // The transform is only needed if we reach the ray checks, which is rare, but it is cheap to build.
+  const FTransform BoxTransform{Rotation, Position};
+  return TestBoxCorners(Region, Planes, PackedPlanes, WorldPts, BoxTransform, Origin, Extent) !=
+         ETransformedBoxTestResult::NoIntersection;
+}
+
+// Single precision version of TestBoxCorners, for a box and region relative to the camera.
+static ETransformedBoxTestResult TestBoxCameraRelative(const SelectionBox::FCameraRelativeRegion& Region,
+                                                       const SelectionBox::TOrientedBox<FVector3f>& Box,
+                                                       const FVector3f (&Pts)[8]) {
+  const SelectionBox::FCornerOutcodes Outcodes = SelectionBox::ClassifyCorners(Region.PackedPlanes, Pts);
+  if (Outcodes.AllOutside) {
+    INC_DWORD_STAT(STAT_SelectionBox_OutcodeRejected);
+    return ETransformedBoxTestResult::NoIntersection;
+  }
+  if (Outcodes.AnyInside) {
+    INC_DWORD_STAT(STAT_SelectionBox_CornerInside);
+    return ETransformedBoxTestResult::BoxCornerInsideRegion;
+  }
+  if (SelectionBox::EdgesIntersectRegion(Region.Planes, Pts, Outcodes)) {
+    INC_DWORD_STAT(STAT_SelectionBox_EdgeCrossesPlane);
+    return ETransformedBoxTestResult::BoxIntersectsPlane;
+  }
+  // The rays start at the camera, which is the origin here.
+  for (const FVector3f& Ray : Region.Rays) {
+    if (SelectionBox::RayIntersectsBox(Box, FVector3f::ZeroVector, Ray)) {
+      INC_DWORD_STAT(STAT_SelectionBox_CornerRayHitsBox);
+      return ETransformedBoxTestResult::SelectionCornerIntersectsBox;
     }
   }
-  return false;
+  INC_DWORD_STAT(STAT_SelectionBox_RayRejected);
+  return ETransformedBoxTestResult::NoIntersection;
 }
 
-// Determine which region a point falls in. This is the Cohen Sutherland Algorithm. The four planes
-// we have created define a pyramid shape w/ flat sides. This breaks the space in front of the camera
-// into 9 regions: the center, and 8 volumes around the pyramid.
-static uint8 DetermineRegion(const FVector& Pt, const FRegionPlanes& Planes) {
-  if (Planes.TopPlane.PlaneDot(Pt) > 0) {
-    if (Planes.LeftPlane.PlaneDot(Pt) > 0) //	top left
-    {
-      return 9; //	1001
+// Version of BatchBoxOverlapsRegion for ESelectionQueryMode::Frustum with FSelectionQueryOptions::bCameraRelative.
+template <bool bClipPlanes>
+static bool BatchBoxOverlapsRegionCameraRelative(const SelectionBox::FCameraRelativeRegion& Region,
+                                                 const FSelectionBoxBatch& Boxes, const int32 Index) {
+  const FQuat& Rotation = Boxes.Rotations[Index];
+  const FVector& Extent = Boxes.Extents[Index];
+  // The only double precision step: everything below is relative to the camera.
+  const FVector3f Center{Boxes.Positions[Index] + Rotation.RotateVector(Boxes.Origins[Index]) - Region.Origin};
+  const SelectionBox::EOverlap SphereOverlap = Region.ClassifySphere(Center, static_cast<float>(Extent.Size()));
+  if (SphereOverlap == SelectionBox::EOverlap::Outside) {
+    INC_DWORD_STAT(STAT_SelectionBox_SphereRejected);
+    return false;
+  }
+  if (SphereOverlap == SelectionBox::EOverlap::Inside) {
+    INC_DWORD_STAT(STAT_SelectionBox_SphereAccepted);
+    return true;
+  }
+  const FQuat4f Rotation4f{Rotation};
+  const SelectionBox::TOrientedBox<FVector3f> Box{
+      Center,
+      {Rotation4f.GetAxisX() * static_cast<float>(Extent.X), Rotation4f.GetAxisY() * static_cast<float>(Extent.Y),
+       Rotation4f.GetAxisZ() * static_cast<float>(Extent.Z)}};
+  FVector3f Pts[8];
+  SelectionBox::ComputeCorners(Box, Pts);
+  if constexpr (bClipPlanes) {
+    if (Region.IsOutsideClipPlanes(Pts)) {
+      INC_DWORD_STAT(STAT_SelectionBox_ClipRejected);
+      return false;
     }
-    if (Planes.RightPlane.PlaneDot(Pt) > 0) // top right
-    {
-      return 5; //	0101
+  }
+  return TestBoxCameraRelative(Region, Box, Pts) != ETransformedBoxTestResult::NoIntersection;
+}
+
+// Version of BatchBoxOverlapsRegion for orthographic regions, in every mode.
+static bool BatchBoxOverlapsRegionOrthographic(const SelectionBox::TOrthoRegion<FVector>& Ortho,
+                                               const FRegionPlanes& Planes, const FSelectionBoxBatch& Boxes,
+                                               const int32 Index) {
+  const FQuat& Rotation = Boxes.Rotations[Index];
+  const FVector& Extent = Boxes.Extents[Index];
+  const FVector Center = Boxes.Positions[Index] + Rotation.RotateVector(Boxes.Origins[Index]);
+  // The side planes are exact here, so the sphere settles most boxes.
+  const SelectionBox::EOverlap SphereOverlap = SelectionBox::ClassifySphere(Planes, Center, Extent.Size());
+  if (SphereOverlap == SelectionBox::EOverlap::Outside) {
+    INC_DWORD_STAT(STAT_SelectionBox_SphereRejected);
+    return false;
+  }
+  if (SphereOverlap == SelectionBox::EOverlap::Inside) {
+    INC_DWORD_STAT(STAT_SelectionBox_SphereAccepted);
+    return true;
+  }
+  const SelectionBox::TOrientedBox<FVector> Box{
+      Center, {Rotation.GetAxisX() * Extent.X, Rotation.GetAxisY() * Extent.Y, Rotation.GetAxisZ() * Extent.Z}};
+  return SelectionBox::ClassifyOrthoBox(Ortho, Planes, Box) != SelectionBox::EOverlap::Outside;
+}
+
+// Mode that will actually be used by the batch queries for this region.
+static ESelectionQueryMode ResolveQueryMode(const FSelectionRegion& Region, const FSelectionQueryOptions& Options) {
+  if (Options.Mode == ESelectionQueryMode::ScreenSpace && !Region.bHasViewProjection) {
+    return ESelectionQueryMode::Frustum;
+  }
+  return Options.Mode;
+}
+
+// Call `Visit(Test)` with a callable `Test(Index)` that checks whether box `Index` of the batch overlaps the region.
+// The test is picked once, so that the loop in `Visit` is specialized for it.
+template <typename VisitType>
+static void WithBatchBoxTest(const FSelectionRegion& Region, const FRegionPlanes& Planes,
+                             const SelectionBox::FPackedRegionPlanes& PackedPlanes, const ESelectionQueryMode Mode,
+                             const bool bCameraRelative, const FSelectionBoxBatch& Boxes, VisitType&& Visit) {
+  if (Region.bOrthographic) {
+    const SelectionBox::TOrthoRegion<FVector> Ortho = SelectionBox::ToCoreOrtho(Region);
+    Visit([&](const int32 i) { return BatchBoxOverlapsRegionOrthographic(Ortho, Planes, Boxes, i); });
+  } else if (bCameraRelative && Mode == ESelectionQueryMode::Frustum) {
+    const SelectionBox::FCameraRelativeRegion Relative{Region, Planes};
+    if (Planes.HasClipPlanes()) {
+      Visit([&](const int32 i) { return BatchBoxOverlapsRegionCameraRelative<true>(Relative, Boxes, i); });
+    } else {
+      Visit([&](const int32 i) { return BatchBoxOverlapsRegionCameraRelative<false>(Relative, Boxes, i); });
     }
-    // top middle
-    return 1; //	0001
-  }
-
-  // Below bottom planes:
-  if (Planes.BottomPlane.PlaneDot(Pt) > 0) {
-    if (Planes.LeftPlane.PlaneDot(Pt) > 0) //	bottom left
-    {
-      return 10;                                   //	1010
-    } else if (Planes.RightPlane.PlaneDot(Pt) > 0) // bottom right
-    {
-      return 6; //	0110
+  } else if (Planes.HasClipPlanes()) {
+    Visit([&](const int32 i) { return BatchBoxOverlapsRegion<true>(Region, Planes, PackedPlanes, Mode, Boxes, i); });
+  } else {
+    Visit([&](const int32 i) { return BatchBoxOverlapsRegion<false>(Region, Planes, PackedPlanes, Mode, Boxes, i); });
+  }
+}
+
+// Test boxes [Begin, End) of a batch, calling `OnOverlap(Index)` for each one that overlaps the region.
+template <typename FuncType>
+static void ForEachOverlappingBatchBox(const FSelectionRegion& Region, const FRegionPlanes& Planes,
+                                       const SelectionBox::FPackedRegionPlanes& PackedPlanes,
+                                       const ESelectionQueryMode Mode, const bool bCameraRelative,
+                                       const FSelectionBoxBatch& Boxes, const int32 Begin, const int32 End,
+                                       FuncType&& OnOverlap) {
+  WithBatchBoxTest(Region, Planes, PackedPlanes, Mode, bCameraRelative, Boxes, [&](auto&& Test) {
+    for (int32 i = Begin; i < End; ++i) {
+      if (Test(i)) {
+        OnOverlap(i);
+      }
     }
-    // bottom middle
-    return 2; //	0001
+  });
+}
+
+void USelectionBoxFunctionLibrary::SelectionRegionOverlapsTransformedBoxBatch(const FSelectionRegion& Region,
+                                                                              const FRegionPlanes& Planes,
+                                                                              const FSelectionBoxBatch& Boxes,
+                                                                              TBitArray<>& ResultsOut,
+                                                                              const FSelectionQueryOptions& Options) {
+  SCOPE_CYCLE_COUNTER(STAT_SelectionBox_Batch);
+  TRACE_CPUPROFILER_EVENT_SCOPE(SelectionRegionOverlapsTransformedBoxBatch);
+  ResultsOut.Init(false, Boxes.Num());
+  if (!ensure(Boxes.IsValid())) {
+    return;
   }
+  const SelectionBox::FPackedRegionPlanes PackedPlanes{Planes};
+  const ESelectionQueryMode Mode = ResolveQueryMode(Region, Options);
+  ForEachOverlappingBatchBox(Region, Planes, PackedPlanes, Mode, Options.bCameraRelative, Boxes, 0, Boxes.Num(),
+                             [&ResultsOut](const int32 Index) { ResultsOut[Index] = true; });
 
-  //	In between top and bottom
-  if (Planes.LeftPlane.PlaneDot(Pt) > 0) //	middle left
-  {
-    return 8; //	1000
+  FSelectionBoxRecorder& Recorder = FSelectionBoxRecorder::Get();
+  if (Recorder.IsRecording()) {
+    TArray<int32> Indices;
+    for (TConstSetBitIterator<> It(ResultsOut); It; ++It) {
+      Indices.Add(It.GetIndex());
+    }
+    Recorder.Record(Region, Planes, Options, Boxes, Indices);
   }
-  if (Planes.RightPlane.PlaneDot(Pt) > 0) // middle right
-  {
-    return 4; //	0100
+}
+
+void USelectionBoxFunctionLibrary::SelectionRegionOverlapsTransformedBoxBatch(const FSelectionRegion& Region,
+                                                                              const FRegionPlanes& Planes,
+                                                                              const FSelectionBoxBatch& Boxes,
+                                                                              TArray<int32>& IndicesOut,
+                                                                              const FSelectionQueryOptions& Options) {
+  SCOPE_CYCLE_COUNTER(STAT_SelectionBox_Batch);
+  TRACE_CPUPROFILER_EVENT_SCOPE(SelectionRegionOverlapsTransformedBoxBatch);
+  IndicesOut.Reset();
+  if (!ensure(Boxes.IsValid())) {
+    return;
   }
-  return 0; //	middle
+  const SelectionBox::FPackedRegionPlanes PackedPlanes{Planes};
+  const ESelectionQueryMode Mode = ResolveQueryMode(Region, Options);
+  ForEachOverlappingBatchBox(Region, Planes, PackedPlanes, Mode, Options.bCameraRelative, Boxes, 0, Boxes.Num(),
+                             [&IndicesOut](const int32 Index) { IndicesOut.Add(Index); });
+  FSelectionBoxRecorder::Get().Record(Region, Planes, Options, Boxes, IndicesOut);
 }
 
-// Multipliers we apply to the box extent to get the corner points.
-constexpr float PointMultipliers[8][3] = {
-    {1, 1, 1},
-    {1, 1, -1},
-    {1, -1, -1},
-    {1, -1, 1},
-    {-1, 1, 1},
-    {-1, 1, -1},
-    {-1, -1, -1},
-    {-1, -1, 1},
-};
+void USelectionBoxFunctionLibrary::SelectionRegionOverlapsTransformedBoxBatchParallel(
+    const FSelectionRegion& Region, const FRegionPlanes& Planes, const FSelectionBoxBatch& Boxes,
+    TArray<int32>& IndicesOut, const FSelectionQueryOptions& Options) {
+  SCOPE_CYCLE_COUNTER(STAT_SelectionBox_BatchParallel);
+  TRACE_CPUPROFILER_EVENT_SCOPE(SelectionRegionOverlapsTransformedBoxBatchParallel);
+  IndicesOut.Reset();
+  if (!ensure(Boxes.IsValid())) {
+    return;
+  }
+  const int32 MinBatchSize = Options.MinParallelBatchSize > 0
+                                 ? Options.MinParallelBatchSize
+                                 : FMath::Max(CVarParallelMinBatchSize.GetValueOnAnyThread(), 1);
 
-struct IntPair {
-  int i;
-  int j;
-};
+  // A few chunks per worker helps balance out chunks that happen to contain more expensive boxes.
+  const int32 MaxChunks = (FTaskGraphInterface::Get().GetNumWorkerThreads() + 1) * 4;
+  const int32 NumChunks = FMath::Clamp(Boxes.Num() / MinBatchSize, 1, MaxChunks);
+  if (NumChunks == 1) {
+    SelectionRegionOverlapsTransformedBoxBatch(Region, Planes, Boxes, IndicesOut, Options);
+    return;
+  }
+  const int32 ChunkSize = FMath::DivideAndRoundUp(Boxes.Num(), NumChunks);
 
-// Defines the 12 unique edges of a box, given the offsets in PointMultipliers.
-constexpr IntPair BoxEdges[12] = {
-    {0, 1},
-    {0, 3},
-    {0, 4},
-    {1, 2},
-    {1, 5},
-    {2, 3},
-    {2, 6},
-    {3, 7},
-    {4, 5},
-    {4, 7},
-    {5, 6},
-    {6, 7},
-};
+  const SelectionBox::FPackedRegionPlanes PackedPlanes{Planes};
+  const ESelectionQueryMode Mode = ResolveQueryMode(Region, Options);
+  TArray<TArray<int32>> ChunkIndices;
+  ChunkIndices.SetNum(NumChunks);
+  ParallelFor(NumChunks, [&](const int32 Chunk) {
+    TRACE_CPUPROFILER_EVENT_SCOPE(SelectionRegionOverlapsTransformedBoxBatchParallel_Chunk);
+    TArray<int32>& ChunkOut = ChunkIndices[Chunk];
+    const int32 End = FMath::Min((Chunk + 1) * ChunkSize, Boxes.Num());
+    ForEachOverlappingBatchBox(Region, Planes, PackedPlanes, Mode, Options.bCameraRelative, Boxes, Chunk * ChunkSize,
+                               End, [&ChunkOut](const int32 Index) { ChunkOut.Add(Index); });
+  });
 
-ETransformedBoxTestResult USelectionBoxFunctionLibrary::SelectionRegionOverlapsTransformedBox(
-    const FSelectionRegion& Region, const FTransform& BoxTransform, const FVector& Origin, const FVector& Extent) {
-  return SelectionRegionOverlapsTransformedBox2(Region, Region.ComputePlanes(), BoxTransform, Origin, Extent);
+  // Merge in chunk order, so the output does not depend on scheduling:
+  int32 NumOverlapping = 0;
+  for (const TArray<int32>& ChunkOut : ChunkIndices) {
+    NumOverlapping += ChunkOut.Num();
+  }
+  IndicesOut.Reserve(NumOverlapping);
+  for (const TArray<int32>& ChunkOut : ChunkIndices) {
+    IndicesOut.Append(ChunkOut);
+  }
+  FSelectionBoxRecorder::Get().Record(Region, Planes, Options, Boxes, IndicesOut);
 }
 
-ETransformedBoxTestResult USelectionBoxFunctionLibrary::SelectionRegionOverlapsTransformedBox2(
-    const FSelectionRegion& Region, const FRegionPlanes& Planes, const FTransform& BoxTransform, const FVector& Origin,
-    const FVector& Extent) {
-  // Convert box corner points to world coordinates:
-  FVector WorldPts[8];
-  for (int i = 0; i < 8; ++i) {
-    const FVector Multiplier{PointMultipliers[i][0], PointMultipliers[i][1], PointMultipliers[i][2]};
-    WorldPts[i] = BoxTransform.TransformPosition(Extent * Multiplier + Origin);
+void USelectionBoxFunctionLibrary::SelectionRegionOverlapsActors(const FSelectionRegion& Region,
+                                                                 const TArray<AActor*>& Actors,
+                                                                 const bool bIncludeFromNonColliding,
+                                                                 const bool bIncludeChildActors,
+                                                                 const FSelectionQueryOptions& Options,
+                                                                 TArray<AActor*>& ActorsOut) {
+  ActorsOut.Reset();
+
+  // Reading component bounds is not safe off the game thread, so snapshot everything up front.
+  FSelectionBoxBatchData Boxes;
+  Boxes.Reset(Actors.Num());
+  TArray<AActor*> BoxActors;
+  BoxActors.Reserve(Actors.Num());
+  for (AActor* const Actor : Actors) {
+    if (!IsValid(Actor)) {
+      continue;
+    }
+    const FBox Box =
+        FSelectionBoxBoundsCache::Get().GetActorBounds(*Actor, bIncludeFromNonColliding, bIncludeChildActors).LocalBox;
+    Boxes.Add(Actor->GetActorTransform(), Box.GetCenter(), Box.GetExtent());
+    BoxActors.Add(Actor);
   }
 
-  // Assign regions to points
-  uint8 Regions[8];
-  for (int i = 0; i < 8; ++i) {
-    Regions[i] = DetermineRegion(WorldPts[i], Planes);
-    if (!Regions[i]) {
-      return ETransformedBoxTestResult::BoxCornerInsideRegion; // early exit, one point is within the box
+  const FRegionPlanes Planes = Region.ComputePlanes();
+  TArray<int32> Indices;
+  SelectionRegionOverlapsTransformedBoxBatchParallel(Region, Planes, Boxes.GetView(), Indices, Options);
+  ActorsOut.Reserve(Indices.Num());
+  for (const int32 Index : Indices) {
+    AActor* const Actor = BoxActors[Index];
+    if (!Options.bRefineComponents ||
+        SelectionRegionOverlapsActorComponents2(Region, Planes, Actor, bIncludeFromNonColliding, bIncludeChildActors)) {
+      ActorsOut.Add(Actor);
     }
   }
+}
 
-  // Check the edges for intersection
-  for (const IntPair& Line : BoxEdges) {
-    const uint8 RegionFirst = Regions[Line.i];
-    const uint8 RegionSecond = Regions[Line.j];
-    const bool bMightIntersect = (RegionFirst & RegionSecond) == 0;
-    constexpr bool bUseEarlyExit = true; // Shaves about ~15% off if a lot of boxes don't overlap at all.
-
-    // If this test fails (cohen sutherland algorithm) then we can early exit this line, it can't possibly intersect
-    if (!bMightIntersect && bUseEarlyExit) {
-      // Cannot pass through, draw point...
+// A box waiting to be tested by a capped query. Lower keys are tested first, and ties go to the lower index so the
+// result does not depend on the heap layout.
+struct FPrioritizedBox {
+  double Key;
+  int32 Index;
+
+  bool operator<(const FPrioritizedBox& Other) const {
+    return Key < Other.Key || (Key == Other.Key && Index < Other.Index);
+  }
+};
+
+// Test the boxes of a batch in the order given by `Priority`, passing each one that overlaps the region to
+// `Accept(Index)`. Stops once `Accept` has returned true `MaxCount` times.
+template <typename FuncType>
+static void ForEachOverlappingBatchBoxByPriority(const FSelectionRegion& Region, const FRegionPlanes& Planes,
+                                                 const FSelectionBoxBatch& Boxes, const int32 MaxCount,
+                                                 const ESelectionPriority Priority,
+                                                 const TArrayView<const float> Scores,
+                                                 const FSelectionQueryOptions& Options, FuncType&& Accept) {
+  const FVector CenterRay =
+      (Region.TopLeftRay + Region.TopRightRay + Region.BottomLeftRay + Region.BottomRightRay).GetSafeNormal();
+  const FVector Forward = Region.ViewDirection.IsNearlyZero() ? CenterRay : Region.ViewDirection.GetSafeNormal();
+
+  // The keys only need the centers, so every box that survives the sphere test goes in the heap before any of the
+  // more expensive tests run.
+  TArray<FPrioritizedBox> Candidates;
+  Candidates.Reserve(Boxes.Num());
+  for (int32 i = 0; i < Boxes.Num(); ++i) {
+    const FVector Center = Boxes.Positions[i] + Boxes.Rotations[i].RotateVector(Boxes.Origins[i]);
+    if (!USelectionBoxFunctionLibrary::SelectionRegionOverlapsSphere2(Planes, Center, Boxes.Extents[i].Size())) {
+      INC_DWORD_STAT(STAT_SelectionBox_SphereRejected);
       continue;
     }
+    const FVector FromCamera = Center - Region.CameraOrigin;
+    double Key;
+    switch (Priority) {
+      case ESelectionPriority::CameraDepth:
+        Key = FVector::DotProduct(FromCamera, Forward);
+        break;
+      case ESelectionPriority::Score:
+        Key = -static_cast<double>(Scores[i]);
+        break;
+      default:
+        // In an orthographic view, the distance from the center of the selection box on screen is the distance
+        // from the ray through it.
+        Key = Region.bOrthographic ? FVector::VectorPlaneProject(FromCamera, Forward).SizeSquared()
+                                   : -FVector::DotProduct(FromCamera.GetSafeNormal(), CenterRay);
+        break;
+    }
+    Candidates.Add(FPrioritizedBox{Key, i});
+  }
+  Candidates.Heapify();
 
-    // Might still pass through, check it against the planes:
-    FVector IntersectionPt;
-
-    // Left plane
-    const bool bIntersectsLeft = FMath::SegmentPlaneIntersection(WorldPts[Line.i],
-                                                                 WorldPts[Line.j], Planes.LeftPlane,
-                                                                 IntersectionPt);
-    if (bIntersectsLeft) {
-      // check that we are within the top/bottom plane
-      if (Planes.TopPlane.PlaneDot(IntersectionPt) <= 0 && Planes.BottomPlane.PlaneDot(IntersectionPt) <= 0) {
-        // Intersection point is in the middle (horizontal)
-        return ETransformedBoxTestResult::BoxIntersectsPlane;
+  const SelectionBox::FPackedRegionPlanes PackedPlanes{Planes};
+  const ESelectionQueryMode Mode = ResolveQueryMode(Region, Options);
+  WithBatchBoxTest(Region, Planes, PackedPlanes, Mode, Options.bCameraRelative, Boxes, [&](auto&& Test) {
+    int32 NumAccepted = 0;
+    while (NumAccepted < MaxCount && Candidates.Num() > 0) {
+      FPrioritizedBox Candidate;
+      Candidates.HeapPop(Candidate);
+      if (Test(Candidate.Index) && Accept(Candidate.Index)) {
+        ++NumAccepted;
       }
     }
+  });
+  if (Candidates.Num() > 0) {
+    INC_DWORD_STAT_BY(STAT_SelectionBox_TopKSkipped, Candidates.Num());
+  }
+}
 
-    // Right plane
-    const bool bIntersectsRight = FMath::SegmentPlaneIntersection(WorldPts[Line.i],
-                                                                  WorldPts[Line.j], Planes.RightPlane,
-                                                                  IntersectionPt);
-    if (bIntersectsRight) {
-      // check that we are within the top/bottom plane
-      if (Planes.TopPlane.PlaneDot(IntersectionPt) <= 0 && Planes.BottomPlane.PlaneDot(IntersectionPt) <= 0) {
-        // intersection point is in the middle (horizontal)
-        return ETransformedBoxTestResult::BoxIntersectsPlane;
-      }
+void USelectionBoxFunctionLibrary::SelectionRegionOverlapsTransformedBoxBatchTopK(
+    const FSelectionRegion& Region, const FRegionPlanes& Planes, const FSelectionBoxBatch& Boxes,
+    const int32 MaxCount, const ESelectionPriority Priority, const TArrayView<const float> Scores,
+    TArray<int32>& IndicesOut, const FSelectionQueryOptions& Options) {
+  SCOPE_CYCLE_COUNTER(STAT_SelectionBox_TopK);
+  TRACE_CPUPROFILER_EVENT_SCOPE(SelectionRegionOverlapsTransformedBoxBatchTopK);
+  IndicesOut.Reset();
+  if (!ensure(Boxes.IsValid()) || MaxCount <= 0) {
+    return;
+  }
+  if (!ensureMsgf(Priority != ESelectionPriority::Score || Scores.Num() == Boxes.Num(),
+                  TEXT("Expected one score per box (%d), got %d."), Boxes.Num(), Scores.Num())) {
+    return;
+  }
+  IndicesOut.Reserve(FMath::Min(MaxCount, Boxes.Num()));
+  ForEachOverlappingBatchBoxByPriority(Region, Planes, Boxes, MaxCount, Priority, Scores, Options,
+                                       [&IndicesOut](const int32 Index) {
+                                         IndicesOut.Add(Index);
+                                         return true;
+                                       });
+}
+
+void USelectionBoxFunctionLibrary::SelectionRegionOverlapsActorsTopK(
+    const FSelectionRegion& Region, const TArray<AActor*>& Actors, const bool bIncludeFromNonColliding,
+    const bool bIncludeChildActors, const int32 MaxCount, const ESelectionPriority Priority,
+    const TArray<float>& Scores, const FSelectionQueryOptions& Options, TArray<AActor*>& ActorsOut) {
+  SCOPE_CYCLE_COUNTER(STAT_SelectionBox_TopK);
+  TRACE_CPUPROFILER_EVENT_SCOPE(SelectionRegionOverlapsActorsTopK);
+  ActorsOut.Reset();
+  if (MaxCount <= 0) {
+    return;
+  }
+  const bool bUseScores = Priority == ESelectionPriority::Score;
+  if (!ensureMsgf(!bUseScores || Scores.Num() == Actors.Num(), TEXT("Expected one score per actor (%d), got %d."),
+                  Actors.Num(), Scores.Num())) {
+    return;
+  }
+
+  // Same snapshot as SelectionRegionOverlapsActors, keeping the scores of the valid actors in step with the boxes.
+  FSelectionBoxBatchData Boxes;
+  Boxes.Reset(Actors.Num());
+  TArray<AActor*> BoxActors;
+  BoxActors.Reserve(Actors.Num());
+  TArray<float> BoxScores;
+  BoxScores.Reserve(bUseScores ? Actors.Num() : 0);
+  for (int32 i = 0; i < Actors.Num(); ++i) {
+    AActor* const Actor = Actors[i];
+    if (!IsValid(Actor)) {
+      continue;
+    }
+    const FBox Box =
+        FSelectionBoxBoundsCache::Get().GetActorBounds(*Actor, bIncludeFromNonColliding, bIncludeChildActors).LocalBox;
+    Boxes.Add(Actor->GetActorTransform(), Box.GetCenter(), Box.GetExtent());
+    BoxActors.Add(Actor);
+    if (bUseScores) {
+      BoxScores.Add(Scores[i]);
     }
+  }
+
+  const FRegionPlanes Planes = Region.ComputePlanes();
+  ActorsOut.Reserve(FMath::Min(MaxCount, BoxActors.Num()));
+  // Refining by component happens before an actor counts towards `MaxCount`, so rejected actors do not use up the
+  // budget.
+  ForEachOverlappingBatchBoxByPriority(
+      Region, Planes, Boxes.GetView(), MaxCount, Priority, BoxScores, Options, [&](const int32 Index) {
+        AActor* const Actor = BoxActors[Index];
+        if (Options.bRefineComponents &&
+            !SelectionRegionOverlapsActorComponents2(Region, Planes, Actor, bIncludeFromNonColliding,
+                                                     bIncludeChildActors)) {
+          return false;
+        }
+        ActorsOut.Add(Actor);
+        return true;
+      });
+}
 
-    // Top plane
-    const bool bIntersectsTop = FMath::SegmentPlaneIntersection(WorldPts[Line.i],
-                                                                WorldPts[Line.j], Planes.TopPlane,
-                                                                IntersectionPt);
-    if (bIntersectsTop) {
-      // check that we are within the left/right planes
-      if (Planes.LeftPlane.PlaneDot(IntersectionPt) <= 0 && Planes.RightPlane.PlaneDot(IntersectionPt) <= 0) {
-        // intersection point is in the middle (vertical)
-        return ETransformedBoxTestResult::BoxIntersectsPlane;
+// Walk the cluster tree of a HISM. The instances of clusters entirely inside the region are added to
+// `InstancesOut`, and those of the leaf clusters that straddle it to `Candidates`.
+static void GatherClusterInstances(const FRegionPlanes& Planes,
+                                   const UHierarchicalInstancedStaticMeshComponent& Component,
+                                   TArray<int32>& InstancesOut, TArray<int32>& Candidates) {
+  const TArray<FClusterNode>& Nodes = *Component.ClusterTreePtr;
+  const FTransform& ComponentTransform = Component.GetComponentTransform();
+  const SelectionBox::FPackedRegionPlanes PackedPlanes{Planes};
+  TArray<int32, TInlineAllocator<64>> Stack;
+  Stack.Add(0);
+  while (Stack.Num() > 0) {
+    const FClusterNode& Node = Nodes[Stack.Pop()];
+    // The node bounds enclose the mesh bounds of every instance under it, in the frame of the component.
+    const FVector BoundMin{Node.BoundMin};
+    const FVector BoundMax{Node.BoundMax};
+    FVector WorldPts[8];
+    SelectionBox::ComputeCorners(ComponentTransform, (BoundMin + BoundMax) * 0.5, (BoundMax - BoundMin) * 0.5,
+                                 WorldPts);
+    const SelectionBox::FCornerOutcodes Outcodes = SelectionBox::ClassifyCorners(PackedPlanes, WorldPts);
+    const SelectionBox::FClipOutcodes ClipOutcodes = SelectionBox::ClassifyClipCorners(Planes, WorldPts);
+    if (Outcodes.AllOutside || ClipOutcodes.AllOutside) {
+      INC_DWORD_STAT(STAT_SelectionBox_ClustersCulled);
+      continue;
+    }
+    const bool bInside = Outcodes.AllInside && ClipOutcodes.AllInside;
+    if (bInside) {
+      INC_DWORD_STAT(STAT_SelectionBox_ClustersInside);
+    }
+    if (bInside || Node.FirstChild < 0) {
+      // Every node covers a contiguous range of the instances, in render order.
+      TArray<int32>& Out = bInside ? InstancesOut : Candidates;
+      for (int32 RenderIndex = Node.FirstInstance; RenderIndex <= Node.LastInstance; ++RenderIndex) {
+        Out.Add(Component.SortedInstances[RenderIndex]);
+      }
+    } else {
+      for (int32 Child = Node.FirstChild; Child <= Node.LastChild; ++Child) {
+        Stack.Add(Child);
       }
     }
+  }
+}
 
-    // Bottom plane:
-    const bool bIntersectsBottom = FMath::SegmentPlaneIntersection(WorldPts[Line.i],
-                                                                   WorldPts[Line.j], Planes.BottomPlane,
-                                                                   IntersectionPt);
-    if (bIntersectsBottom) {
-      if (Planes.LeftPlane.PlaneDot(IntersectionPt) <= 0 && Planes.RightPlane.PlaneDot(IntersectionPt) <= 0) {
-        // intersection point is in the middle (vertical)
-        return ETransformedBoxTestResult::BoxIntersectsPlane;
-      }
+void USelectionBoxFunctionLibrary::SelectionRegionOverlapsInstances(const FSelectionRegion& Region,
+                                                                    const UInstancedStaticMeshComponent* Component,
+                                                                    const FSelectionQueryOptions& Options,
+                                                                    TArray<int32>& InstancesOut) {
+  SCOPE_CYCLE_COUNTER(STAT_SelectionBox_OverlapsInstances);
+  TRACE_CPUPROFILER_EVENT_SCOPE(SelectionRegionOverlapsInstances);
+  InstancesOut.Reset();
+  if (!IsValid(Component) || !Component->GetStaticMesh() || Component->GetInstanceCount() == 0) {
+    return;
+  }
+  const FRegionPlanes Planes = Region.ComputePlanes();
+  if (!SelectionRegionOverlapsSphere2(Planes, Component->Bounds.Origin, Component->Bounds.SphereRadius)) {
+    INC_DWORD_STAT(STAT_SelectionBox_SphereRejected);
+    return;
+  }
+
+  // Instances that need to be tested one by one.
+  TArray<int32> Candidates;
+  const UHierarchicalInstancedStaticMeshComponent* const Hierarchical =
+      Cast<UHierarchicalInstancedStaticMeshComponent>(Component);
+  if (Hierarchical && Hierarchical->IsTreeFullyBuilt() && Hierarchical->ClusterTreePtr.IsValid() &&
+      Hierarchical->ClusterTreePtr->Num() > 0 &&
+      Hierarchical->SortedInstances.Num() == Hierarchical->GetInstanceCount()) {
+    GatherClusterInstances(Planes, *Hierarchical, InstancesOut, Candidates);
+  } else {
+    Candidates.Reserve(Component->GetInstanceCount());
+    for (int32 i = 0; i < Component->GetInstanceCount(); ++i) {
+      Candidates.Add(i);
     }
   }
 
-  // Finally check all the rays:
-  if (RayIntersectsTransformedBox(Region.CameraOrigin, Region.TopLeftRay, BoxTransform, Origin, Extent) ||
-      RayIntersectsTransformedBox(Region.CameraOrigin, Region.TopRightRay, BoxTransform, Origin, Extent) ||
-      RayIntersectsTransformedBox(Region.CameraOrigin, Region.BottomLeftRay, BoxTransform, Origin, Extent) ||
-      RayIntersectsTransformedBox(Region.CameraOrigin, Region.BottomRightRay, BoxTransform, Origin, Extent)) {
-    return ETransformedBoxTestResult::SelectionCornerIntersectsBox;
+  const FBoxSphereBounds MeshBounds = Component->GetStaticMesh()->GetBounds();
+  FSelectionBoxBatchData Boxes;
+  Boxes.Reset(Candidates.Num());
+  for (const int32 InstanceIndex : Candidates) {
+    FTransform InstanceTransform;
+    Component->GetInstanceTransform(InstanceIndex, InstanceTransform, true);
+    Boxes.Add(InstanceTransform, MeshBounds.Origin, MeshBounds.BoxExtent);
   }
-  return ETransformedBoxTestResult::NoIntersection;
+  TArray<int32> Indices;
+  SelectionRegionOverlapsTransformedBoxBatchParallel(Region, Planes, Boxes.GetView(), Indices, Options);
+  for (const int32 Index : Indices) {
+    InstancesOut.Add(Candidates[Index]);
+  }
+  InstancesOut.Sort();
+}
+
+bool USelectionBoxFunctionLibrary::ValidateSelectedActors(const FSelectionRegion& Region,
+                                                          const TArray<AActor*>& ClaimedActors,
+                                                          const bool bIncludeFromNonColliding,
+                                                          const bool bIncludeChildActors, const float Tolerance,
+                                                          TArray<AActor*>& RejectedOut) {
+  TRACE_CPUPROFILER_EVENT_SCOPE(ValidateSelectedActors);
+  RejectedOut.Reset();
+
+  FSelectionBoxBatchData Boxes;
+  Boxes.Reset(ClaimedActors.Num());
+  TArray<AActor*> BoxActors;
+  BoxActors.Reserve(ClaimedActors.Num());
+  const FVector Padding{FMath::Max(Tolerance, 0.0f)};
+  for (AActor* const Actor : ClaimedActors) {
+    if (!IsValid(Actor)) {
+      continue;
+    }
+    const FBox Box =
+        FSelectionBoxBoundsCache::Get().GetActorBounds(*Actor, bIncludeFromNonColliding, bIncludeChildActors).LocalBox;
+    // Add() folds the scale of the actor into the extent, so pad afterwards to keep the tolerance in world units.
+    const int32 Index = Boxes.Add(Actor->GetActorTransform(), Box.GetCenter(), Box.GetExtent());
+    Boxes.Extents[Index] += Padding;
+    BoxActors.Add(Actor);
+  }
+
+  TArray<int32> Indices;
+  SelectionRegionOverlapsTransformedBoxBatchParallel(Region, Region.ComputePlanes(), Boxes.GetView(), Indices);
+  // The overlapping indices are ascending, so the rejected actors are the gaps between them.
+  int32 NextOverlapping = 0;
+  for (int32 i = 0; i < BoxActors.Num(); ++i) {
+    if (Indices.IsValidIndex(NextOverlapping) && Indices[NextOverlapping] == i) {
+      ++NextOverlapping;
+    } else {
+      RejectedOut.Add(BoxActors[i]);
+    }
+  }
+  return RejectedOut.Num() == 0;
+}
+
+// Check the bounding sphere of box `Index` of a batch against the ray, as in SelectionBox::RayEntersSphere.
+static bool RayEntersBatchSphere(const FVector& RayOrigin, const FVector& Direction, const FSelectionBoxBatch& Boxes,
+                                 const int32 Index, const double MaxDistance, double& EntryOut) {
+  const FVector Center = Boxes.Positions[Index] + Boxes.Rotations[Index].RotateVector(Boxes.Origins[Index]);
+  return SelectionBox::RayEntersSphere(RayOrigin, Direction, Center, Boxes.Extents[Index].Size(), MaxDistance,
+                                       EntryOut);
+}
+
+// Test box `Index` of a batch against the ray, and make it the nearest hit if the ray enters it before `BestDistance`.
+static void PickBatchBox(const FVector& RayOrigin, const FVector& Direction, const FSelectionBoxBatch& Boxes,
+                         const int32 Index, double& BestDistance, int32& BestIndex) {
+  INC_DWORD_STAT(STAT_SelectionBox_PickBoxesTested);
+  const FVector& Position = Boxes.Positions[Index];
+  const FQuat& Rotation = Boxes.Rotations[Index];
+  const FVector& Origin = Boxes.Origins[Index];
+  const FVector& Extent = Boxes.Extents[Index];
+  double Distance;
+  if (SelectionBox::RayEntersLocalBox(Rotation.UnrotateVector(RayOrigin - Position), Rotation.UnrotateVector(Direction),
+                                     Origin - Extent, Origin + Extent, BestDistance, Distance) &&
+      Distance < BestDistance) {
+    BestDistance = Distance;
+    BestIndex = Index;
+  }
+}
+
+namespace {
+
+// A box of the batch whose bounding sphere the ray enters at `Distance`.
+struct FBatchPickCandidate {
+  double Distance;
+  int32 Index;
+
+  bool operator<(const FBatchPickCandidate& Other) const { return Distance < Other.Distance; }
+};
+
+}  // namespace
+
+int32 USelectionBoxFunctionLibrary::PickTransformedBoxBatch(const FVector& RayOrigin, const FVector& RayDirection,
+                                                            const FSelectionBoxBatch& Boxes, double& DistanceOut,
+                                                            const int32 HintIndex) {
+  SCOPE_CYCLE_COUNTER(STAT_SelectionBox_Pick);
+  TRACE_CPUPROFILER_EVENT_SCOPE(PickTransformedBoxBatch);
+  DistanceOut = 0;
+  const FVector Direction = RayDirection.GetSafeNormal();
+  if (!ensure(Boxes.IsValid()) || Direction.IsZero()) {
+    return INDEX_NONE;
+  }
+  double BestDistance = TNumericLimits<double>::Max();
+  int32 BestIndex = INDEX_NONE;
+  double Entry;
+  if (Boxes.Positions.IsValidIndex(HintIndex) &&
+      RayEntersBatchSphere(RayOrigin, Direction, Boxes, HintIndex, BestDistance, Entry)) {
+    PickBatchBox(RayOrigin, Direction, Boxes, HintIndex, BestDistance, BestIndex);
+  }
+
+  // Every sphere has to be checked, but the boxes are then tested nearest sphere first, which stops as soon as the
+  // next sphere starts beyond the best hit.
+  TArray<FBatchPickCandidate, TInlineAllocator<64>> Candidates;
+  for (int32 i = 0; i < Boxes.Num(); ++i) {
+    if (i != HintIndex && RayEntersBatchSphere(RayOrigin, Direction, Boxes, i, BestDistance, Entry)) {
+      Candidates.Add(FBatchPickCandidate{Entry, i});
+    }
+  }
+  Candidates.Heapify();
+  while (Candidates.Num() > 0) {
+    FBatchPickCandidate Candidate;
+    Candidates.HeapPop(Candidate);
+    if (Candidate.Distance >= BestDistance) {
+      break;
+    }
+    PickBatchBox(RayOrigin, Direction, Boxes, Candidate.Index, BestDistance, BestIndex);
+  }
+  if (BestIndex != INDEX_NONE) {
+    DistanceOut = BestDistance;
+  }
+  return BestIndex;
 }
 
 bool USelectionBoxFunctionLibrary::SelectionRegionOverlapsSphere(const FSelectionRegion& Region,
@@ -291,29 +1105,49 @@ bool USelectionBoxFunctionLibrary::SelectionRegionOverlapsSphere(const FSelectio
   return SelectionRegionOverlapsSphere2(Region.ComputePlanes(), SphereOrigin, Radius);
 }
 
+ESelectionOverlap USelectionBoxFunctionLibrary::SelectionRegionClassifySphere(const FRegionPlanes& Planes,
+                                                                              const FVector& SphereOrigin,
+                                                                              const float Radius) {
+  return static_cast<ESelectionOverlap>(SelectionBox::ClassifySphere(Planes, SphereOrigin, Radius));
+}
+
 bool USelectionBoxFunctionLibrary::SelectionRegionOverlapsSphere2(const FRegionPlanes& Planes,
                                                                   const FVector& SphereOrigin,
                                                                   const float Radius) {
-  const float DLeft = Planes.LeftPlane.PlaneDot(SphereOrigin);
-  const float DRight = Planes.RightPlane.PlaneDot(SphereOrigin);
-  const float DTop = Planes.TopPlane.PlaneDot(SphereOrigin);
-  const float DBottom = Planes.BottomPlane.PlaneDot(SphereOrigin);
-
-  // Determine whether we are either (1) within the radius (0 < D < R) or behind the plane altogether (D < 0)
-  const bool bWithinRadiusOfLeftPlane = DLeft < Radius;
-  const bool bWithinRadiusOfRightPlane = DRight < Radius;
-  const bool bWithinRadiusOfTopPlane = DTop < Radius;
-  const bool bWithinRadiusOfBottomPlane = DBottom < Radius;
-
-  // need to be either behind or within all 4
-  return bWithinRadiusOfLeftPlane && bWithinRadiusOfRightPlane && bWithinRadiusOfTopPlane &&
-         bWithinRadiusOfBottomPlane;
+  for (int32 p = 0; p < Planes.NumClipPlanes; ++p) {
+    if (Planes.ClipPlanes[p].PlaneDot(SphereOrigin) >= Radius) {
+      return false;
+    }
+  }
+  return SelectionBox::SphereOverlapsRegion(SelectionBox::ToCore(Planes), SphereOrigin,
+                                            static_cast<FVector::FReal>(Radius));
 }
 
 bool USelectionBoxFunctionLibrary::CreateSelectionRegionForBoxCorners(APlayerController* const Controller,
                                                                       const FVector2D& PixelCoordinates1,
                                                                       const FVector2D& PixelCoordinates2,
                                                                       FSelectionRegion& RegionOut) {
+  ULocalPlayer* const LocalPlayer = IsValid(Controller) ? Controller->GetLocalPlayer() : nullptr;
+  if (!LocalPlayer || !LocalPlayer->ViewportClient) {
+    return false;
+  }
+
+  // get the projection data
+  FSceneViewProjectionData ProjectionData;
+  if (!LocalPlayer->GetProjectionData(LocalPlayer->ViewportClient->Viewport, eSSP_FULL, /*out*/ ProjectionData)) {
+    return false;
+  }
+  CreateSelectionRegionFromViewProjection(ProjectionData.ComputeViewProjectionMatrix(),
+                                          ProjectionData.GetConstrainedViewRect(), PixelCoordinates1,
+                                          PixelCoordinates2, RegionOut);
+  return true;
+}
+
+void USelectionBoxFunctionLibrary::CreateSelectionRegionFromViewProjection(const FMatrix& ViewProjectionMatrix,
+                                                                           const FIntRect& ViewRect,
+                                                                           const FVector2D& PixelCoordinates1,
+                                                                           const FVector2D& PixelCoordinates2,
+                                                                           FSelectionRegion& RegionOut) {
   const FVector2D TopLeft{
       FMath::Min(PixelCoordinates1.X, PixelCoordinates2.X), FMath::Min(PixelCoordinates1.Y, PixelCoordinates2.Y)
   };
@@ -326,47 +1160,82 @@ bool USelectionBoxFunctionLibrary::CreateSelectionRegionForBoxCorners(APlayerCon
   const FVector2D BottomLeft{
       FMath::Min(PixelCoordinates1.X, PixelCoordinates2.X), FMath::Max(PixelCoordinates1.Y, PixelCoordinates2.Y)
   };
+  const FMatrix InvViewProjMatrix = ViewProjectionMatrix.InverseFast();
 
-  ULocalPlayer* const LocalPlayer = IsValid(Controller) ? Controller->GetLocalPlayer() : nullptr;
-  if (!LocalPlayer || !LocalPlayer->ViewportClient) {
-    return false;
-  }
+  // De-project the rays to world unit vectors. With a perspective projection they all start at the camera, but
+  // with an orthographic one each starts from its own point on the view plane.
+  FVector TopLeftOrigin;
+  FVector TopRightOrigin;
+  FVector BottomRightOrigin;
+  FVector BottomLeftOrigin;
+  FSceneView::DeprojectScreenToWorld(TopLeft, ViewRect, InvViewProjMatrix, TopLeftOrigin, RegionOut.TopLeftRay);
+  FSceneView::DeprojectScreenToWorld(TopRight, ViewRect, InvViewProjMatrix, TopRightOrigin, RegionOut.TopRightRay);
+  FSceneView::DeprojectScreenToWorld(BottomRight, ViewRect, InvViewProjMatrix, BottomRightOrigin,
+                                     RegionOut.BottomRightRay);
+  FSceneView::DeprojectScreenToWorld(BottomLeft, ViewRect, InvViewProjMatrix, BottomLeftOrigin,
+                                     RegionOut.BottomLeftRay);
 
-  // get the projection data
-  FSceneViewProjectionData ProjectionData;
-  if (!LocalPlayer->GetProjectionData(LocalPlayer->ViewportClient->Viewport, eSSP_FULL, /*out*/ ProjectionData)) {
-    return false;
+  // An orthographic projection leaves W alone, so the last column of the matrix is (0, 0, 0, 1).
+  RegionOut.bOrthographic = FMath::IsNearlyZero(ViewProjectionMatrix.M[0][3]) &&
+                            FMath::IsNearlyZero(ViewProjectionMatrix.M[1][3]) &&
+                            FMath::IsNearlyZero(ViewProjectionMatrix.M[2][3]);
+  if (RegionOut.bOrthographic) {
+    RegionOut.CameraOrigin = (TopLeftOrigin + TopRightOrigin + BottomRightOrigin + BottomLeftOrigin) * 0.25;
+    RegionOut.OrthoRightExtent = (TopRightOrigin - TopLeftOrigin + BottomRightOrigin - BottomLeftOrigin) * 0.25;
+    RegionOut.OrthoUpExtent = (TopLeftOrigin - BottomLeftOrigin + TopRightOrigin - BottomRightOrigin) * 0.25;
+  } else {
+    // The de-projected origins lie on the near plane, so they move with the corners. The eye is the one point that
+    // every ray passes through: it has view depth 0, which the projection maps to clip W = 0 and X = Y = 0.
+    const FVector4 Eye = InvViewProjMatrix.TransformFVector4(FVector4{0, 0, 1, 0});
+    RegionOut.CameraOrigin = FMath::IsNearlyZero(Eye.W) ? TopLeftOrigin : FVector{Eye} / Eye.W;
+    RegionOut.OrthoRightExtent = FVector::ZeroVector;
+    RegionOut.OrthoUpExtent = FVector::ZeroVector;
   }
-  const FMatrix InvViewProjMatrix = ProjectionData.ComputeViewProjectionMatrix().InverseFast();
-
-  // De-project the rays to world unit vectors
-  FSceneView::DeprojectScreenToWorld(TopLeft, ProjectionData.GetConstrainedViewRect(),
-                                     InvViewProjMatrix, RegionOut.CameraOrigin, RegionOut.TopLeftRay);
-  FSceneView::DeprojectScreenToWorld(TopRight, ProjectionData.GetConstrainedViewRect(),
-                                     InvViewProjMatrix, RegionOut.CameraOrigin, RegionOut.TopRightRay);
-  FSceneView::DeprojectScreenToWorld(BottomRight, ProjectionData.GetConstrainedViewRect(),
-                                     InvViewProjMatrix, RegionOut.CameraOrigin, RegionOut.BottomRightRay);
-  FSceneView::DeprojectScreenToWorld(BottomLeft, ProjectionData.GetConstrainedViewRect(),
-                                     InvViewProjMatrix, RegionOut.CameraOrigin, RegionOut.BottomLeftRay);
-  return true;
+
+  // Keep the projection around for the screen-space test. Pixel Y points down, NDC Y points up.
+  const auto PixelToNdc = [&ViewRect](const FVector2D& Pixel) {
+    return FVector2D{(Pixel.X - ViewRect.Min.X) / ViewRect.Width() * 2 - 1,
+                     1 - (Pixel.Y - ViewRect.Min.Y) / ViewRect.Height() * 2};
+  };
+  FVector ViewRayOrigin;
+  FSceneView::DeprojectScreenToWorld(FVector2D{ViewRect.Min + ViewRect.Max} * 0.5, ViewRect, InvViewProjMatrix,
+                                     ViewRayOrigin, RegionOut.ViewDirection);
+  RegionOut.bHasViewProjection = true;
+  RegionOut.ViewProjectionMatrix = ViewProjectionMatrix;
+  RegionOut.ScreenMin = PixelToNdc(BottomLeft);
+  RegionOut.ScreenMax = PixelToNdc(TopRight);
 }
 
 bool USelectionBoxFunctionLibrary::SelectionRegionOverlapsComponent(const FSelectionRegion& Region,
                                                                     const USceneComponent* const Component) {
+  return SelectionRegionOverlapsComponent2(Region, Region.ComputePlanes(), Component);
+}
+
+bool USelectionBoxFunctionLibrary::SelectionRegionOverlapsComponent2(const FSelectionRegion& Region,
+                                                                     const FRegionPlanes& Planes,
+                                                                     const USceneComponent* const Component) {
+  SCOPE_CYCLE_COUNTER(STAT_SelectionBox_OverlapsComponent);
+  TRACE_CPUPROFILER_EVENT_SCOPE(SelectionRegionOverlapsComponent);
   if (!IsValid(Component)) {
     return false;
   }
   const FBoxSphereBounds LocalBounds = Component->CalcLocalBounds();
   const FTransform& ComponentTransform = Component->GetComponentTransform();
 
-  // Compute planes in the world frame, and the box in the world frame.
+  // Compute the box in the world frame.
   const FBoxSphereBounds BoxWorld = LocalBounds.TransformBy(ComponentTransform);
-  const FRegionPlanes Planes = Region.ComputePlanes();
 
-  // Possibly eliminate w/ the sphere check first.
-  if (!SelectionRegionOverlapsSphere2(Planes, BoxWorld.Origin, BoxWorld.SphereRadius)) {
+  // Possibly settle it w/ the sphere check first.
+  const SelectionBox::EOverlap SphereOverlap =
+      SelectionBox::ClassifySphere(Planes, BoxWorld.Origin, BoxWorld.SphereRadius);
+  if (SphereOverlap == SelectionBox::EOverlap::Outside) {
+    INC_DWORD_STAT(STAT_SelectionBox_SphereRejected);
     return false;
   }
+  if (SphereOverlap == SelectionBox::EOverlap::Inside) {
+    INC_DWORD_STAT(STAT_SelectionBox_SphereAccepted);
+    return true;
+  }
 
   const ETransformedBoxTestResult Result = SelectionRegionOverlapsTransformedBox2(
       Region, Planes, ComponentTransform, LocalBounds.Origin,
@@ -378,22 +1247,109 @@ bool USelectionBoxFunctionLibrary::SelectionRegionOverlapsActor(const FSelection
                                                                 const AActor* const Actor,
                                                                 const bool bIncludeFromNonColliding,
                                                                 const bool bIncludeChildActors) {
+  SCOPE_CYCLE_COUNTER(STAT_SelectionBox_OverlapsActor);
+  TRACE_CPUPROFILER_EVENT_SCOPE(SelectionRegionOverlapsActor);
   if (!IsValid(Actor)) {
     return false;
   }
-  const FBox Box = Actor->CalculateComponentsBoundingBoxInLocalSpace(bIncludeFromNonColliding, bIncludeChildActors);
-  const FBoxSphereBounds BoxWorld = Box.TransformBy(Actor->GetActorTransform());
+  const FSelectionBoxBoundsCache::FBounds Bounds =
+      FSelectionBoxBoundsCache::Get().GetActorBounds(*Actor, bIncludeFromNonColliding, bIncludeChildActors);
+  const FBox& Box = Bounds.LocalBox;
+  const FTransform& ActorTransform = Actor->GetActorTransform();
 
   // Pre-compute planes, which we need for the full check anyways:
   const FRegionPlanes Planes = Region.ComputePlanes();
 
   // Check if we can skip the rest of the check by evaluating the bounding world-frame sphere:
-  if (!SelectionRegionOverlapsSphere2(Planes, BoxWorld.Origin, BoxWorld.SphereRadius)) {
+  const FVector SphereOrigin = ActorTransform.TransformPosition(Box.GetCenter());
+  const double SphereRadius = Bounds.SphereRadius * ActorTransform.GetMaximumAxisScale();
+  const SelectionBox::EOverlap SphereOverlap = SelectionBox::ClassifySphere(Planes, SphereOrigin, SphereRadius);
+  if (SphereOverlap == SelectionBox::EOverlap::Outside) {
+    INC_DWORD_STAT(STAT_SelectionBox_SphereRejected);
     return false;
   }
+  if (SphereOverlap == SelectionBox::EOverlap::Inside) {
+    INC_DWORD_STAT(STAT_SelectionBox_SphereAccepted);
+    return true;
+  }
 
   // If not, run the full test:
   const ETransformedBoxTestResult Result = SelectionRegionOverlapsTransformedBox2(
-      Region, Planes, Actor->GetActorTransform(), Box.GetCenter(), Box.GetExtent());
+      Region, Planes, ActorTransform, Box.GetCenter(), Box.GetExtent());
   return Result != ETransformedBoxTestResult::NoIntersection;
 }
+
+bool USelectionBoxFunctionLibrary::SelectionRegionOverlapsActorComponents(const FSelectionRegion& Region,
+                                                                          const AActor* const Actor,
+                                                                          const bool bIncludeFromNonColliding,
+                                                                          const bool bIncludeChildActors) {
+  return SelectionRegionOverlapsActorComponents2(Region, Region.ComputePlanes(), Actor, bIncludeFromNonColliding,
+                                                 bIncludeChildActors);
+}
+
+bool USelectionBoxFunctionLibrary::SelectionRegionOverlapsActorComponents2(const FSelectionRegion& Region,
+                                                                           const FRegionPlanes& Planes,
+                                                                           const AActor* const Actor,
+                                                                           const bool bIncludeFromNonColliding,
+                                                                           const bool bIncludeChildActors) {
+  SCOPE_CYCLE_COUNTER(STAT_SelectionBox_OverlapsActorComponents);
+  TRACE_CPUPROFILER_EVENT_SCOPE(SelectionRegionOverlapsActorComponents);
+  if (!IsValid(Actor)) {
+    return false;
+  }
+  const FSelectionBoxBoundsCache::FBounds Bounds =
+      FSelectionBoxBoundsCache::Get().GetActorBounds(*Actor, bIncludeFromNonColliding, bIncludeChildActors);
+  const FBox& Box = Bounds.LocalBox;
+  const FTransform& ActorTransform = Actor->GetActorTransform();
+
+  // If the actor sphere is inside, so are all of the components, and none of them need testing.
+  const FVector SphereOrigin = ActorTransform.TransformPosition(Box.GetCenter());
+  const double SphereRadius = Bounds.SphereRadius * ActorTransform.GetMaximumAxisScale();
+  const SelectionBox::EOverlap SphereOverlap = SelectionBox::ClassifySphere(Planes, SphereOrigin, SphereRadius);
+  if (SphereOverlap == SelectionBox::EOverlap::Outside) {
+    INC_DWORD_STAT(STAT_SelectionBox_SphereRejected);
+    return false;
+  }
+  if (SphereOverlap == SelectionBox::EOverlap::Inside) {
+    INC_DWORD_STAT(STAT_SelectionBox_SphereAccepted);
+    return true;
+  }
+
+  // Classify the actor box as a whole. Most actors are entirely on one side of the region boundary.
+  FVector WorldPts[8];
+  SelectionBox::ComputeCorners(ActorTransform, Box.GetCenter(), Box.GetExtent(), WorldPts);
+  const SelectionBox::FCornerOutcodes Outcodes =
+      SelectionBox::ClassifyCorners(SelectionBox::FPackedRegionPlanes{Planes}, WorldPts);
+  if (Outcodes.AllOutside) {
+    INC_DWORD_STAT(STAT_SelectionBox_OutcodeRejected);
+    return false;
+  }
+  const SelectionBox::FClipOutcodes ClipOutcodes = SelectionBox::ClassifyClipCorners(Planes, WorldPts);
+  if (ClipOutcodes.AllOutside) {
+    INC_DWORD_STAT(STAT_SelectionBox_ClipRejected);
+    return false;
+  }
+  if (Outcodes.AllInside && ClipOutcodes.AllInside) {
+    INC_DWORD_STAT(STAT_SelectionBox_CornerInside);
+    return true;
+  }
+
+  // The actor box straddles the region, so it comes down to the individual components:
+  INC_DWORD_STAT(STAT_SelectionBox_ActorsRefined);
+  bool bOverlaps = false;
+  Actor->ForEachComponent<UPrimitiveComponent>(bIncludeChildActors, [&](const UPrimitiveComponent* Component) {
+    // Same filter as AActor::CalculateComponentsBoundingBoxInLocalSpace.
+    if (!bOverlaps && Component->IsRegistered() && (bIncludeFromNonColliding || Component->IsCollisionEnabled())) {
+      bOverlaps = SelectionRegionOverlapsComponent2(Region, Planes, Component);
+    }
+  });
+  return bOverlaps;
+}
+
+void USelectionBoxFunctionLibrary::InvalidateCachedActorBounds(const AActor* const Actor) {
+  FSelectionBoxBoundsCache::Get().Invalidate(Actor);
+}
+
+void USelectionBoxFunctionLibrary::ClearCachedActorBounds() {
+  FSelectionBoxBoundsCache::Get().Reset();
+}
@@ -0,0 +1,403 @@
+// Copyright 2021 Gareth Cross.
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SelectionBoxCore.h"
+#include "SelectionBoxFunctionLibrary.h"
+
+/**
+ * Engine-specific building blocks shared by the box tests: conversions to the types in SelectionBoxCore.h, and
+ * vectorized versions of its classification. World-space points are classified in double precision registers.
+ * Single precision is only used once a point has been made relative to the camera (see FCameraRelativeRegion).
+ */
+namespace SelectionBox {
+
+FORCEINLINE TPlane<FVector> ToCore(const FPlane& Plane) { return TPlane<FVector>{FVector{Plane}, Plane.W}; }
+
+FORCEINLINE FPlane FromCore(const TPlane<FVector>& Plane) { return FPlane{Plane.Normal, Plane.W}; }
+
+FORCEINLINE TRegionPlanes<FVector> ToCore(const FRegionPlanes& Planes) {
+  return TRegionPlanes<FVector>{ToCore(Planes.LeftPlane), ToCore(Planes.RightPlane), ToCore(Planes.TopPlane),
+                                ToCore(Planes.BottomPlane)};
+}
+
+FORCEINLINE FRegionPlanes FromCore(const TRegionPlanes<FVector>& Planes) {
+  FRegionPlanes Result;
+  Result.LeftPlane = FromCore(Planes.Left);
+  Result.RightPlane = FromCore(Planes.Right);
+  Result.TopPlane = FromCore(Planes.Top);
+  Result.BottomPlane = FromCore(Planes.Bottom);
+  return Result;
+}
+
+FORCEINLINE TRegion<FVector> ToCore(const FSelectionRegion& Region) {
+  return TRegion<FVector>{Region.CameraOrigin, Region.TopLeftRay, Region.TopRightRay, Region.BottomRightRay,
+                          Region.BottomLeftRay};
+}
+
+// Only meaningful if `Region.bOrthographic` is set.
+FORCEINLINE TOrthoRegion<FVector> ToCoreOrtho(const FSelectionRegion& Region) {
+  double HalfWidth;
+  double HalfHeight;
+  FVector Right;
+  FVector Up;
+  Region.OrthoRightExtent.ToDirectionAndLength(Right, HalfWidth);
+  Region.OrthoUpExtent.ToDirectionAndLength(Up, HalfHeight);
+  return TOrthoRegion<FVector>{Region.CameraOrigin, Right, Up, HalfWidth, HalfHeight};
+}
+
+FORCEINLINE ETransformedBoxTestResult FromCore(const EBoxTestResult Result) {
+  return static_cast<ETransformedBoxTestResult>(Result);
+}
+
+// Compute the world-space corners of a box from its center and its three axes scaled by the extent.
+FORCEINLINE void ComputeCorners(const FVector& Center, const FVector& AxisX, const FVector& AxisY,
+                                const FVector& AxisZ, FVector (&PtsOut)[8]) {
+  for (int i = 0; i < 8; ++i) {
+    PtsOut[i] = Center + AxisX * PointMultipliers[i][0] + AxisY * PointMultipliers[i][1] +
+                AxisZ * PointMultipliers[i][2];
+  }
+}
+
+// Compute the world-space corners of the box `Origin +/- Extent`, expressed in the frame of `BoxTransform`.
+FORCEINLINE void ComputeCorners(const FTransform& BoxTransform, const FVector& Origin, const FVector& Extent,
+                                FVector (&PtsOut)[8]) {
+  for (int i = 0; i < 8; ++i) {
+    const FVector Multiplier{PointMultipliers[i][0], PointMultipliers[i][1], PointMultipliers[i][2]};
+    PtsOut[i] = BoxTransform.TransformPosition(Extent * Multiplier + Origin);
+  }
+}
+
+/**
+ * FRegionPlanes transposed into structure-of-arrays form, so that one multiply-add per axis evaluates a point
+ * against all four planes at once. Lane `i` holds the plane whose EOutcodeBits value is `1 << i`.
+ *
+ * The lanes are double precision. In a large world the plane offsets and the corner coordinates are both far from
+ * the origin, and rounding them to float first would move the planes by centimetres. The products are summed in the
+ * same order as FPlane::PlaneDot (and not fused), so the outcodes agree with the scalar double precision tests, such
+ * as the edge checks, even for corners that touch a plane. For a single precision kernel, see FPackedOriginPlanes.
+ */
+struct FPackedRegionPlanes {
+  VectorRegister4Double NormalX;
+  VectorRegister4Double NormalY;
+  VectorRegister4Double NormalZ;
+  VectorRegister4Double W;
+
+  explicit FPackedRegionPlanes(const FRegionPlanes& Planes) {
+    const FPlane& T = Planes.TopPlane;
+    const FPlane& B = Planes.BottomPlane;
+    const FPlane& R = Planes.RightPlane;
+    const FPlane& L = Planes.LeftPlane;
+    NormalX = MakeVectorRegisterDouble(T.X, B.X, R.X, L.X);
+    NormalY = MakeVectorRegisterDouble(T.Y, B.Y, R.Y, L.Y);
+    NormalZ = MakeVectorRegisterDouble(T.Z, B.Z, R.Z, L.Z);
+    W = MakeVectorRegisterDouble(T.W, B.W, R.W, L.W);
+  }
+
+  // Returns a 4-bit mask with bit `i` set if the point is strictly outside plane `i` (PlaneDot > 0).
+  FORCEINLINE uint32 OutsideMask(const FVector& Pt) const {
+    VectorRegister4Double Dot = VectorMultiply(NormalX, Splat(Pt.X));
+    Dot = VectorAdd(Dot, VectorMultiply(NormalY, Splat(Pt.Y)));
+    Dot = VectorAdd(Dot, VectorMultiply(NormalZ, Splat(Pt.Z)));
+    Dot = VectorSubtract(Dot, W);
+    return static_cast<uint32>(VectorMaskBits(VectorCompareGT(Dot, VectorZeroDouble())));
+  }
+
+  // True if the axis-aligned box is entirely outside at least one of the planes.
+  FORCEINLINE bool IsBoxOutside(const FVector& Center, const FVector& Extent) const {
+    // Distance from the center to each plane, minus the projection of the extent onto the plane normal.
+    VectorRegister4Double Dot = VectorMultiply(NormalX, Splat(Center.X));
+    Dot = VectorAdd(Dot, VectorMultiply(NormalY, Splat(Center.Y)));
+    Dot = VectorAdd(Dot, VectorMultiply(NormalZ, Splat(Center.Z)));
+    Dot = VectorSubtract(Dot, W);
+    VectorRegister4Double Radius = VectorMultiply(VectorAbs(NormalX), Splat(Extent.X));
+    Radius = VectorAdd(Radius, VectorMultiply(VectorAbs(NormalY), Splat(Extent.Y)));
+    Radius = VectorAdd(Radius, VectorMultiply(VectorAbs(NormalZ), Splat(Extent.Z)));
+    return VectorMaskBits(VectorCompareGT(Dot, Radius)) != 0;
+  }
+
+private:
+  static FORCEINLINE VectorRegister4Double Splat(const double Value) {
+    return MakeVectorRegisterDouble(Value, Value, Value, Value);
+  }
+};
+
+/**
+ * Version of FPackedRegionPlanes for planes through the origin, as in camera-relative queries where the points are
+ * given relative to the camera. Evaluating a point then takes three multiply-adds and no offset.
+ */
+struct FPackedOriginPlanes {
+  VectorRegister4Float NormalX;
+  VectorRegister4Float NormalY;
+  VectorRegister4Float NormalZ;
+
+  explicit FPackedOriginPlanes(const TRegionPlanes<FVector3f>& Planes) {
+    const FVector3f& T = Planes.Top.Normal;
+    const FVector3f& B = Planes.Bottom.Normal;
+    const FVector3f& R = Planes.Right.Normal;
+    const FVector3f& L = Planes.Left.Normal;
+    NormalX = MakeVectorRegisterFloat(T.X, B.X, R.X, L.X);
+    NormalY = MakeVectorRegisterFloat(T.Y, B.Y, R.Y, L.Y);
+    NormalZ = MakeVectorRegisterFloat(T.Z, B.Z, R.Z, L.Z);
+  }
+
+  // Returns a 4-bit mask with bit `i` set if the point is strictly outside plane `i`.
+  FORCEINLINE uint32 OutsideMask(const FVector3f& Pt) const {
+    VectorRegister4Float Dot = VectorMultiply(NormalX, VectorSetFloat1(Pt.X));
+    Dot = VectorMultiplyAdd(NormalY, VectorSetFloat1(Pt.Y), Dot);
+    Dot = VectorMultiplyAdd(NormalZ, VectorSetFloat1(Pt.Z), Dot);
+    return static_cast<uint32>(VectorMaskBits(VectorCompareGT(Dot, VectorZeroFloat())));
+  }
+};
+
+/**
+ * Vectorized version of ClassifyCorners in SelectionBoxCore.h, which produces the same codes. Each corner is
+ * tested against all four planes at once, and the masks are combined without branches.
+ */
+template <typename PackedPlanesType, typename PointType>
+FORCEINLINE FCornerOutcodes ClassifyPackedCorners(const PackedPlanesType& Planes, const PointType (&Pts)[8]) {
+  FCornerOutcodes Result;
+  uint32 AllOutside = 0xF;
+  uint32 AnyInside = 0;
+  uint32 AnyOutside = 0;
+  for (int i = 0; i < 8; ++i) {
+    const uint32 Mask = Planes.OutsideMask(Pts[i]);
+    AllOutside &= Mask;
+    AnyOutside |= Mask;
+    AnyInside |= static_cast<uint32>(Mask == 0);
+    Result.Codes[i] = static_cast<uint8>(OutcodeFromMask(Mask));
+  }
+  Result.AllOutside = static_cast<uint8>(AllOutside);
+  Result.AnyInside = static_cast<uint8>(AnyInside);
+  Result.AllInside = static_cast<uint8>(AnyOutside == 0);
+  return Result;
+}
+
+FORCEINLINE FCornerOutcodes ClassifyCorners(const FPackedRegionPlanes& Planes, const FVector (&Pts)[8]) {
+  return ClassifyPackedCorners(Planes, Pts);
+}
+
+FORCEINLINE FCornerOutcodes ClassifyCorners(const FPackedOriginPlanes& Planes, const FVector3f (&Pts)[8]) {
+  return ClassifyPackedCorners(Planes, Pts);
+}
+
+/**
+ * A selection region rebased onto its camera origin, for testing boxes in single precision. Positions are made
+ * relative to the camera in double precision, once per box, after which the magnitudes only depend on the distance
+ * to the camera, not on the distance to the world origin. The side planes all pass through the camera, so relative
+ * to it their offsets are exactly zero.
+ */
+struct FCameraRelativeRegion {
+  // The camera origin, in world space.
+  FVector Origin;
+  TRegionPlanes<FVector3f> Planes;
+  FPackedOriginPlanes PackedPlanes;
+  // Corner rays, ordered as in TestBoxCorners.
+  FVector3f Rays[4];
+  int32 NumClipPlanes;
+  TPlane<FVector3f> ClipPlanes[FRegionPlanes::MaxClipPlanes];
+
+  FCameraRelativeRegion(const FSelectionRegion& Region, const FRegionPlanes& WorldPlanes)
+      : Origin(Region.CameraOrigin),
+        Planes{SidePlane(WorldPlanes.LeftPlane), SidePlane(WorldPlanes.RightPlane), SidePlane(WorldPlanes.TopPlane),
+               SidePlane(WorldPlanes.BottomPlane)},
+        PackedPlanes(Planes),
+        Rays{FVector3f{Region.TopLeftRay}, FVector3f{Region.TopRightRay}, FVector3f{Region.BottomLeftRay},
+             FVector3f{Region.BottomRightRay}},
+        NumClipPlanes(WorldPlanes.NumClipPlanes) {
+    for (int32 p = 0; p < NumClipPlanes; ++p) {
+      const FPlane& Plane = WorldPlanes.ClipPlanes[p];
+      // N.(Origin + X) - W = N.X - (W - N.Origin), so the offset of the rebased plane is -PlaneDot(Origin).
+      ClipPlanes[p] = TPlane<FVector3f>{FVector3f{FVector{Plane}}, static_cast<float>(-Plane.PlaneDot(Origin))};
+    }
+  }
+
+  // Classify a sphere (relative to the camera) against the side and clip planes, as in SelectionBox::ClassifySphere.
+  FORCEINLINE EOverlap ClassifySphere(const FVector3f& Center, const float Radius) const {
+    EOverlap Result = SelectionBox::ClassifySphere(Planes, Center, Radius);
+    for (int32 p = 0; p < NumClipPlanes && Result != EOverlap::Outside; ++p) {
+      Result = FMath::Min(Result, ClassifyDistance(ClipPlanes[p].PlaneDot(Center), Radius));
+    }
+    return Result;
+  }
+
+  // True if every corner is outside the same clip plane.
+  FORCEINLINE bool IsOutsideClipPlanes(const FVector3f (&Pts)[8]) const {
+    for (int32 p = 0; p < NumClipPlanes; ++p) {
+      uint32 NumOutside = 0;
+      for (const FVector3f& Pt : Pts) {
+        NumOutside += static_cast<uint32>(ClipPlanes[p].PlaneDot(Pt) > 0);
+      }
+      if (NumOutside == 8) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  static TPlane<FVector3f> SidePlane(const FPlane& Plane) { return TPlane<FVector3f>{FVector3f{FVector{Plane}}, 0}; }
+};
+
+// Classification of the box corners against the optional clip planes of FRegionPlanes.
+struct FClipOutcodes {
+  // Clip planes (bit `i` for ClipPlanes[i]) that every corner lies outside of. If non-zero, the box is outside.
+  uint32 AllOutside;
+  // True if every corner is inside every clip plane.
+  bool AllInside;
+};
+
+FORCEINLINE FClipOutcodes ClassifyClipCorners(const FRegionPlanes& Planes, const FVector (&Pts)[8]) {
+  uint32 AllOutside = (1u << Planes.NumClipPlanes) - 1;
+  uint32 AnyOutside = 0;
+  for (int32 p = 0; p < Planes.NumClipPlanes; ++p) {
+    uint32 NumOutside = 0;
+    for (const FVector& Pt : Pts) {
+      NumOutside += static_cast<uint32>(Planes.ClipPlanes[p].PlaneDot(Pt) > 0);
+    }
+    if (NumOutside < 8) {
+      AllOutside &= ~(1u << p);
+    }
+    AnyOutside |= NumOutside;
+  }
+  return FClipOutcodes{AllOutside, AnyOutside == 0};
+}
+
+// True if the axis-aligned box is entirely outside at least one of the clip planes.
+FORCEINLINE bool IsBoxOutsideClipPlanes(const FRegionPlanes& Planes, const FVector& Center, const FVector& Extent) {
+  for (int32 p = 0; p < Planes.NumClipPlanes; ++p) {
+    const FPlane& Plane = Planes.ClipPlanes[p];
+    if (Plane.PlaneDot(Center) > FVector::DotProduct(Plane.GetAbs(), Extent)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Classify a sphere against the side and clip planes of the region, as in SelectionBox::ClassifySphere.
+FORCEINLINE EOverlap ClassifySphere(const FRegionPlanes& Planes, const FVector& Center, const double Radius) {
+  EOverlap Result = ClassifySphere(ToCore(Planes), Center, Radius);
+  for (int32 p = 0; p < Planes.NumClipPlanes && Result != EOverlap::Outside; ++p) {
+    Result = FMath::Min(Result, ClassifyDistance(Planes.ClipPlanes[p].PlaneDot(Center), Radius));
+  }
+  return Result;
+}
+
+// Classify a world-aligned box against the side and clip planes of the region, as in
+// SelectionBox::ClassifyAlignedBox.
+FORCEINLINE EOverlap ClassifyAlignedBox(const FRegionPlanes& Planes, const FVector& Center, const FVector& Extent) {
+  EOverlap Result = ClassifyAlignedBox(ToCore(Planes), Center, Extent);
+  for (int32 p = 0; p < Planes.NumClipPlanes && Result != EOverlap::Outside; ++p) {
+    const FPlane& Plane = Planes.ClipPlanes[p];
+    Result = FMath::Min(Result, ClassifyDistance(Plane.PlaneDot(Center), ProjectedRadius(FVector{Plane}, Extent)));
+  }
+  return Result;
+}
+
+// Classify an oriented box against the side and clip planes of the region, as in SelectionBox::ClassifyOrientedBox.
+FORCEINLINE EOverlap ClassifyOrientedBox(const FRegionPlanes& Planes, const TOrientedBox<FVector>& Box) {
+  EOverlap Result = ClassifyOrientedBox(ToCore(Planes), Box);
+  for (int32 p = 0; p < Planes.NumClipPlanes && Result != EOverlap::Outside; ++p) {
+    const FPlane& Plane = Planes.ClipPlanes[p];
+    Result =
+        FMath::Min(Result, ClassifyDistance(Plane.PlaneDot(Box.Center), ProjectedRadius(FVector{Plane}, Box.Axes)));
+  }
+  return Result;
+}
+
+// Classify an oriented box against an orthographic region and its clip planes. See SelectionBox::ClassifyOrthoBox.
+FORCEINLINE EOverlap ClassifyOrthoBox(const TOrthoRegion<FVector>& Region, const FRegionPlanes& Planes,
+                                      const TOrientedBox<FVector>& Box) {
+  EOverlap Result = EOverlap::Inside;
+  // Each clip plane is exact on its own, so test them first: they are cheaper than the prism.
+  for (int32 p = 0; p < Planes.NumClipPlanes; ++p) {
+    const FPlane& Plane = Planes.ClipPlanes[p];
+    Result =
+        FMath::Min(Result, ClassifyDistance(Plane.PlaneDot(Box.Center), ProjectedRadius(FVector{Plane}, Box.Axes)));
+    if (Result == EOverlap::Outside) {
+      return Result;
+    }
+  }
+  return FMath::Min(Result, ClassifyOrthoBox(Region, Box));
+}
+
+// False if no point of the sphere is on the ray `RayOrigin + t * Direction` for 0 <= t < MaxDistance, so that the
+// ray cannot hit anything inside the sphere nearer than MaxDistance. `Direction` must be normalized.
+FORCEINLINE bool RayMayHitSphere(const FVector& RayOrigin, const FVector& Direction, const FVector& Center,
+                                 const double Radius, const double MaxDistance) {
+  const FVector ToCenter = Center - RayOrigin;
+  const double Along = FVector::DotProduct(ToCenter, Direction);
+  if (Along + Radius < 0 || Along - Radius >= MaxDistance) {
+    return false;
+  }
+  return ToCenter.SizeSquared() - Along * Along <= Radius * Radius;
+}
+
+// Version of RayMayHitSphere that also gives the distance along the ray at which it enters the sphere (zero if
+// RayOrigin is inside it). Nothing inside the sphere can be hit nearer than that.
+FORCEINLINE bool RayEntersSphere(const FVector& RayOrigin, const FVector& Direction, const FVector& Center,
+                                 const double Radius, const double MaxDistance, double& EntryOut) {
+  const FVector ToCenter = Center - RayOrigin;
+  const double Along = FVector::DotProduct(ToCenter, Direction);
+  if (Along + Radius < 0 || Along - Radius >= MaxDistance) {
+    return false;
+  }
+  const double SquaredHalfChord = Radius * Radius - (ToCenter.SizeSquared() - Along * Along);
+  if (SquaredHalfChord < 0) {
+    return false;
+  }
+  EntryOut = FMath::Max(Along - FMath::Sqrt(SquaredHalfChord), 0.0);
+  return EntryOut < MaxDistance;
+}
+
+/**
+ * Slab test of four rays sharing one origin against the axis-aligned box [BoxMin, BoxMax], one ray per SIMD lane.
+ * Everything must be in the frame of the box. Returns true if any of the rays hits the box (for t >= 0).
+ *
+ * This is the last stage of the frustum test, which mostly runs for boxes that end up rejected, so the four
+ * corner rays of the region are tested together rather than one at a time.
+ */
+FORCEINLINE bool AnyRayIntersectsLocalBox(const FVector& RayOrigin, const FVector (&RayDirections)[4],
+                                          const FVector& BoxMin, const FVector& BoxMax) {
+  // Directions closer to zero than this are nudged away from it, so the reciprocal stays finite. The resulting
+  // slab is then either (effectively) infinite or empty, as it should be.
+  const VectorRegister4Float Epsilon = VectorSetFloat1(1.0e-20f);
+  const VectorRegister4Float Zero = VectorZeroFloat();
+
+  VectorRegister4Float TMin = Zero;
+  VectorRegister4Float TMax = VectorSetFloat1(TNumericLimits<float>::Max());
+  for (int Axis = 0; Axis < 3; ++Axis) {
+    VectorRegister4Float Direction =
+        MakeVectorRegisterFloat(static_cast<float>(RayDirections[0][Axis]), static_cast<float>(RayDirections[1][Axis]),
+                                static_cast<float>(RayDirections[2][Axis]), static_cast<float>(RayDirections[3][Axis]));
+    const VectorRegister4Float SignedEpsilon =
+        VectorSelect(VectorCompareGE(Direction, Zero), Epsilon, VectorNegate(Epsilon));
+    Direction = VectorSelect(VectorCompareGE(VectorAbs(Direction), Epsilon), Direction, SignedEpsilon);
+    const VectorRegister4Float InvDirection = VectorDivide(VectorOneFloat(), Direction);
+
+    const VectorRegister4Float Origin = VectorSetFloat1(static_cast<float>(RayOrigin[Axis]));
+    const VectorRegister4Float T0 =
+        VectorMultiply(VectorSubtract(VectorSetFloat1(static_cast<float>(BoxMin[Axis])), Origin), InvDirection);
+    const VectorRegister4Float T1 =
+        VectorMultiply(VectorSubtract(VectorSetFloat1(static_cast<float>(BoxMax[Axis])), Origin), InvDirection);
+    TMin = VectorMax(TMin, VectorMin(T0, T1));
+    TMax = VectorMin(TMax, VectorMax(T0, T1));
+  }
+  return VectorMaskBits(VectorCompareLE(TMin, TMax)) != 0;
+}
+
+/**
+ * Screen-space version of the box test (see SelectionRegionOverlapsTransformedBoxScreenSpace), given the world
+ * coordinates of the box corners. The region must have a view-projection matrix.
+ */
+ETransformedBoxTestResult TestBoxCornersScreenSpace(const FSelectionRegion& Region, const FVector (&WorldPts)[8]);
+
+/**
+ * Separating axis version of the box test (see SelectionRegionOverlapsTransformedBoxSeparatingAxis). `Axes` are
+ * the three box axes in world space, each scaled by the matching half-extent, and `WorldPts` the box corners.
+ */
+ETransformedBoxTestResult TestBoxSeparatingAxis(const FSelectionRegion& Region, const FPackedRegionPlanes& PackedPlanes,
+                                                const FVector& Center, const FVector (&Axes)[3],
+                                                const FVector (&WorldPts)[8]);
+
+}  // namespace SelectionBox
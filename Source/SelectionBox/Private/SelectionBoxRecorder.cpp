@@ -0,0 +1,309 @@
+// Copyright 2021 Gareth Cross.
+#include "SelectionBoxRecorder.h"
+
+#include "Containers/Queue.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/Compression.h"
+#include "Misc/DateTime.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeRWLock.h"
+#include "SelectionBoxStats.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogSelectionBoxRecorder, Log, All);
+
+static TAutoConsoleVariable<int32> CVarRecordMaxPendingMB(
+    TEXT("SelectionBox.RecordMaxPendingMB"), 256,
+    TEXT("How far (in MB) the selection query recorder may fall behind the disk. Queries made while it is further "
+         "behind are not recorded."));
+
+// Start of every recording. Bump the version whenever the layout of a record changes.
+static constexpr uint32 RecordFileMagic = 0x43524253;  // "SBRC"
+static constexpr uint32 RecordFileVersion = 1;
+
+// The region, planes and options of a record. Only reads the arguments when saving.
+static void SerializeQuery(FArchive& Ar, FSelectionRegion& Region, FRegionPlanes& Planes,
+                           FSelectionQueryOptions& Options) {
+  Ar << Region.CameraOrigin << Region.TopLeftRay << Region.TopRightRay << Region.BottomLeftRay
+     << Region.BottomRightRay;
+  Ar << Region.bOrthographic << Region.OrthoRightExtent << Region.OrthoUpExtent;
+  Ar << Region.bHasViewProjection << Region.ViewProjectionMatrix << Region.ScreenMin << Region.ScreenMax;
+  Ar << Region.NearDistance << Region.FarDistance << Region.ViewDirection << Region.ExtraPlanes;
+
+  Ar << Planes.LeftPlane << Planes.RightPlane << Planes.TopPlane << Planes.BottomPlane << Planes.NumClipPlanes;
+  if (Planes.NumClipPlanes < 0 || Planes.NumClipPlanes > FRegionPlanes::MaxClipPlanes) {
+    Ar.SetError();
+    Planes.NumClipPlanes = 0;
+  }
+  for (int32 p = 0; p < Planes.NumClipPlanes; ++p) {
+    Ar << Planes.ClipPlanes[p];
+  }
+
+  uint8 Mode = static_cast<uint8>(Options.Mode);
+  Ar << Mode;
+  Options.Mode = static_cast<ESelectionQueryMode>(Mode);
+  Ar << Options.MinParallelBatchSize << Options.bRefineComponents << Options.bCameraRelative;
+}
+
+// Arrays are stored as a count followed by the raw elements.
+template <typename T>
+static void WriteArray(FArchive& Ar, const TArrayView<const T> View) {
+  int32 Num = View.Num();
+  Ar << Num;
+  Ar.Serialize(const_cast<T*>(View.GetData()), static_cast<int64>(Num) * sizeof(T));
+}
+
+template <typename T>
+static void ReadArray(FArchive& Ar, TArray<T>& Array) {
+  int32 Num = 0;
+  Ar << Num;
+  if (Num < 0 || static_cast<int64>(Num) * sizeof(T) > Ar.TotalSize() - Ar.Tell()) {
+    Ar.SetError();
+    return;
+  }
+  Array.SetNumUninitialized(Num);
+  Ar.Serialize(Array.GetData(), static_cast<int64>(Num) * sizeof(T));
+}
+
+/**
+ * Compresses the queued records and appends them to the file, on its own thread. Each record is written as its
+ * uncompressed size, its compressed size, and then the compressed bytes.
+ */
+class FSelectionBoxRecorder::FWriter final : public FRunnable {
+public:
+  FWriter(FArchive* const InFile, const FString& InFilename) : File(InFile), Filename(InFilename) {
+    WorkEvent = FPlatformProcess::GetSynchEventFromPool(false);
+    Thread = FRunnableThread::Create(this, TEXT("SelectionBoxRecorder"), 0, TPri_BelowNormal);
+  }
+
+  virtual ~FWriter() override {
+    if (Thread) {
+      bStopping = true;
+      WorkEvent->Trigger();
+      Thread->WaitForCompletion();
+      delete Thread;
+    }
+    FPlatformProcess::ReturnSynchEventToPool(WorkEvent);
+    File->Close();
+    const bool bError = File->IsError();
+    delete File;
+
+    UE_LOG(LogSelectionBoxRecorder, Display, TEXT("Recorded %d selection queries to %s."), NumWritten, *Filename);
+    if (bError) {
+      UE_LOG(LogSelectionBoxRecorder, Error, TEXT("Failed to write %s. The recording is incomplete."), *Filename);
+    }
+    if (NumDropped > 0) {
+      UE_LOG(LogSelectionBoxRecorder, Warning,
+             TEXT("Dropped %d selection queries because the disk could not keep up (see "
+                  "SelectionBox.RecordMaxPendingMB)."),
+             NumDropped.load());
+    }
+  }
+
+  bool HasThread() const { return Thread != nullptr; }
+
+  // Called from any thread.
+  void Enqueue(TArray<uint8>&& Payload) {
+    const int64 MaxPendingBytes = static_cast<int64>(CVarRecordMaxPendingMB.GetValueOnAnyThread()) * 1024 * 1024;
+    if (PendingBytes.load(std::memory_order_relaxed) + Payload.Num() > MaxPendingBytes) {
+      ++NumDropped;
+      return;
+    }
+    PendingBytes += Payload.Num();
+    Queue.Enqueue(MoveTemp(Payload));
+    WorkEvent->Trigger();
+  }
+
+  // FRunnable implementation
+  virtual uint32 Run() override {
+    while (!bStopping) {
+      WorkEvent->Wait();
+      WritePending();
+    }
+    // Whatever was queued before the recording was stopped.
+    WritePending();
+    return 0;
+  }
+
+private:
+  void WritePending() {
+    TArray<uint8> Payload;
+    while (Queue.Dequeue(Payload)) {
+      PendingBytes -= Payload.Num();
+      int32 UncompressedSize = Payload.Num();
+      int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Zlib, UncompressedSize);
+      Compressed.SetNumUninitialized(CompressedSize);
+      if (!FCompression::CompressMemory(NAME_Zlib, Compressed.GetData(), CompressedSize, Payload.GetData(),
+                                        UncompressedSize)) {
+        ++NumDropped;
+        continue;
+      }
+      *File << UncompressedSize << CompressedSize;
+      File->Serialize(Compressed.GetData(), CompressedSize);
+      ++NumWritten;
+    }
+    // So that a crash loses as little as possible.
+    File->Flush();
+  }
+
+  FArchive* const File;
+  const FString Filename;
+  FEvent* WorkEvent{nullptr};
+  FRunnableThread* Thread{nullptr};
+
+  TQueue<TArray<uint8>, EQueueMode::Mpsc> Queue;
+  std::atomic<int64> PendingBytes{0};
+  std::atomic<bool> bStopping{false};
+  std::atomic<int32> NumDropped{0};
+
+  // Only used by the writer thread.
+  TArray<uint8> Compressed;
+  int32 NumWritten{0};
+};
+
+FSelectionBoxRecorder::FSelectionBoxRecorder() = default;
+
+FSelectionBoxRecorder::~FSelectionBoxRecorder() = default;
+
+FSelectionBoxRecorder& FSelectionBoxRecorder::Get() {
+  static FSelectionBoxRecorder Instance;
+  return Instance;
+}
+
+bool FSelectionBoxRecorder::Start(const FString& Filename) {
+  Stop();
+
+  const FString Path = FPaths::IsRelative(Filename) ? FPaths::Combine(FPaths::ProfilingDir(), Filename) : Filename;
+  FArchive* const File = IFileManager::Get().CreateFileWriter(*Path);
+  if (!File) {
+    UE_LOG(LogSelectionBoxRecorder, Error, TEXT("Failed to create %s."), *Path);
+    return false;
+  }
+  uint32 Magic = RecordFileMagic;
+  uint32 Version = RecordFileVersion;
+  *File << Magic << Version;
+
+  TUniquePtr<FWriter> NewWriter = MakeUnique<FWriter>(File, Path);
+  if (!NewWriter->HasThread()) {
+    UE_LOG(LogSelectionBoxRecorder, Error, TEXT("Recording selection queries needs a thread for the writer."));
+    return false;
+  }
+  UE_LOG(LogSelectionBoxRecorder, Display, TEXT("Recording selection queries to %s."), *Path);
+  FRWScopeLock Lock{WriterLock, SLT_Write};
+  Writer = MoveTemp(NewWriter);
+  bRecording = true;
+  return true;
+}
+
+void FSelectionBoxRecorder::Stop() {
+  TUniquePtr<FWriter> OldWriter;
+  {
+    FRWScopeLock Lock{WriterLock, SLT_Write};
+    bRecording = false;
+    OldWriter = MoveTemp(Writer);
+  }
+  // Outside of the lock, so that queries don't wait for the backlog to be written.
+  OldWriter.Reset();
+}
+
+void FSelectionBoxRecorder::Record(const FSelectionRegion& Region, const FRegionPlanes& Planes,
+                                   const FSelectionQueryOptions& Options, const FSelectionBoxBatch& Boxes,
+                                   const TArrayView<const int32> Indices) {
+  if (!IsRecording()) {
+    return;
+  }
+  SCOPE_CYCLE_COUNTER(STAT_SelectionBox_Record);
+  TRACE_CPUPROFILER_EVENT_SCOPE(FSelectionBoxRecorder::Record);
+
+  TArray<uint8> Payload;
+  Payload.Reserve(1024 + Boxes.Num() * (3 * sizeof(FVector) + sizeof(FQuat)) + Indices.Num() * sizeof(int32));
+  FMemoryWriter Ar{Payload};
+  SerializeQuery(Ar, const_cast<FSelectionRegion&>(Region), const_cast<FRegionPlanes&>(Planes),
+                 const_cast<FSelectionQueryOptions&>(Options));
+  WriteArray(Ar, Boxes.Positions);
+  WriteArray(Ar, Boxes.Rotations);
+  WriteArray(Ar, Boxes.Origins);
+  WriteArray(Ar, Boxes.Extents);
+  WriteArray(Ar, Indices);
+
+  FRWScopeLock Lock{WriterLock, SLT_ReadOnly};
+  if (Writer) {
+    Writer->Enqueue(MoveTemp(Payload));
+  }
+}
+
+bool FSelectionBoxRecorder::LoadFile(const FString& Filename, TArray<FSelectionBoxRecord>& RecordsOut) {
+  RecordsOut.Reset();
+  const TUniquePtr<FArchive> File{IFileManager::Get().CreateFileReader(*Filename)};
+  if (!File) {
+    UE_LOG(LogSelectionBoxRecorder, Error, TEXT("Failed to open %s."), *Filename);
+    return false;
+  }
+  uint32 Magic = 0;
+  uint32 Version = 0;
+  *File << Magic << Version;
+  if (File->IsError() || Magic != RecordFileMagic) {
+    UE_LOG(LogSelectionBoxRecorder, Error, TEXT("%s is not a recording of selection queries."), *Filename);
+    return false;
+  }
+  if (Version != RecordFileVersion) {
+    UE_LOG(LogSelectionBoxRecorder, Error, TEXT("%s has version %u, but only version %u can be read."), *Filename,
+           Version, RecordFileVersion);
+    return false;
+  }
+
+  TArray<uint8> Compressed;
+  TArray<uint8> Payload;
+  while (File->Tell() < File->TotalSize()) {
+    int32 UncompressedSize = 0;
+    int32 CompressedSize = 0;
+    *File << UncompressedSize << CompressedSize;
+    bool bValid = !File->IsError() && UncompressedSize >= 0 && CompressedSize >= 0 &&
+                  CompressedSize <= File->TotalSize() - File->Tell();
+    if (bValid) {
+      Compressed.SetNumUninitialized(CompressedSize);
+      File->Serialize(Compressed.GetData(), CompressedSize);
+      Payload.SetNumUninitialized(UncompressedSize);
+      bValid = FCompression::UncompressMemory(NAME_Zlib, Payload.GetData(), UncompressedSize, Compressed.GetData(),
+                                              CompressedSize);
+    }
+    if (bValid) {
+      FMemoryReader Ar{Payload};
+      FSelectionBoxRecord& Record = RecordsOut.AddDefaulted_GetRef();
+      SerializeQuery(Ar, Record.Region, Record.Planes, Record.Options);
+      ReadArray(Ar, Record.Boxes.Positions);
+      ReadArray(Ar, Record.Boxes.Rotations);
+      ReadArray(Ar, Record.Boxes.Origins);
+      ReadArray(Ar, Record.Boxes.Extents);
+      ReadArray(Ar, Record.Indices);
+      bValid = !Ar.IsError() && Record.Boxes.GetView().IsValid();
+      if (!bValid) {
+        RecordsOut.Pop();
+      }
+    }
+    if (!bValid) {
+      UE_LOG(LogSelectionBoxRecorder, Warning, TEXT("%s is damaged after record %d. The rest of it is ignored."),
+             *Filename, RecordsOut.Num());
+      break;
+    }
+  }
+  return true;
+}
+
+static FAutoConsoleCommand StartRecordingCommand(
+    TEXT("SelectionBox.StartRecording"),
+    TEXT("Record every batch selection query to a file, for the SelectionBoxReplay commandlet. Takes an optional "
+         "filename, relative to the profiling directory."),
+    FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args) {
+      FSelectionBoxRecorder::Get().Start(
+          Args.Num() > 0 ? Args[0]
+                         : FString::Printf(TEXT("SelectionBox/Selection-%s.sbrec"), *FDateTime::Now().ToString()));
+    }));
+
+static FAutoConsoleCommand StopRecordingCommand(
+    TEXT("SelectionBox.StopRecording"), TEXT("Finish the recording started by SelectionBox.StartRecording."),
+    FConsoleCommandDelegate::CreateLambda([] { FSelectionBoxRecorder::Get().Stop(); }));
@@ -0,0 +1,119 @@
+// Copyright 2021 Gareth Cross.
+#include "SelectionBoxKernels.h"
+
+namespace SelectionBox {
+
+// Clip-space W below which a point is considered to be behind the camera. For a perspective projection W is the
+// view-space depth, so this acts as a near plane very close to the camera.
+static constexpr double MinClipW = 1.0e-3;
+
+// Z component of the cross product (A - O) x (B - O). Positive if O -> A -> B turns counter-clockwise.
+static double Cross2D(const FVector2D& O, const FVector2D& A, const FVector2D& B) {
+  return (A.X - O.X) * (B.Y - O.Y) - (A.Y - O.Y) * (B.X - O.X);
+}
+
+ETransformedBoxTestResult TestBoxCornersScreenSpace(const FSelectionRegion& Region, const FVector (&WorldPts)[8]) {
+  const FVector2D& RectMin = Region.ScreenMin;
+  const FVector2D& RectMax = Region.ScreenMax;
+
+  FVector4 ClipPts[8];
+  for (int i = 0; i < 8; ++i) {
+    ClipPts[i] = Region.ViewProjectionMatrix.TransformFVector4(FVector4{WorldPts[i], 1});
+  }
+
+  // Project the corners that are in front of the camera:
+  TArray<FVector2D, TInlineAllocator<16>> Points;
+  for (const FVector4& Clip : ClipPts) {
+    if (Clip.W < MinClipW) {
+      continue;
+    }
+    const FVector2D Pt{Clip.X / Clip.W, Clip.Y / Clip.W};
+    if (Pt.X >= RectMin.X && Pt.Y >= RectMin.Y && Pt.X <= RectMax.X && Pt.Y <= RectMax.Y) {
+      return ETransformedBoxTestResult::BoxCornerInsideRegion;
+    }
+    Points.Add(Pt);
+  }
+
+  // Edges that pass behind the camera are cut at the near plane. Interpolating in clip space is exact, since the
+  // projection is linear until the divide by W.
+  for (const IntPair& Line : BoxEdges) {
+    const FVector4& A = ClipPts[Line.i];
+    const FVector4& B = ClipPts[Line.j];
+    if ((A.W < MinClipW) != (B.W < MinClipW)) {
+      const double T = (MinClipW - A.W) / (B.W - A.W);
+      const FVector4 Clip = A + (B - A) * T;
+      Points.Add(FVector2D{Clip.X / MinClipW, Clip.Y / MinClipW});
+    }
+  }
+  if (Points.Num() == 0) {
+    // Entirely behind the camera.
+    return ETransformedBoxTestResult::NoIntersection;
+  }
+
+  // The axes of the rectangle are the first two separating axes to try:
+  FVector2D PointsMin = Points[0];
+  FVector2D PointsMax = Points[0];
+  for (const FVector2D& Pt : Points) {
+    PointsMin = FVector2D{FMath::Min(PointsMin.X, Pt.X), FMath::Min(PointsMin.Y, Pt.Y)};
+    PointsMax = FVector2D{FMath::Max(PointsMax.X, Pt.X), FMath::Max(PointsMax.Y, Pt.Y)};
+  }
+  if (PointsMax.X < RectMin.X || PointsMax.Y < RectMin.Y || PointsMin.X > RectMax.X || PointsMin.Y > RectMax.Y) {
+    return ETransformedBoxTestResult::NoIntersection;
+  }
+
+  // Convex hull of the projected points (Andrew's monotone chain), counter-clockwise:
+  Points.Sort([](const FVector2D& A, const FVector2D& B) { return A.X < B.X || (A.X == B.X && A.Y < B.Y); });
+  TArray<FVector2D, TInlineAllocator<32>> Hull;
+  Hull.SetNumUninitialized(Points.Num() * 2);
+  int32 NumHull = 0;
+  for (int32 i = 0; i < Points.Num(); ++i) {
+    while (NumHull >= 2 && Cross2D(Hull[NumHull - 2], Hull[NumHull - 1], Points[i]) <= 0) {
+      --NumHull;
+    }
+    Hull[NumHull++] = Points[i];
+  }
+  for (int32 i = Points.Num() - 2, Lower = NumHull + 1; i >= 0; --i) {
+    while (NumHull >= Lower && Cross2D(Hull[NumHull - 2], Hull[NumHull - 1], Points[i]) <= 0) {
+      --NumHull;
+    }
+    Hull[NumHull++] = Points[i];
+  }
+  // The last point repeats the first one.
+  NumHull = FMath::Max(NumHull - 1, 1);
+
+  const FVector2D RectCorners[4] = {
+      RectMin,
+      FVector2D{RectMax.X, RectMin.Y},
+      RectMax,
+      FVector2D{RectMin.X, RectMax.Y},
+  };
+
+  // Does a corner of the selection fall inside the box?
+  if (NumHull >= 3) {
+    for (const FVector2D& Corner : RectCorners) {
+      bool bInside = true;
+      for (int32 i = 0; i < NumHull && bInside; ++i) {
+        bInside = Cross2D(Hull[i], Hull[(i + 1) % NumHull], Corner) >= 0;
+      }
+      if (bInside) {
+        return ETransformedBoxTestResult::SelectionCornerIntersectsBox;
+      }
+    }
+  }
+
+  // Otherwise the outlines must cross, unless one of the hull edges separates the two:
+  for (int32 i = 0; i < NumHull; ++i) {
+    const FVector2D& A = Hull[i];
+    const FVector2D& B = Hull[(i + 1) % NumHull];
+    bool bSeparating = true;
+    for (int32 c = 0; c < 4 && bSeparating; ++c) {
+      bSeparating = Cross2D(A, B, RectCorners[c]) < 0;
+    }
+    if (bSeparating) {
+      return ETransformedBoxTestResult::NoIntersection;
+    }
+  }
+  return ETransformedBoxTestResult::BoxIntersectsPlane;
+}
+
+}  // namespace SelectionBox
@@ -0,0 +1,60 @@
+// Copyright 2021 Gareth Cross.
+#include "SelectionBoxKernels.h"
+
+namespace SelectionBox {
+
+// Projection of the box onto `Axis`, relative to the camera origin: the box covers [Mid - Radius, Mid + Radius].
+// Then project the pyramid: it is the set of points `CameraOrigin + t * Ray` (t >= 0) for rays in the convex hull
+// of the corner rays, so it extends to infinity on whichever sides of the axis any corner ray points to.
+static bool IsSeparatingAxis(const FVector& Axis, const FVector& CenterFromCamera, const FVector (&Axes)[3],
+                             const FVector (&Rays)[4]) {
+  const double Mid = FVector::DotProduct(Axis, CenterFromCamera);
+  const double Radius = FMath::Abs(FVector::DotProduct(Axis, Axes[0])) +
+                        FMath::Abs(FVector::DotProduct(Axis, Axes[1])) +
+                        FMath::Abs(FVector::DotProduct(Axis, Axes[2]));
+  double MinRay = TNumericLimits<double>::Max();
+  double MaxRay = TNumericLimits<double>::Lowest();
+  for (const FVector& Ray : Rays) {
+    const double D = FVector::DotProduct(Axis, Ray);
+    MinRay = FMath::Min(MinRay, D);
+    MaxRay = FMath::Max(MaxRay, D);
+  }
+  // The pyramid covers [0, inf) if every ray points up the axis, (-inf, 0] if every ray points down it, and the
+  // whole line otherwise.
+  return (MinRay >= 0 && Mid + Radius < 0) || (MaxRay <= 0 && Mid - Radius > 0);
+}
+
+ETransformedBoxTestResult TestBoxSeparatingAxis(const FSelectionRegion& Region, const FPackedRegionPlanes& PackedPlanes,
+                                                const FVector& Center, const FVector (&Axes)[3],
+                                                const FVector (&WorldPts)[8]) {
+  // The corner outcodes cover the plane normals (the first 4 axes): every corner is outside a plane exactly when
+  // that plane separates the box. They also cheaply catch the common cases.
+  const FCornerOutcodes Outcodes = ClassifyCorners(PackedPlanes, WorldPts);
+  if (Outcodes.AllOutside) {
+    return ETransformedBoxTestResult::NoIntersection;
+  }
+  if (Outcodes.AnyInside) {
+    return ETransformedBoxTestResult::BoxCornerInsideRegion;
+  }
+
+  const FVector CenterFromCamera = Center - Region.CameraOrigin;
+  const FVector Rays[4] = {Region.TopLeftRay, Region.TopRightRay, Region.BottomRightRay, Region.BottomLeftRay};
+
+  // Box face normals. The axes do not need to be normalized, since we only compare signs.
+  for (const FVector& Axis : Axes) {
+    if (IsSeparatingAxis(Axis, CenterFromCamera, Axes, Rays)) {
+      return ETransformedBoxTestResult::NoIntersection;
+    }
+  }
+  // Box edges crossed with pyramid edges:
+  for (const FVector& Axis : Axes) {
+    for (const FVector& Ray : Rays) {
+      if (IsSeparatingAxis(FVector::CrossProduct(Axis, Ray), CenterFromCamera, Axes, Rays)) {
+        return ETransformedBoxTestResult::NoIntersection;
+      }
+    }
+  }
+  return ETransformedBoxTestResult::Overlaps;
+}
+
+}  // namespace SelectionBox
@@ -0,0 +1,70 @@
+// Copyright 2021 Gareth Cross.
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Stats/Stats.h"
+
+/**
+ * Stats for the selection queries, shown by `stat SelectionBox` and recorded in Unreal Insights captures (with the
+ * `stats` trace channel enabled). The counters track which stage of the frustum test decided each box, so the
+ * culling order can be tuned against real scenes. They are per-frame, and compile out when stats are disabled.
+ */
+DECLARE_STATS_GROUP(TEXT("SelectionBox"), STATGROUP_SelectionBox, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Overlaps Actor"), STAT_SelectionBox_OverlapsActor, STATGROUP_SelectionBox, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Overlaps Component"), STAT_SelectionBox_OverlapsComponent, STATGROUP_SelectionBox, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Overlaps Actor Components"), STAT_SelectionBox_OverlapsActorComponents,
+                          STATGROUP_SelectionBox, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Overlaps Instances"), STAT_SelectionBox_OverlapsInstances, STATGROUP_SelectionBox, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Overlaps Transformed Box"), STAT_SelectionBox_OverlapsTransformedBox,
+                          STATGROUP_SelectionBox, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Batch Query"), STAT_SelectionBox_Batch, STATGROUP_SelectionBox, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Parallel Batch Query"), STAT_SelectionBox_BatchParallel, STATGROUP_SelectionBox, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Subsystem Query"), STAT_SelectionBox_SubsystemQuery, STATGROUP_SelectionBox, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Drag Selection Update"), STAT_SelectionBox_DragUpdate, STATGROUP_SelectionBox, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Async Query Snapshot"), STAT_SelectionBox_AsyncSnapshot, STATGROUP_SelectionBox, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Async Query Merge"), STAT_SelectionBox_AsyncMerge, STATGROUP_SelectionBox, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Pick"), STAT_SelectionBox_Pick, STATGROUP_SelectionBox, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Top-K Query"), STAT_SelectionBox_TopK, STATGROUP_SelectionBox, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Record Query"), STAT_SelectionBox_Record, STATGROUP_SelectionBox, );
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Cells Culled"), STAT_SelectionBox_CellsCulled, STATGROUP_SelectionBox, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Blocks Culled"), STAT_SelectionBox_BlocksCulled, STATGROUP_SelectionBox, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Cells Inside"), STAT_SelectionBox_CellsInside, STATGROUP_SelectionBox, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Instance Clusters Culled"), STAT_SelectionBox_ClustersCulled,
+                                  STATGROUP_SelectionBox, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Instance Clusters Inside"), STAT_SelectionBox_ClustersInside,
+                                  STATGROUP_SelectionBox, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Rejected By Sphere"), STAT_SelectionBox_SphereRejected,
+                                  STATGROUP_SelectionBox, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Rejected By Clip Planes"), STAT_SelectionBox_ClipRejected,
+                                  STATGROUP_SelectionBox, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Rejected By Outcodes"), STAT_SelectionBox_OutcodeRejected,
+                                  STATGROUP_SelectionBox, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Accepted: Sphere Inside Region"), STAT_SelectionBox_SphereAccepted,
+                                  STATGROUP_SelectionBox, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Accepted: Box Inside Region"), STAT_SelectionBox_BoxInside,
+                                  STATGROUP_SelectionBox, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Accepted: Corner Inside Region"), STAT_SelectionBox_CornerInside,
+                                  STATGROUP_SelectionBox, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Accepted: Edge Crosses Plane"), STAT_SelectionBox_EdgeCrossesPlane,
+                                  STATGROUP_SelectionBox, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Accepted: Corner Ray Hits Box"), STAT_SelectionBox_CornerRayHitsBox,
+                                  STATGROUP_SelectionBox, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Rejected After Ray Checks"), STAT_SelectionBox_RayRejected,
+                                  STATGROUP_SelectionBox, );
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Pick: Boxes Tested"), STAT_SelectionBox_PickBoxesTested,
+                                  STATGROUP_SelectionBox, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Top-K: Candidates Skipped"), STAT_SelectionBox_TopKSkipped,
+                                  STATGROUP_SelectionBox, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Actors Refined By Component"), STAT_SelectionBox_ActorsRefined,
+                                  STATGROUP_SelectionBox, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Bounds Cache Hits"), STAT_SelectionBox_BoundsCacheHit,
+                                  STATGROUP_SelectionBox, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Bounds Cache Misses"), STAT_SelectionBox_BoundsCacheMiss,
+                                  STATGROUP_SelectionBox, );
+
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Subsystem Index Memory"), STAT_SelectionBox_SubsystemMemory,
+                           STATGROUP_SelectionBox, );
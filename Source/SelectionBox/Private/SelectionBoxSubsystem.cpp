@@ -0,0 +1,671 @@
+// Copyright 2021 Gareth Cross.
+#include "SelectionBoxSubsystem.h"
+
+#include "Async/TaskGraphInterfaces.h"
+#include "Components/SceneComponent.h"
+#include "GameFramework/Actor.h"
+#include "GameFramework/PlayerController.h"
+#include "SelectionBoxBoundsCache.h"
+#include "SelectionBoxKernels.h"
+#include "SelectionBoxStats.h"
+#include "UObject/ObjectKey.h"
+
+// Everything an async query needs on the worker thread, and the results it hands back. The callback (or promise)
+// is kept here too, so the tasks that carry the snapshot between threads hold nothing else.
+struct FSelectionBoxAsyncSnapshot {
+  FSelectionRegion Region;
+  FRegionPlanes Planes;
+  FSelectionBoxBatchData Boxes;
+  // The object each box was taken from.
+  TArray<TWeakObjectPtr<UObject>> Objects;
+  // Indices of the boxes that overlap the region, written by the worker.
+  TArray<int32> Overlapping;
+
+  // Exactly one of these is set while the snapshot is in flight.
+  TUniqueFunction<void(TArray<AActor*>&&)> OnActorsCompleted;
+  TUniqueFunction<void(TArray<USceneComponent*>&&)> OnComponentsCompleted;
+  TOptional<TPromise<TArray<AActor*>>> ActorsPromise;
+  TOptional<TPromise<TArray<USceneComponent*>>> ComponentsPromise;
+
+  // Collect the overlapping objects that still exist.
+  template <typename T>
+  TArray<T*> Resolve() const {
+    SCOPE_CYCLE_COUNTER(STAT_SelectionBox_AsyncMerge);
+    TArray<T*> Result;
+    Result.Reserve(Overlapping.Num());
+    for (const int32 Index : Overlapping) {
+      if (T* const Object = Cast<T>(Objects[Index].Get())) {
+        Result.Add(Object);
+      }
+    }
+    return Result;
+  }
+
+  // Deliver the results on the game thread. The callback and promise are moved out first, so whatever they
+  // captured is not kept alive by the pool, and a callback that starts another query can't overwrite them.
+  void Complete() {
+    check(IsInGameThread());
+    if (OnActorsCompleted) {
+      const TUniqueFunction<void(TArray<AActor*>&&)> Callback = MoveTemp(OnActorsCompleted);
+      Callback(Resolve<AActor>());
+    } else if (OnComponentsCompleted) {
+      const TUniqueFunction<void(TArray<USceneComponent*>&&)> Callback = MoveTemp(OnComponentsCompleted);
+      Callback(Resolve<USceneComponent>());
+    } else if (ActorsPromise.IsSet()) {
+      TPromise<TArray<AActor*>> Promise = MoveTemp(ActorsPromise.GetValue());
+      ActorsPromise.Reset();
+      Promise.SetValue(Resolve<AActor>());
+    } else if (ComponentsPromise.IsSet()) {
+      TPromise<TArray<USceneComponent*>> Promise = MoveTemp(ComponentsPromise.GetValue());
+      ComponentsPromise.Reset();
+      Promise.SetValue(Resolve<USceneComponent>());
+    }
+  }
+};
+
+namespace {
+
+using FSnapshotRef = TSharedRef<FSelectionBoxAsyncSnapshot, ESPMode::ThreadSafe>;
+
+// Hands a snapshot back to the game thread once the worker is done with it.
+class FAsyncCompleteTask {
+public:
+  explicit FAsyncCompleteTask(const FSnapshotRef& InSnapshot) : Snapshot(InSnapshot) {}
+
+  TStatId GetStatId() const {
+    RETURN_QUICK_DECLARE_CYCLE_STAT(FSelectionBoxAsyncCompleteTask, STATGROUP_TaskGraphTasks);
+  }
+  static ENamedThreads::Type GetDesiredThread() { return ENamedThreads::GameThread; }
+  static ESubsequentsMode::Type GetSubsequentsMode() { return ESubsequentsMode::FireAndForget; }
+
+  void DoTask(ENamedThreads::Type, const FGraphEventRef&) { Snapshot->Complete(); }
+
+private:
+  FSnapshotRef Snapshot;
+};
+
+// Tests the boxes of a snapshot on a worker thread. Unlike AsyncTask, which wraps its work in a heap-allocated
+// TUniqueFunction, these tasks only hold the snapshot, so they fit in the task graph's pooled small-task allocator.
+class FAsyncTestTask {
+public:
+  explicit FAsyncTestTask(const FSnapshotRef& InSnapshot) : Snapshot(InSnapshot) {}
+
+  TStatId GetStatId() const {
+    RETURN_QUICK_DECLARE_CYCLE_STAT(FSelectionBoxAsyncTestTask, STATGROUP_TaskGraphTasks);
+  }
+  static ENamedThreads::Type GetDesiredThread() { return ENamedThreads::AnyBackgroundThreadNormalTask; }
+  static ESubsequentsMode::Type GetSubsequentsMode() { return ESubsequentsMode::FireAndForget; }
+
+  void DoTask(ENamedThreads::Type, const FGraphEventRef&) {
+    USelectionBoxFunctionLibrary::SelectionRegionOverlapsTransformedBoxBatch(Snapshot->Region, Snapshot->Planes,
+                                                                             Snapshot->Boxes.GetView(),
+                                                                             Snapshot->Overlapping);
+    TGraphTask<FAsyncCompleteTask>::CreateTask().ConstructAndDispatchWhenReady(Snapshot);
+  }
+
+private:
+  FSnapshotRef Snapshot;
+};
+
+}  // namespace
+
+void USelectionBoxSubsystem::RegisterActor(AActor* const Actor, const bool bIncludeFromNonColliding,
+                                           const bool bIncludeChildActors) {
+  if (!IsValid(Actor) || !IsValid(Actor->GetRootComponent())) {
+    return;
+  }
+  // Registering twice just refreshes the bounds.
+  RemoveEntry(Actor);
+
+  const FBox Box =
+      FSelectionBoxBoundsCache::Get().GetActorBounds(*Actor, bIncludeFromNonColliding, bIncludeChildActors).LocalBox;
+  FEntry Entry;
+  Entry.Actor = Actor;
+  Entry.TransformSource = Actor->GetRootComponent();
+  Entry.LocalOrigin = Box.GetCenter();
+  Entry.LocalExtent = Box.GetExtent();
+  AddEntry(MoveTemp(Entry), Actor);
+
+  Actor->OnDestroyed.AddUniqueDynamic(this, &USelectionBoxSubsystem::HandleActorDestroyed);
+}
+
+void USelectionBoxSubsystem::UnregisterActor(AActor* const Actor) {
+  if (Actor) {
+    Actor->OnDestroyed.RemoveDynamic(this, &USelectionBoxSubsystem::HandleActorDestroyed);
+  }
+  RemoveEntry(Actor);
+}
+
+void USelectionBoxSubsystem::RegisterComponent(USceneComponent* const Component) {
+  if (!IsValid(Component)) {
+    return;
+  }
+  RemoveEntry(Component);
+
+  const FBoxSphereBounds LocalBounds = Component->CalcLocalBounds();
+  FEntry Entry;
+  Entry.Component = Component;
+  Entry.TransformSource = Component;
+  Entry.LocalOrigin = LocalBounds.Origin;
+  Entry.LocalExtent = LocalBounds.BoxExtent;
+  AddEntry(MoveTemp(Entry), Component);
+}
+
+void USelectionBoxSubsystem::UnregisterComponent(USceneComponent* const Component) {
+  RemoveEntry(Component);
+}
+
+void USelectionBoxSubsystem::QueryActors(const FSelectionRegion& Region, TArray<AActor*>& ActorsOut) {
+  ActorsOut.Reset();
+  ForEachOverlappingEntry(Region, [&ActorsOut](const FEntry& Entry) {
+    if (AActor* const Actor = Entry.Actor.Get()) {
+      ActorsOut.Add(Actor);
+    }
+  });
+}
+
+void USelectionBoxSubsystem::QueryComponents(const FSelectionRegion& Region, TArray<USceneComponent*>& ComponentsOut) {
+  ComponentsOut.Reset();
+  ForEachOverlappingEntry(Region, [&ComponentsOut](const FEntry& Entry) {
+    if (USceneComponent* const Component = Entry.Component.Get()) {
+      ComponentsOut.Add(Component);
+    }
+  });
+}
+
+bool USelectionBoxSubsystem::Pick(const FVector& RayOrigin, const FVector& RayDirection,
+                                  const UObject* const LastHit, FSelectionBoxPickResult& ResultOut) {
+  SCOPE_CYCLE_COUNTER(STAT_SelectionBox_Pick);
+  TRACE_CPUPROFILER_EVENT_SCOPE(USelectionBoxSubsystem::Pick);
+  ResultOut = FSelectionBoxPickResult{};
+  const FVector Direction = RayDirection.GetSafeNormal();
+  if (Direction.IsZero()) {
+    return false;
+  }
+  double BestDistance = TNumericLimits<double>::Max();
+  int32 BestEntry = INDEX_NONE;
+  const int32* const LastEntry = LastHit ? EntryLookup.Find(FObjectKey(LastHit)) : nullptr;
+  if (LastEntry) {
+    PickEntry(*LastEntry, RayOrigin, Direction, BestDistance, BestEntry);
+  }
+
+  // Visit the blocks and cells that the ray enters, nearest first, opening blocks as they come up.
+  PickQueue.Reset();
+  const auto PushNode = [&](const int32 Level, const FIntPoint& Key) {
+    const FBox& Bounds = GetNodeBounds(Level, Key);
+    double Distance;
+    if (SelectionBox::RayEntersLocalBox(RayOrigin, Direction, Bounds.Min, Bounds.Max, BestDistance, Distance)) {
+      PickQueue.HeapPush(FPickNode{Distance, Level, Key});
+    } else if (Level == INDEX_NONE) {
+      INC_DWORD_STAT(STAT_SelectionBox_CellsCulled);
+    }
+  };
+  for (const TPair<FIntPoint, FBlock>& Pair : Blocks[NumBlockLevels - 1]) {
+    PushNode(NumBlockLevels - 1, Pair.Key);
+  }
+  while (PickQueue.Num() > 0) {
+    FPickNode Node;
+    PickQueue.HeapPop(Node);
+    // Everything in this node, and in the nodes after it, is further away than the best hit.
+    if (Node.Distance >= BestDistance) {
+      break;
+    }
+    if (Node.Level != INDEX_NONE) {
+      for (const FIntPoint& Child : Blocks[Node.Level].FindChecked(Node.Key).Children) {
+        PushNode(Node.Level - 1, Child);
+      }
+      continue;
+    }
+    for (const int32 EntryIndex : Cells.FindChecked(Node.Key).Entries) {
+      if (!LastEntry || EntryIndex != *LastEntry) {
+        PickEntry(EntryIndex, RayOrigin, Direction, BestDistance, BestEntry);
+      }
+    }
+  }
+
+  if (BestEntry == INDEX_NONE) {
+    return false;
+  }
+  const FEntry& Entry = Entries[BestEntry];
+  ResultOut.Actor = Entry.Actor.Get();
+  ResultOut.Component = Entry.Component.Get();
+  ResultOut.Distance = BestDistance;
+  ResultOut.Location = RayOrigin + Direction * BestDistance;
+  return true;
+}
+
+bool USelectionBoxSubsystem::PickAtScreenPosition(const APlayerController* const Controller,
+                                                  const FVector2D& PixelCoordinates, const UObject* const LastHit,
+                                                  FSelectionBoxPickResult& ResultOut) {
+  FVector RayOrigin;
+  FVector RayDirection;
+  if (!Controller ||
+      !Controller->DeprojectScreenPositionToWorld(PixelCoordinates.X, PixelCoordinates.Y, RayOrigin, RayDirection)) {
+    ResultOut = FSelectionBoxPickResult{};
+    return false;
+  }
+  return Pick(RayOrigin, RayDirection, LastHit, ResultOut);
+}
+
+void USelectionBoxSubsystem::SetCellSize(const float NewCellSize) {
+  if (NewCellSize <= 0 || NewCellSize == CellSize) {
+    return;
+  }
+  CellSize = NewCellSize;
+  Cells.Reset();
+  for (TMap<FIntPoint, FBlock>& Level : Blocks) {
+    Level.Reset();
+  }
+  for (auto It = Entries.CreateIterator(); It; ++It) {
+    It->IndexInCell = INDEX_NONE;
+    InsertIntoCell(It.GetIndex());
+  }
+  UpdateMemoryStat();
+}
+
+void USelectionBoxSubsystem::Initialize(FSubsystemCollectionBase& Collection) {
+  Super::Initialize(Collection);
+  PostGarbageCollectHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddUObject(
+      this, &USelectionBoxSubsystem::HandlePostGarbageCollect);
+}
+
+void USelectionBoxSubsystem::Deinitialize() {
+  FCoreUObjectDelegates::GetPostGarbageCollect().Remove(PostGarbageCollectHandle);
+  for (FEntry& Entry : Entries) {
+    if (USceneComponent* const Source = Entry.TransformSource.Get()) {
+      Source->TransformUpdated.Remove(Entry.TransformUpdatedHandle);
+    }
+    if (AActor* const Actor = Entry.Actor.Get()) {
+      Actor->OnDestroyed.RemoveDynamic(this, &USelectionBoxSubsystem::HandleActorDestroyed);
+    }
+  }
+  Entries.Empty();
+  EntryLookup.Empty();
+  Cells.Empty();
+  for (TMap<FIntPoint, FBlock>& Level : Blocks) {
+    Level.Empty();
+  }
+  UpdateMemoryStat();
+  // Queries still in flight keep their own snapshots alive.
+  SnapshotPool.Empty();
+  Super::Deinitialize();
+}
+
+int32 USelectionBoxSubsystem::AddEntry(FEntry&& Entry, const UObject* const Key) {
+  const int32 EntryIndex = Entries.Add(MoveTemp(Entry));
+  FEntry& Added = Entries[EntryIndex];
+  Added.Key = FObjectKey(Key);
+  EntryLookup.Add(Added.Key, EntryIndex);
+
+  USceneComponent* const Source = Added.TransformSource.Get();
+  Added.TransformUpdatedHandle =
+      Source->TransformUpdated.AddUObject(this, &USelectionBoxSubsystem::HandleTransformUpdated, EntryIndex);
+  Added.Transform = Source->GetComponentTransform();
+  Added.WorldBounds =
+      FBoxSphereBounds(FBox{Added.LocalOrigin - Added.LocalExtent, Added.LocalOrigin + Added.LocalExtent})
+          .TransformBy(Added.Transform);
+  InsertIntoCell(EntryIndex);
+  UpdateMemoryStat();
+  return EntryIndex;
+}
+
+void USelectionBoxSubsystem::RemoveEntry(const UObject* const Key) {
+  if (const int32* const EntryIndex = Key ? EntryLookup.Find(FObjectKey(Key)) : nullptr) {
+    RemoveEntryAt(*EntryIndex);
+  }
+}
+
+void USelectionBoxSubsystem::RemoveEntryAt(const int32 EntryIndex) {
+  FEntry& Entry = Entries[EntryIndex];
+  EntryLookup.Remove(Entry.Key);
+  if (USceneComponent* const Source = Entry.TransformSource.Get()) {
+    Source->TransformUpdated.Remove(Entry.TransformUpdatedHandle);
+  }
+  RemoveFromCell(EntryIndex);
+  Entries.RemoveAt(EntryIndex);
+  UpdateMemoryStat();
+}
+
+void USelectionBoxSubsystem::UpdateEntry(const int32 EntryIndex) {
+  FEntry& Entry = Entries[EntryIndex];
+  const USceneComponent* const Source = Entry.TransformSource.Get();
+  if (!Source) {
+    return;
+  }
+  Entry.Transform = Source->GetComponentTransform();
+  Entry.WorldBounds =
+      FBoxSphereBounds(FBox{Entry.LocalOrigin - Entry.LocalExtent, Entry.LocalOrigin + Entry.LocalExtent})
+          .TransformBy(Entry.Transform);
+
+  const FIntPoint NewCell = CellForLocation(Entry.WorldBounds.Origin);
+  if (NewCell != Entry.Cell) {
+    RemoveFromCell(EntryIndex);
+    InsertIntoCell(EntryIndex);
+    UpdateMemoryStat();
+  } else {
+    // Same cell, the bounds only need to grow. They are tightened again if the cell is marked dirty.
+    GrowBounds(NewCell, Entry.WorldBounds.GetBox());
+  }
+}
+
+void USelectionBoxSubsystem::InsertIntoCell(const int32 EntryIndex) {
+  FEntry& Entry = Entries[EntryIndex];
+  Entry.Cell = CellForLocation(Entry.WorldBounds.Origin);
+  FCell* Cell = Cells.Find(Entry.Cell);
+  if (!Cell) {
+    Cell = &Cells.Add(Entry.Cell);
+    LinkCell(Entry.Cell);
+  }
+  Entry.IndexInCell = Cell->Entries.Add(EntryIndex);
+  GrowBounds(Entry.Cell, Entry.WorldBounds.GetBox());
+}
+
+void USelectionBoxSubsystem::RemoveFromCell(const int32 EntryIndex) {
+  FEntry& Entry = Entries[EntryIndex];
+  FCell* const Cell = Cells.Find(Entry.Cell);
+  if (!Cell || Entry.IndexInCell == INDEX_NONE) {
+    return;
+  }
+  // Swap the last entry of the cell into the vacated slot:
+  Cell->Entries.RemoveAtSwap(Entry.IndexInCell);
+  if (Cell->Entries.IsValidIndex(Entry.IndexInCell)) {
+    Entries[Cell->Entries[Entry.IndexInCell]].IndexInCell = Entry.IndexInCell;
+  }
+  Entry.IndexInCell = INDEX_NONE;
+
+  if (Cell->Entries.Num() == 0) {
+    Cells.Remove(Entry.Cell);
+    UnlinkCell(Entry.Cell);
+  } else {
+    Cell->bBoundsDirty = true;
+    MarkBlocksDirty(Entry.Cell);
+  }
+}
+
+void USelectionBoxSubsystem::UpdateMemoryStat() const {
+#if STATS
+  // The entry arrays of the cells hold one index per entry, plus some slack.
+  SIZE_T AllocatedSize = Entries.GetAllocatedSize() + EntryLookup.GetAllocatedSize() + Cells.GetAllocatedSize() +
+                         Entries.Num() * sizeof(int32);
+  for (const TMap<FIntPoint, FBlock>& Level : Blocks) {
+    AllocatedSize += Level.GetAllocatedSize();
+  }
+  SET_MEMORY_STAT(STAT_SelectionBox_SubsystemMemory, AllocatedSize);
+#endif
+}
+
+FIntPoint USelectionBoxSubsystem::CellForLocation(const FVector& Location) const {
+  return FIntPoint{FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize)};
+}
+
+void USelectionBoxSubsystem::LinkCell(const FIntPoint& CellKey) {
+  FIntPoint Key = CellKey;
+  for (int32 Level = 0; Level < NumBlockLevels; ++Level) {
+    const FIntPoint BlockKey = ParentKey(Key);
+    FBlock* Block = Blocks[Level].Find(BlockKey);
+    const bool bCreated = Block == nullptr;
+    if (bCreated) {
+      Block = &Blocks[Level].Add(BlockKey);
+    }
+    Block->Children.Add(Key);
+    if (!bCreated) {
+      return;
+    }
+    Key = BlockKey;
+  }
+}
+
+void USelectionBoxSubsystem::UnlinkCell(const FIntPoint& CellKey) {
+  FIntPoint Key = CellKey;
+  for (int32 Level = 0; Level < NumBlockLevels; ++Level) {
+    const FIntPoint BlockKey = ParentKey(Key);
+    FBlock& Block = Blocks[Level].FindChecked(BlockKey);
+    Block.Children.RemoveSingleSwap(Key);
+    if (Block.Children.Num() > 0) {
+      // The bounds of this block, and of those above it, may now be loose.
+      Block.bBoundsDirty = true;
+      FIntPoint AboveKey = BlockKey;
+      for (int32 Above = Level + 1; Above < NumBlockLevels; ++Above) {
+        AboveKey = ParentKey(AboveKey);
+        Blocks[Above].FindChecked(AboveKey).bBoundsDirty = true;
+      }
+      return;
+    }
+    Blocks[Level].Remove(BlockKey);
+    Key = BlockKey;
+  }
+}
+
+void USelectionBoxSubsystem::GrowBounds(const FIntPoint& CellKey, const FBox& Box) {
+  Cells.FindChecked(CellKey).Bounds += Box;
+  FIntPoint Key = CellKey;
+  for (TMap<FIntPoint, FBlock>& Level : Blocks) {
+    Key = ParentKey(Key);
+    Level.FindChecked(Key).Bounds += Box;
+  }
+}
+
+void USelectionBoxSubsystem::MarkBlocksDirty(const FIntPoint& CellKey) {
+  FIntPoint Key = CellKey;
+  for (TMap<FIntPoint, FBlock>& Level : Blocks) {
+    Key = ParentKey(Key);
+    FBlock& Block = Level.FindChecked(Key);
+    if (Block.bBoundsDirty) {
+      // The blocks above were marked along with it.
+      return;
+    }
+    Block.bBoundsDirty = true;
+  }
+}
+
+void USelectionBoxSubsystem::HandleTransformUpdated(USceneComponent* const UpdatedComponent,
+                                                    const EUpdateTransformFlags UpdateTransformFlags,
+                                                    const ETeleportType Teleport, const int32 EntryIndex) {
+  if (Entries.IsValidIndex(EntryIndex) && Entries[EntryIndex].TransformSource.Get() == UpdatedComponent) {
+    UpdateEntry(EntryIndex);
+  }
+}
+
+void USelectionBoxSubsystem::HandleActorDestroyed(AActor* const DestroyedActor) {
+  RemoveEntry(DestroyedActor);
+}
+
+void USelectionBoxSubsystem::HandlePostGarbageCollect() {
+  for (auto It = Entries.CreateIterator(); It; ++It) {
+    const bool bObjectAlive = It->Actor.IsValid() || It->Component.IsValid();
+    if (bObjectAlive && It->TransformSource.IsValid()) {
+      continue;
+    }
+    if (AActor* const Actor = It->Actor.Get()) {
+      // The actor survived, but not its root component.
+      Actor->OnDestroyed.RemoveDynamic(this, &USelectionBoxSubsystem::HandleActorDestroyed);
+    }
+    // Removing from a sparse array leaves the other indices, and so the iterator, intact.
+    RemoveEntryAt(It.GetIndex());
+  }
+}
+
+void USelectionBoxSubsystem::RefreshCellBounds(FCell& Cell) const {
+  if (Cell.bBoundsDirty) {
+    Cell.Bounds.Init();
+    for (const int32 EntryIndex : Cell.Entries) {
+      Cell.Bounds += Entries[EntryIndex].WorldBounds.GetBox();
+    }
+    Cell.bBoundsDirty = false;
+  }
+}
+
+void USelectionBoxSubsystem::RefreshBlockBounds(const int32 Level, FBlock& Block) {
+  if (!Block.bBoundsDirty) {
+    return;
+  }
+  Block.Bounds.Init();
+  for (const FIntPoint& Child : Block.Children) {
+    Block.Bounds += GetNodeBounds(Level - 1, Child);
+  }
+  Block.bBoundsDirty = false;
+}
+
+const FBox& USelectionBoxSubsystem::GetNodeBounds(const int32 Level, const FIntPoint& Key) {
+  if (Level == INDEX_NONE) {
+    FCell& Cell = Cells.FindChecked(Key);
+    RefreshCellBounds(Cell);
+    return Cell.Bounds;
+  }
+  FBlock& Block = Blocks[Level].FindChecked(Key);
+  RefreshBlockBounds(Level, Block);
+  return Block.Bounds;
+}
+
+void USelectionBoxSubsystem::PickEntry(const int32 EntryIndex, const FVector& RayOrigin, const FVector& Direction,
+                                       double& BestDistance, int32& BestEntry) const {
+  const FEntry& Entry = Entries[EntryIndex];
+  if (!Entry.TransformSource.IsValid() ||
+      !SelectionBox::RayMayHitSphere(RayOrigin, Direction, Entry.WorldBounds.Origin, Entry.WorldBounds.SphereRadius,
+                                     BestDistance)) {
+    return;
+  }
+  INC_DWORD_STAT(STAT_SelectionBox_PickBoxesTested);
+  double Distance;
+  if (USelectionBoxFunctionLibrary::RayIntersectsTransformedBoxDistance(
+          RayOrigin, Direction, Entry.Transform, Entry.LocalOrigin, Entry.LocalExtent, Distance, BestDistance) &&
+      Distance < BestDistance) {
+    BestDistance = Distance;
+    BestEntry = EntryIndex;
+  }
+}
+
+void USelectionBoxSubsystem::ForEachOverlappingEntry(const FSelectionRegion& Region,
+                                                     const TFunctionRef<void(const FEntry&)> Visitor) {
+  SCOPE_CYCLE_COUNTER(STAT_SelectionBox_SubsystemQuery);
+  TRACE_CPUPROFILER_EVENT_SCOPE(USelectionBoxSubsystem::ForEachOverlappingEntry);
+  const FRegionPlanes Planes = Region.ComputePlanes();
+  ForEachCandidateEntry(Planes, [&](const FEntry& Entry, const bool bCellInside) {
+    if (bCellInside) {
+      Visitor(Entry);
+      return;
+    }
+    const SelectionBox::EOverlap SphereOverlap =
+        SelectionBox::ClassifySphere(Planes, Entry.WorldBounds.Origin, Entry.WorldBounds.SphereRadius);
+    if (SphereOverlap == SelectionBox::EOverlap::Outside) {
+      INC_DWORD_STAT(STAT_SelectionBox_SphereRejected);
+      return;
+    }
+    if (SphereOverlap == SelectionBox::EOverlap::Inside) {
+      INC_DWORD_STAT(STAT_SelectionBox_SphereAccepted);
+      Visitor(Entry);
+      return;
+    }
+    const ETransformedBoxTestResult Result = USelectionBoxFunctionLibrary::SelectionRegionOverlapsTransformedBox2(
+        Region, Planes, Entry.Transform, Entry.LocalOrigin, Entry.LocalExtent);
+    if (Result != ETransformedBoxTestResult::NoIntersection) {
+      Visitor(Entry);
+    }
+  });
+}
+
+void USelectionBoxSubsystem::ForEachCandidateEntry(const FRegionPlanes& Planes,
+                                                   const TFunctionRef<void(const FEntry&, bool)> Visitor) {
+  const SelectionBox::FPackedRegionPlanes PackedPlanes{Planes};
+  for (const TPair<FIntPoint, FBlock>& Pair : Blocks[NumBlockLevels - 1]) {
+    VisitCandidates(NumBlockLevels - 1, Pair.Key, Planes, PackedPlanes, false, Visitor);
+  }
+}
+
+void USelectionBoxSubsystem::VisitCandidates(const int32 Level, const FIntPoint& Key, const FRegionPlanes& Planes,
+                                             const SelectionBox::FPackedRegionPlanes& PackedPlanes, bool bInside,
+                                             const TFunctionRef<void(const FEntry&, bool)> Visitor) {
+  if (!bInside) {
+    const FBox& Bounds = GetNodeBounds(Level, Key);
+    const FVector Center = Bounds.GetCenter();
+    const FVector Extent = Bounds.GetExtent();
+    // Cull the whole cell or block if it lies outside any of the planes:
+    if (PackedPlanes.IsBoxOutside(Center, Extent) || SelectionBox::IsBoxOutsideClipPlanes(Planes, Center, Extent)) {
+      if (Level == INDEX_NONE) {
+        INC_DWORD_STAT(STAT_SelectionBox_CellsCulled);
+      } else {
+        INC_DWORD_STAT(STAT_SelectionBox_BlocksCulled);
+      }
+      return;
+    }
+    // The bounds enclose every entry below them, so if they are inside, the entries are too.
+    bInside = SelectionBox::ClassifyAlignedBox(Planes, Center, Extent) == SelectionBox::EOverlap::Inside;
+  }
+
+  if (Level != INDEX_NONE) {
+    for (const FIntPoint& Child : Blocks[Level].FindChecked(Key).Children) {
+      VisitCandidates(Level - 1, Child, Planes, PackedPlanes, bInside, Visitor);
+    }
+    return;
+  }
+  if (bInside) {
+    INC_DWORD_STAT(STAT_SelectionBox_CellsInside);
+  }
+  for (const int32 EntryIndex : Cells.FindChecked(Key).Entries) {
+    const FEntry& Entry = Entries[EntryIndex];
+    if (Entry.TransformSource.IsValid()) {
+      Visitor(Entry, bInside);
+    }
+  }
+}
+
+void USelectionBoxSubsystem::QueryActorsAsync(const FSelectionRegion& Region,
+                                              TUniqueFunction<void(TArray<AActor*>&&)> OnCompleted) {
+  const FSnapshotRef Snapshot = AcquireSnapshot();
+  Snapshot->OnActorsCompleted = MoveTemp(OnCompleted);
+  LaunchAsyncQuery(Region, true, Snapshot);
+}
+
+TFuture<TArray<AActor*>> USelectionBoxSubsystem::QueryActorsAsync(const FSelectionRegion& Region) {
+  const FSnapshotRef Snapshot = AcquireSnapshot();
+  TFuture<TArray<AActor*>> Future = Snapshot->ActorsPromise.Emplace().GetFuture();
+  LaunchAsyncQuery(Region, true, Snapshot);
+  return Future;
+}
+
+void USelectionBoxSubsystem::QueryComponentsAsync(const FSelectionRegion& Region,
+                                                  TUniqueFunction<void(TArray<USceneComponent*>&&)> OnCompleted) {
+  const FSnapshotRef Snapshot = AcquireSnapshot();
+  Snapshot->OnComponentsCompleted = MoveTemp(OnCompleted);
+  LaunchAsyncQuery(Region, false, Snapshot);
+}
+
+TFuture<TArray<USceneComponent*>> USelectionBoxSubsystem::QueryComponentsAsync(const FSelectionRegion& Region) {
+  const FSnapshotRef Snapshot = AcquireSnapshot();
+  TFuture<TArray<USceneComponent*>> Future = Snapshot->ComponentsPromise.Emplace().GetFuture();
+  LaunchAsyncQuery(Region, false, Snapshot);
+  return Future;
+}
+
+void USelectionBoxSubsystem::LaunchAsyncQuery(const FSelectionRegion& Region, const bool bActors,
+                                              const FSnapshotRef& Snapshot) {
+  check(IsInGameThread());
+  {
+    SCOPE_CYCLE_COUNTER(STAT_SelectionBox_AsyncSnapshot);
+    TRACE_CPUPROFILER_EVENT_SCOPE(USelectionBoxSubsystem::LaunchAsyncQuery);
+    Snapshot->Region = Region;
+    Snapshot->Planes = Region.ComputePlanes();
+    Snapshot->Boxes.Reset();
+    Snapshot->Objects.Reset();
+    Snapshot->Overlapping.Reset();
+    ForEachCandidateEntry(Snapshot->Planes, [bActors, &Data = *Snapshot](const FEntry& Entry, bool) {
+      UObject* const Object = bActors ? static_cast<UObject*>(Entry.Actor.Get()) : Entry.Component.Get();
+      if (Object) {
+        Data.Boxes.Add(Entry.Transform, Entry.LocalOrigin, Entry.LocalExtent);
+        Data.Objects.Add(Object);
+      }
+    });
+  }
+
+  // The worker only touches the snapshot, so the subsystem is free to change (or go away) in the meantime.
+  TGraphTask<FAsyncTestTask>::CreateTask().ConstructAndDispatchWhenReady(Snapshot);
+}
+
+TSharedRef<FSelectionBoxAsyncSnapshot, ESPMode::ThreadSafe> USelectionBoxSubsystem::AcquireSnapshot() {
+  for (const TSharedRef<FSelectionBoxAsyncSnapshot, ESPMode::ThreadSafe>& Snapshot : SnapshotPool) {
+    if (Snapshot.IsUnique()) {
+      return Snapshot;
+    }
+  }
+  return SnapshotPool.Add_GetRef(MakeShared<FSelectionBoxAsyncSnapshot, ESPMode::ThreadSafe>());
+}
@@ -0,0 +1,95 @@
+// Copyright 2021 Gareth Cross.
+#include "Misc/AutomationTest.h"
+#include "SelectionBoxFunctionLibrary.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace {
+
+// Copy of `Boxes` with every extent scaled, about the center of each box.
+FSelectionBoxBatchData ScaleExtents(const FSelectionBoxBatchData& Boxes, const double Scale) {
+  FSelectionBoxBatchData Result = Boxes;
+  for (FVector& Extent : Result.Extents) {
+    Extent *= Scale;
+  }
+  return Result;
+}
+
+}  // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSelectionBoxCameraRelativeTest, "SelectionBox.Batch.CameraRelativeFarFromOrigin",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext |
+                                     EAutomationTestFlags::ServerContext | EAutomationTestFlags::EngineFilter)
+
+bool FSelectionBoxCameraRelativeTest::RunTest(const FString& Parameters) {
+  // The scene of the drag selection test, 20km from the world origin, where a float can only resolve about a
+  // quarter of a unit.
+  const FVector SceneOrigin{2.0e6, -2.0e6, 1.0e5};
+  FRandomStream Random{19};
+  FSelectionBoxBatchData Boxes;
+  for (int32 i = 0; i < 4000; ++i) {
+    const FVector Location{Random.FRandRange(-8000, 8000), Random.FRandRange(-8000, 8000), 0};
+    const FVector Extent{Random.FRandRange(30, 150), Random.FRandRange(30, 150), Random.FRandRange(30, 150)};
+    Boxes.Add(FTransform{FRotator{0, Random.FRandRange(-180, 180), 0}, SceneOrigin + Location},
+              FVector{0, 0, Extent.Z}, Extent);
+  }
+  // Boxes that change result when grown or shrunk by half a percent touch the boundary, where float rounding may
+  // decide either way.
+  const FSelectionBoxBatchData Shrunk = ScaleExtents(Boxes, 0.995);
+  const FSelectionBoxBatchData Grown = ScaleExtents(Boxes, 1.005);
+
+  const FIntRect ViewRect{0, 0, 1920, 1080};
+  const FVector CameraLocation = SceneOrigin + FVector{-6000, 0, 6000};
+  const FMatrix ViewMatrix = FTranslationMatrix{-CameraLocation} * FInverseRotationMatrix{FRotator{-45, 0, 0}} *
+                             FMatrix{FPlane{0, 0, 1, 0}, FPlane{1, 0, 0, 0}, FPlane{0, 1, 0, 0}, FPlane{0, 0, 0, 1}};
+  const FMatrix ProjectionMatrix = FReversedZPerspectiveMatrix{FMath::DegreesToRadians(90.0f) / 2,
+                                                               static_cast<float>(ViewRect.Width()),
+                                                               static_cast<float>(ViewRect.Height()), 10.0f};
+  const FMatrix ViewProjectionMatrix = ViewMatrix * ProjectionMatrix;
+
+  FSelectionQueryOptions RelativeOptions;
+  RelativeOptions.bCameraRelative = true;
+  int32 NumChecked = 0;
+  int32 NumSelected = 0;
+  TBitArray<> Expected;
+  TBitArray<> ExpectedShrunk;
+  TBitArray<> ExpectedGrown;
+  TBitArray<> Relative;
+  for (int32 i = 0; i < 20; ++i) {
+    const FVector2D Start{Random.FRandRange(0, 1920), Random.FRandRange(0, 1080)};
+    const FVector2D End{Random.FRandRange(0, 1920), Random.FRandRange(0, 1080)};
+    FSelectionRegion Region;
+    USelectionBoxFunctionLibrary::CreateSelectionRegionFromViewProjection(ViewProjectionMatrix, ViewRect, Start, End,
+                                                                          Region);
+    // Every other region also has a far plane, whose offset is rebased onto the camera too.
+    if (i % 2 == 1) {
+      Region.ViewDirection = FRotator{-45, 0, 0}.Vector();
+      Region.FarDistance = 9000;
+    }
+    const FRegionPlanes Planes = Region.ComputePlanes();
+    USelectionBoxFunctionLibrary::SelectionRegionOverlapsTransformedBoxBatch(Region, Planes, Boxes.GetView(),
+                                                                             Expected);
+    USelectionBoxFunctionLibrary::SelectionRegionOverlapsTransformedBoxBatch(Region, Planes, Shrunk.GetView(),
+                                                                             ExpectedShrunk);
+    USelectionBoxFunctionLibrary::SelectionRegionOverlapsTransformedBoxBatch(Region, Planes, Grown.GetView(),
+                                                                             ExpectedGrown);
+    USelectionBoxFunctionLibrary::SelectionRegionOverlapsTransformedBoxBatch(Region, Planes, Boxes.GetView(),
+                                                                             Relative, RelativeOptions);
+    for (int32 b = 0; b < Boxes.Num(); ++b) {
+      if (ExpectedShrunk[b] != Expected[b] || ExpectedGrown[b] != Expected[b]) {
+        continue;
+      }
+      if (Relative[b] != Expected[b]) {
+        AddError(FString::Printf(TEXT("Region %d, box %d: camera-relative says %d, double says %d"), i, b,
+                                 static_cast<int32>(Relative[b]), static_cast<int32>(Expected[b])));
+      }
+      ++NumChecked;
+      NumSelected += Expected[b];
+    }
+  }
+  TestTrue(TEXT("Most boxes are far enough from the boundary to check"), NumChecked > 20 * Boxes.Num() * 9 / 10);
+  TestTrue(TEXT("Some boxes are selected"), NumSelected > 0);
+  return true;
+}
+
+#endif  // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,436 @@
+// Copyright 2021 Gareth Cross.
+#include "Algo/Reverse.h"
+#include "Misc/AutomationTest.h"
+#include "SelectionBoxCore.h"
+#include "SelectionBoxKernels.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace SelectionBox {
+namespace {
+
+constexpr auto TestFlags = EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext |
+                           EAutomationTestFlags::ServerContext | EAutomationTestFlags::EngineFilter;
+
+using FVec3d = TVector3<double>;
+using FVec3f = TVector3<float>;
+
+template <typename T>
+TVector3<T> Convert(const FVec3d& V) {
+  return TVector3<T>(static_cast<T>(V.X), static_cast<T>(V.Y), static_cast<T>(V.Z));
+}
+
+template <typename T>
+TOrientedBox<TVector3<T>> Convert(const TOrientedBox<FVec3d>& Box) {
+  return TOrientedBox<TVector3<T>>{Convert<T>(Box.Center),
+                                   {Convert<T>(Box.Axes[0]), Convert<T>(Box.Axes[1]), Convert<T>(Box.Axes[2])}};
+}
+
+template <typename T>
+TRegion<TVector3<T>> Convert(const TRegion<FVec3d>& Region) {
+  return TRegion<TVector3<T>>{Convert<T>(Region.CameraOrigin), Convert<T>(Region.TopLeftRay),
+                              Convert<T>(Region.TopRightRay), Convert<T>(Region.BottomRightRay),
+                              Convert<T>(Region.BottomLeftRay)};
+}
+
+template <typename T>
+TOrthoRegion<TVector3<T>> Convert(const TOrthoRegion<FVec3d>& Region) {
+  return TOrthoRegion<TVector3<T>>{Convert<T>(Region.Center), Convert<T>(Region.Right), Convert<T>(Region.Up),
+                                   static_cast<T>(Region.HalfWidth), static_cast<T>(Region.HalfHeight)};
+}
+
+FVec3d RandomUnitVector(FRandomStream& Random) {
+  for (;;) {
+    const FVec3d V{Random.FRandRange(-1, 1), Random.FRandRange(-1, 1), Random.FRandRange(-1, 1)};
+    const double SquaredSize = Vec::Dot(V, V);
+    if (SquaredSize > 0.01 && SquaredSize <= 1) {
+      return Vec::Scale(V, 1 / std::sqrt(SquaredSize));
+    }
+  }
+}
+
+// A box with random orientation and extents, near `Center`.
+TOrientedBox<FVec3d> RandomBox(FRandomStream& Random, const FVec3d& Center, const double Spread) {
+  const FVec3d X = RandomUnitVector(Random);
+  const FVec3d Y = Vec::SafeNormal(Vec::Cross(X, RandomUnitVector(Random)));
+  const FVec3d Z = Vec::Cross(X, Y);
+  const FVec3d Offset{Random.FRandRange(-Spread, Spread), Random.FRandRange(-Spread, Spread),
+                      Random.FRandRange(-Spread, Spread)};
+  return TOrientedBox<FVec3d>{Vec::Add(Center, Offset),
+                              {Vec::Scale(X, Random.FRandRange(10, 200)), Vec::Scale(Y, Random.FRandRange(10, 200)),
+                               Vec::Scale(Z, Random.FRandRange(10, 200))}};
+}
+
+TOrientedBox<FVec3d> ScaleBox(const TOrientedBox<FVec3d>& Box, const double Scale) {
+  return TOrientedBox<FVec3d>{
+      Box.Center, {Vec::Scale(Box.Axes[0], Scale), Vec::Scale(Box.Axes[1], Scale), Vec::Scale(Box.Axes[2], Scale)}};
+}
+
+// A perspective region looking down +X from `Origin`, with the given half-angles (as tangents) to the edges.
+TRegion<FVec3d> MakeRegion(const FVec3d& Origin, const double Left, const double Right, const double Top,
+                           const double Bottom) {
+  return TRegion<FVec3d>{Origin, Vec::SafeNormal(FVec3d{1, -Left, Top}), Vec::SafeNormal(FVec3d{1, Right, Top}),
+                         Vec::SafeNormal(FVec3d{1, Right, -Bottom}), Vec::SafeNormal(FVec3d{1, -Left, -Bottom})};
+}
+
+// Signed distance by which the 2D convex polygons `A` and `B` are apart: positive if some edge normal separates them,
+// negative (the smallest overlap along any edge normal) otherwise.
+double PolygonSeparation(const TArray<FVector2D>& A, const TArray<FVector2D>& B) {
+  double Separation = -TNumericLimits<double>::Max();
+  for (const TArray<FVector2D>* Polygon : {&A, &B}) {
+    for (int32 i = 0; i < Polygon->Num(); ++i) {
+      const FVector2D Edge = (*Polygon)[(i + 1) % Polygon->Num()] - (*Polygon)[i];
+      const FVector2D Normal = FVector2D{-Edge.Y, Edge.X}.GetSafeNormal();
+      if (Normal.IsZero()) {
+        continue;
+      }
+      double MinA = TNumericLimits<double>::Max();
+      double MaxA = -TNumericLimits<double>::Max();
+      double MinB = TNumericLimits<double>::Max();
+      double MaxB = -TNumericLimits<double>::Max();
+      for (const FVector2D& P : A) {
+        MinA = FMath::Min(MinA, Normal | P);
+        MaxA = FMath::Max(MaxA, Normal | P);
+      }
+      for (const FVector2D& P : B) {
+        MinB = FMath::Min(MinB, Normal | P);
+        MaxB = FMath::Max(MaxB, Normal | P);
+      }
+      Separation = FMath::Max(Separation, FMath::Max(MinB - MaxA, MinA - MaxB));
+    }
+  }
+  return Separation;
+}
+
+// Convex hull of a set of 2D points, counter-clockwise (Andrew's monotone chain).
+TArray<FVector2D> ConvexHull(TArray<FVector2D> Points) {
+  Points.Sort([](const FVector2D& A, const FVector2D& B) { return A.X < B.X || (A.X == B.X && A.Y < B.Y); });
+  TArray<FVector2D> Hull;
+  for (int32 Pass = 0; Pass < 2; ++Pass) {
+    const int32 Start = Hull.Num();
+    for (const FVector2D& P : Points) {
+      while (Hull.Num() >= Start + 2 && ((Hull.Last() - Hull.Last(1)) ^ (P - Hull.Last(1))) <= 0) {
+        Hull.Pop();
+      }
+      Hull.Add(P);
+    }
+    Hull.Pop();
+    Algo::Reverse(Points);
+  }
+  return Hull;
+}
+
+}  // namespace
+}  // namespace SelectionBox
+
+using namespace SelectionBox;
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSelectionBoxCoreOutcodesTest, "SelectionBox.Core.Outcodes", TestFlags)
+
+bool FSelectionBoxCoreOutcodesTest::RunTest(const FString& Parameters) {
+  // A mask never keeps both planes of a pair, keeps top over bottom and left over right, and only drops bits.
+  for (uint32_t Mask = 0; Mask < 16; ++Mask) {
+    const uint32_t Code = OutcodeFromMask(Mask);
+    const uint32_t Expected =
+        (Mask & (OutcodeTop | OutcodeLeft)) | ((Mask & OutcodeTop) ? 0 : Mask & OutcodeBottom) |
+        ((Mask & OutcodeLeft) ? 0 : Mask & OutcodeRight);
+    TestEqual(FString::Printf(TEXT("OutcodeFromMask(%u)"), Mask), Code, Expected);
+  }
+
+  // The nine regions in front of the camera, and a point behind it.
+  const TRegionPlanes<FVec3d> Planes = ComputeRegionPlanes(MakeRegion(FVec3d{0, 0, 0}, 0.5, 0.5, 0.5, 0.5));
+  const struct {
+    FVec3d Point;
+    uint32_t Mask;
+  } Cases[] = {
+      {{100, 0, 0}, 0},
+      {{100, 0, 80}, OutcodeTop},
+      {{100, 0, -80}, OutcodeBottom},
+      {{100, 80, 0}, OutcodeRight},
+      {{100, -80, 0}, OutcodeLeft},
+      {{100, 80, 80}, OutcodeTop | OutcodeRight},
+      {{100, -80, 80}, OutcodeTop | OutcodeLeft},
+      {{100, 80, -80}, OutcodeBottom | OutcodeRight},
+      {{100, -80, -80}, OutcodeBottom | OutcodeLeft},
+      {{-100, 0, 0}, OutcodeTop | OutcodeBottom | OutcodeLeft | OutcodeRight},
+  };
+  for (const auto& Case : Cases) {
+    TestEqual(FString::Printf(TEXT("OutsideMask(%g, %g, %g)"), Case.Point.X, Case.Point.Y, Case.Point.Z),
+              OutsideMask(Planes, Case.Point), Case.Mask);
+  }
+
+  // The summary bits agree with the per-corner masks.
+  FRandomStream Random{1};
+  for (int32 i = 0; i < 1000; ++i) {
+    FVec3d Pts[8];
+    ComputeCorners(RandomBox(Random, FVec3d{500, 0, 0}, 400), Pts);
+    const FCornerOutcodes Outcodes = ClassifyCorners(Planes, Pts);
+    uint32_t AllOutside = 0xF;
+    bool bAnyInside = false;
+    bool bAllInside = true;
+    for (int32 c = 0; c < 8; ++c) {
+      const uint32_t Mask = OutsideMask(Planes, Pts[c]);
+      AllOutside &= Mask;
+      bAnyInside |= Mask == 0;
+      bAllInside &= Mask == 0;
+      if (Outcodes.Codes[c] != OutcodeFromMask(Mask)) {
+        AddError(FString::Printf(TEXT("Box %d: wrong outcode for corner %d"), i, c));
+      }
+    }
+    if (Outcodes.AllOutside != AllOutside || (Outcodes.AnyInside != 0) != bAnyInside ||
+        (Outcodes.AllInside != 0) != bAllInside) {
+      AddError(FString::Printf(TEXT("Box %d: summary bits disagree with the corners"), i));
+    }
+  }
+  return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSelectionBoxCoreRayTest, "SelectionBox.Core.RaySlab", TestFlags)
+
+bool FSelectionBoxCoreRayTest::RunTest(const FString& Parameters) {
+  const FVec3d Min{-1, -2, -3};
+  const FVec3d Max{1, 2, 3};
+  double TEntry = -1;
+
+  // Hits from outside report the distance to the entry face. `L` need not be normalized.
+  const double NoLimit = TNumericLimits<double>::Max();
+  TestTrue(TEXT("Ray towards the box hits"),
+           RayEntersLocalBox(FVec3d{-5, 0, 0}, FVec3d{2, 0, 0}, Min, Max, NoLimit, TEntry));
+  TestEqual(TEXT("Entry of a ray towards the box"), TEntry, 2.0);
+
+  // Only t >= 0 counts: the same line pointing away from the box misses.
+  TestFalse(TEXT("Ray away from the box misses"), RayIntersectsLocalBox(FVec3d{-5, 0, 0}, FVec3d{-1, 0, 0}, Min, Max));
+  TestFalse(TEXT("Ray starting past the box misses"),
+            RayIntersectsLocalBox(FVec3d{5, 0, 0}, FVec3d{1, 0, 0}, Min, Max));
+
+  // A ray from inside hits at t = 0, whichever way it points.
+  TestTrue(TEXT("Ray from inside hits"),
+           RayEntersLocalBox(FVec3d{0.5, 0, 0}, FVec3d{-1, 0, 0}, Min, Max, NoLimit, TEntry));
+  TestEqual(TEXT("Entry of a ray from inside"), TEntry, 0.0);
+
+  // A ray parallel to a pair of faces hits only if it starts between them. The faces themselves count, and so do
+  // the edges.
+  TestFalse(TEXT("Parallel ray outside the slab misses"),
+            RayIntersectsLocalBox(FVec3d{-5, 2.5, 0}, FVec3d{1, 0, 0}, Min, Max));
+  TestTrue(TEXT("Parallel ray inside the slab hits"),
+           RayIntersectsLocalBox(FVec3d{-5, 1.5, 0}, FVec3d{1, 0, 0}, Min, Max));
+  TestTrue(TEXT("Parallel ray along a face hits"), RayIntersectsLocalBox(FVec3d{-5, 2, 0}, FVec3d{1, 0, 0}, Min, Max));
+  TestTrue(TEXT("Ray through an edge hits"), RayIntersectsLocalBox(FVec3d{-5, -2, 0}, FVec3d{1, 1, 0}, Min, Max));
+  TestFalse(TEXT("Ray just past an edge misses"),
+            RayIntersectsLocalBox(FVec3d{-5, -1.99, 0}, FVec3d{1, 1, 0}, Min, Max));
+
+  // MaxT cuts the ray short.
+  TestFalse(TEXT("Ray shorter than the entry misses"),
+            RayEntersLocalBox(FVec3d{-5, 0, 0}, FVec3d{1, 0, 0}, Min, Max, 3.9, TEntry));
+  TestTrue(TEXT("Ray reaching the entry hits"),
+           RayEntersLocalBox(FVec3d{-5, 0, 0}, FVec3d{1, 0, 0}, Min, Max, 4.0, TEntry));
+
+  // Oriented boxes: a flat box is never hit, and otherwise the result matches brute force.
+  const TOrientedBox<FVec3d> Flat{FVec3d{0, 0, 0}, {FVec3d{1, 0, 0}, FVec3d{0, 1, 0}, FVec3d{0, 0, 0}}};
+  TestFalse(TEXT("Flat box is never hit"), RayIntersectsBox(Flat, FVec3d{0, 0, 5}, FVec3d{0, 0, -1}));
+
+  FRandomStream Random{2};
+  for (int32 i = 0; i < 1000; ++i) {
+    const TOrientedBox<FVec3d> Box = RandomBox(Random, FVec3d{0, 0, 0}, 100);
+    const FVec3d P{Random.FRandRange(-500, 500), Random.FRandRange(-500, 500), Random.FRandRange(-500, 500)};
+    const FVec3d L = RandomUnitVector(Random);
+    // Brute force: step along the ray, looking for a point inside the box. Rays that only come within a percent of
+    // the surface are skipped, since the steps could miss them.
+    bool bHit = false;
+    bool bGraze = false;
+    for (double t = 0; t < 2000 && !bHit; t += 0.25) {
+      const FVec3d Offset = Vec::Sub(Vec::Add(P, Vec::Scale(L, t)), Box.Center);
+      double Worst = 0;
+      for (int32 Axis = 0; Axis < 3; ++Axis) {
+        const double SquaredLength = Vec::Dot(Box.Axes[Axis], Box.Axes[Axis]);
+        Worst = FMath::Max(Worst, FMath::Abs(Vec::Dot(Offset, Box.Axes[Axis]) / SquaredLength));
+      }
+      bHit = Worst <= 0.99;
+      bGraze |= Worst <= 1.01;
+    }
+    if (bHit != bGraze) {
+      // Too close to the surface for the sampling to be sure.
+      continue;
+    }
+    if (RayIntersectsBox(Box, P, L) != bHit) {
+      AddError(FString::Printf(TEXT("Ray %d: expected %s"), i, bHit ? TEXT("a hit") : TEXT("a miss")));
+    }
+  }
+  return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSelectionBoxKernelRayTest, "SelectionBox.Core.RaySlabSimd", TestFlags)
+
+bool FSelectionBoxKernelRayTest::RunTest(const FString& Parameters) {
+  // The single precision four-ray kernel must agree with the double precision slab test, except on rays that pass
+  // within a thousandth of the box size of its surface. A quarter of the rays start inside the box, and half of
+  // them are parallel to one or two pairs of faces.
+  FRandomStream Random{12};
+  int32 NumChecked = 0;
+  for (int32 i = 0; i < 20000; ++i) {
+    const FVector Center{Random.FRandRange(-100, 100), Random.FRandRange(-100, 100), Random.FRandRange(-100, 100)};
+    const FVector HalfSize{Random.FRandRange(10, 200), Random.FRandRange(10, 200), Random.FRandRange(10, 200)};
+    const FVector Min = Center - HalfSize;
+    const FVector Max = Center + HalfSize;
+    const FVector Margin = HalfSize * 1.0e-3;
+    const FVector Origin =
+        i % 4 == 0 ? Center + HalfSize * FVector{Random.FRandRange(-0.99, 0.99), Random.FRandRange(-0.99, 0.99),
+                                                 Random.FRandRange(-0.99, 0.99)}
+                   : FVector{Random.FRandRange(-600, 600), Random.FRandRange(-600, 600), Random.FRandRange(-600, 600)};
+
+    FVector Rays[4];
+    bool bAnyHit = false;
+    bool bAllStable = true;
+    for (int32 r = 0; r < 4; ++r) {
+      FVector Ray = Random.GetUnitVector();
+      switch (Random.RandHelper(6)) {
+        case 0:
+          Ray.X = 0;
+          break;
+        case 1:
+          Ray.Y = 0;
+          break;
+        case 2:
+          Ray.Y = 0;
+          Ray.Z = 0;
+          break;
+        default:
+          break;
+      }
+      if (Ray.IsNearlyZero(0.1)) {
+        Ray = FVector{0, 0, 1};
+      }
+      Rays[r] = Ray.GetUnsafeNormal();
+
+      const bool bHit = RayIntersectsLocalBox(Origin, Rays[r], Min, Max);
+      if (RayIntersectsLocalBox(Origin, Rays[r], Min + Margin, Max - Margin) != bHit ||
+          RayIntersectsLocalBox(Origin, Rays[r], Min - Margin, Max + Margin) != bHit) {
+        bAllStable = false;
+        continue;
+      }
+      const FVector Same[4] = {Rays[r], Rays[r], Rays[r], Rays[r]};
+      if (AnyRayIntersectsLocalBox(Origin, Same, Min, Max) != bHit) {
+        AddError(FString::Printf(TEXT("Box %d, ray %d: kernel says %d, slab test says %d"), i, r,
+                                 static_cast<int32>(!bHit), static_cast<int32>(bHit)));
+      }
+      bAnyHit |= bHit;
+      ++NumChecked;
+    }
+    if (bAllStable && AnyRayIntersectsLocalBox(Origin, Rays, Min, Max) != bAnyHit) {
+      AddError(FString::Printf(TEXT("Box %d: kernel disagrees on whether any of the four rays hits"), i));
+    }
+  }
+  TestTrue(TEXT("Most rays are far enough from the surface to check"), NumChecked > 4 * 20000 * 9 / 10);
+  return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSelectionBoxCoreOrthoBoxTest, "SelectionBox.Core.OrthoBox", TestFlags)
+
+bool FSelectionBoxCoreOrthoBoxTest::RunTest(const FString& Parameters) {
+  // Brute force: project the corners onto the view plane, and compare their hull with the rectangle.
+  FRandomStream Random{3};
+  int32 NumChecked = 0;
+  for (int32 i = 0; i < 5000; ++i) {
+    const FVec3d Right = RandomUnitVector(Random);
+    const FVec3d Up = Vec::SafeNormal(Vec::Cross(RandomUnitVector(Random), Right));
+    const TOrthoRegion<FVec3d> Region{FVec3d{Random.FRandRange(-1000, 1000), Random.FRandRange(-1000, 1000), 0},
+                                      Right, Up, Random.FRandRange(20, 400), Random.FRandRange(20, 400)};
+    const TOrientedBox<FVec3d> Box = RandomBox(Random, Region.Center, 600);
+
+    FVec3d Pts[8];
+    ComputeCorners(Box, Pts);
+    TArray<FVector2D> Projected;
+    for (const FVec3d& Pt : Pts) {
+      const FVec3d FromCenter = Vec::Sub(Pt, Region.Center);
+      Projected.Add(FVector2D{Vec::Dot(FromCenter, Right), Vec::Dot(FromCenter, Up)});
+    }
+    const TArray<FVector2D> Rectangle = {{-Region.HalfWidth, -Region.HalfHeight},
+                                         {Region.HalfWidth, -Region.HalfHeight},
+                                         {Region.HalfWidth, Region.HalfHeight},
+                                         {-Region.HalfWidth, Region.HalfHeight}};
+    const double Separation = PolygonSeparation(ConvexHull(Projected), Rectangle);
+    double Containment = -TNumericLimits<double>::Max();
+    for (const FVector2D& P : Projected) {
+      Containment = FMath::Max(Containment, FMath::Max(FMath::Abs(P.X) - Region.HalfWidth,
+                                                       FMath::Abs(P.Y) - Region.HalfHeight));
+    }
+    if (FMath::Abs(Separation) < 1.0e-3 || FMath::Abs(Containment) < 1.0e-3) {
+      continue;
+    }
+    const EOverlap Expected =
+        Separation > 0 ? EOverlap::Outside : (Containment < 0 ? EOverlap::Inside : EOverlap::Intersecting);
+    const EOverlap Actual = ClassifyOrthoBox(Region, Box);
+    if (Actual != Expected) {
+      AddError(FString::Printf(TEXT("Box %d: got %d, expected %d"), i, static_cast<int32>(Actual),
+                               static_cast<int32>(Expected)));
+    }
+    ++NumChecked;
+  }
+  TestTrue(TEXT("Most boxes are far enough from the boundary to check"), NumChecked > 4500);
+  return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSelectionBoxCorePrecisionTest, "SelectionBox.Core.FloatMatchesDouble", TestFlags)
+
+bool FSelectionBoxCorePrecisionTest::RunTest(const FString& Parameters) {
+  // Boxes that don't come within a fraction of a percent of their size to the region boundary must get the same
+  // answer from the float and double versions. The full test must also agree with the conservative classification,
+  // and with itself when edges outside a plane are not skipped.
+  FRandomStream Random{4};
+  int32 NumChecked = 0;
+  for (int32 i = 0; i < 5000; ++i) {
+    const FVec3d Origin{Random.FRandRange(-5000, 5000), Random.FRandRange(-5000, 5000), Random.FRandRange(0, 2000)};
+    const TRegion<FVec3d> Region = MakeRegion(Origin, Random.FRandRange(0.05, 1), Random.FRandRange(0.05, 1),
+                                              Random.FRandRange(0.05, 1), Random.FRandRange(0.05, 1));
+    const TRegionPlanes<FVec3d> Planes = ComputeRegionPlanes(Region);
+    const TOrientedBox<FVec3d> Box = RandomBox(Random, Vec::Add(Origin, FVec3d{2000, 0, 0}), 2000);
+
+    const EBoxTestResult Result = TestBox(Region, Planes, Box);
+    const bool bOverlaps = Result != EBoxTestResult::NoIntersection;
+    const EOverlap Class = ClassifyOrientedBox(Planes, Box);
+    if ((Class == EOverlap::Inside && !bOverlaps) || (Class == EOverlap::Outside && bOverlaps)) {
+      AddError(FString::Printf(TEXT("Box %d: TestBox disagrees with ClassifyOrientedBox"), i));
+    }
+    if (TestBox</*bSkipOutsideEdges=*/false>(Region, Planes, Box) != Result) {
+      AddError(FString::Printf(TEXT("Box %d: skipping edges outside a plane changed the result"), i));
+    }
+
+    const bool bShrunk = TestBox(Region, Planes, ScaleBox(Box, 0.995)) != EBoxTestResult::NoIntersection;
+    const bool bGrown = TestBox(Region, Planes, ScaleBox(Box, 1.005)) != EBoxTestResult::NoIntersection;
+    if (bShrunk != bOverlaps || bGrown != bOverlaps) {
+      continue;
+    }
+    const TRegion<FVec3f> RegionFloat = Convert<float>(Region);
+    const bool bOverlapsFloat = TestBox(RegionFloat, ComputeRegionPlanes(RegionFloat), Convert<float>(Box)) !=
+                                EBoxTestResult::NoIntersection;
+    if (bOverlapsFloat != bOverlaps) {
+      AddError(FString::Printf(TEXT("Box %d: float says %d, double says %d"), i, static_cast<int32>(bOverlapsFloat),
+                               static_cast<int32>(bOverlaps)));
+    }
+    ++NumChecked;
+  }
+  TestTrue(TEXT("Most perspective boxes are far enough from the boundary to check"), NumChecked > 4500);
+
+  NumChecked = 0;
+  for (int32 i = 0; i < 5000; ++i) {
+    const TOrthoRegion<FVec3d> Region{FVec3d{Random.FRandRange(-5000, 5000), Random.FRandRange(-5000, 5000), 0},
+                                      FVec3d{0, 1, 0}, FVec3d{0, 0, 1}, Random.FRandRange(20, 400),
+                                      Random.FRandRange(20, 400)};
+    const TOrientedBox<FVec3d> Box = RandomBox(Random, Region.Center, 600);
+    const EOverlap Class = ClassifyOrthoBox(Region, Box);
+    if (ClassifyOrthoBox(Region, ScaleBox(Box, 0.995)) != Class ||
+        ClassifyOrthoBox(Region, ScaleBox(Box, 1.005)) != Class) {
+      continue;
+    }
+    const EOverlap ClassFloat = ClassifyOrthoBox(Convert<float>(Region), Convert<float>(Box));
+    if (ClassFloat != Class) {
+      AddError(FString::Printf(TEXT("Ortho box %d: float says %d, double says %d"), i, static_cast<int32>(ClassFloat),
+                               static_cast<int32>(Class)));
+    }
+    ++NumChecked;
+  }
+  TestTrue(TEXT("Most orthographic boxes are far enough from the boundary to check"), NumChecked > 4500);
+  return true;
+}
+
+#endif  // WITH_DEV_AUTOMATION_TESTS
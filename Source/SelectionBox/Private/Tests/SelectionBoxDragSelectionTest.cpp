@@ -0,0 +1,75 @@
+// Copyright 2021 Gareth Cross.
+#include "Misc/AutomationTest.h"
+#include "SelectionBoxDragSelection.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSelectionBoxDragSelectionTest, "SelectionBox.DragSelection.FollowsDrag",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext |
+                                     EAutomationTestFlags::EngineFilter)
+
+bool FSelectionBoxDragSelectionTest::RunTest(const FString& Parameters) {
+  // A field of boxes on the ground, seen from above at an angle, as in the benchmark commandlet.
+  FRandomStream Random{7};
+  FSelectionBoxBatchData Boxes;
+  for (int32 i = 0; i < 4000; ++i) {
+    const FVector Location{Random.FRandRange(-8000, 8000), Random.FRandRange(-8000, 8000), 0};
+    const FVector Extent{Random.FRandRange(30, 150), Random.FRandRange(30, 150), Random.FRandRange(30, 150)};
+    Boxes.Add(FTransform{FRotator{0, Random.FRandRange(-180, 180), 0}, Location}, FVector{0, 0, Extent.Z}, Extent);
+  }
+
+  const FIntRect ViewRect{0, 0, 1920, 1080};
+  const FVector CameraLocation{-6000, 0, 6000};
+  const FMatrix ViewMatrix = FTranslationMatrix{-CameraLocation} * FInverseRotationMatrix{FRotator{-45, 0, 0}} *
+                             FMatrix{FPlane{0, 0, 1, 0}, FPlane{1, 0, 0, 0}, FPlane{0, 1, 0, 0}, FPlane{0, 0, 0, 1}};
+  const FMatrix ProjectionMatrix = FReversedZPerspectiveMatrix{FMath::DegreesToRadians(90.0f) / 2,
+                                                               static_cast<float>(ViewRect.Width()),
+                                                               static_cast<float>(ViewRect.Height()), 10.0f};
+  const FMatrix ViewProjectionMatrix = ViewMatrix * ProjectionMatrix;
+
+  // Drag away from the middle of the screen towards each corner in turn, so that every edge of the selection box
+  // gets to move.
+  const FVector2D Anchor{960, 540};
+  const FVector2D Directions[] = {{1, 1}, {1, -1}, {-1, -1}, {-1, 1}};
+  constexpr int32 NumSteps = 50;
+  constexpr double StepPixels = 8;
+
+  FSelectionBoxDragSelection Drag;
+  TBitArray<> Expected;
+  for (const FVector2D& Direction : Directions) {
+    Drag.Reset(Boxes);
+    int32 TotalTested = 0;
+    for (int32 Step = 1; Step <= NumSteps; ++Step) {
+      FSelectionRegion Region;
+      USelectionBoxFunctionLibrary::CreateSelectionRegionFromViewProjection(
+          ViewProjectionMatrix, ViewRect, Anchor, Anchor + Direction * (Step * StepPixels), Region);
+      if (!TestTrue(TEXT("Camera origin is the eye"), Region.CameraOrigin.Equals(CameraLocation, 0.1))) {
+        return false;
+      }
+      Drag.Update(Region);
+
+      const FRegionPlanes Planes = Region.ComputePlanes();
+      USelectionBoxFunctionLibrary::SelectionRegionOverlapsTransformedBoxBatch(Region, Planes, Boxes.GetView(),
+                                                                               Expected);
+      if (!TestTrue(FString::Printf(TEXT("Selection matches a full query (direction %s, step %d)"),
+                                    *Direction.ToString(), Step),
+                    Drag.GetSelection() == Expected)) {
+        return false;
+      }
+
+      // Only the first update of a drag should test everything. After that, only boxes near the moving edges
+      // are due.
+      if (Step > 1) {
+        TestTrue(FString::Printf(TEXT("Few boxes tested (direction %s, step %d: %d)"), *Direction.ToString(), Step,
+                                 Drag.GetNumTestedLastUpdate()),
+                 Drag.GetNumTestedLastUpdate() < Boxes.Num() / 4);
+        TotalTested += Drag.GetNumTestedLastUpdate();
+      }
+    }
+    AddInfo(FString::Printf(TEXT("Direction %s: %.1f boxes tested per update"), *Direction.ToString(),
+                            static_cast<double>(TotalTested) / (NumSteps - 1)));
+  }
+  return true;
+}
+
+#endif  // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,209 @@
+// Copyright 2021 Gareth Cross.
+#include "Components/BoxComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Misc/AutomationTest.h"
+#include "SelectionBoxFunctionLibrary.h"
+#include "Serialization/BitReader.h"
+#include "Serialization/BitWriter.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace {
+
+constexpr auto TestFlags = EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext |
+                           EAutomationTestFlags::ServerContext | EAutomationTestFlags::EngineFilter;
+
+// Camera and region of the drag selection test, with every optional field filled in.
+FSelectionRegion MakePerspectiveRegion() {
+  const FIntRect ViewRect{0, 0, 1920, 1080};
+  const FRotator CameraRotation{-45, 0, 0};
+  const FMatrix ViewMatrix = FTranslationMatrix{-FVector{-6000, 0, 6000}} * FInverseRotationMatrix{CameraRotation} *
+                             FMatrix{FPlane{0, 0, 1, 0}, FPlane{1, 0, 0, 0}, FPlane{0, 1, 0, 0}, FPlane{0, 0, 0, 1}};
+  const FMatrix ProjectionMatrix = FReversedZPerspectiveMatrix{FMath::DegreesToRadians(90.0f) / 2,
+                                                               static_cast<float>(ViewRect.Width()),
+                                                               static_cast<float>(ViewRect.Height()), 10.0f};
+  FSelectionRegion Region;
+  USelectionBoxFunctionLibrary::CreateSelectionRegionFromViewProjection(
+      ViewMatrix * ProjectionMatrix, ViewRect, FVector2D{700, 300}, FVector2D{1200, 800}, Region);
+  Region.NearDistance = 50;
+  Region.FarDistance = 12000;
+  Region.ViewDirection = CameraRotation.Vector();
+  Region.ExtraPlanes = {FPlane{0, 0, -1, 0}, FPlane{1, 0, 0, 5000}};
+  return Region;
+}
+
+FSelectionRegion MakeOrthographicRegion() {
+  FSelectionRegion Region;
+  Region.bOrthographic = true;
+  Region.CameraOrigin = FVector{100, 200, 300};
+  Region.ViewDirection = FVector{1, 0, 0};
+  Region.OrthoRightExtent = FVector{0, 250, 0};
+  Region.OrthoUpExtent = FVector{0, 0, 120};
+  Region.NearDistance = 10;
+  return Region;
+}
+
+// Send `Region` through NetSerialize, as an RPC would, keeping only the first `NumBits` bits if not negative.
+bool SendRegion(FSelectionRegion Region, FSelectionRegion& Received, const int64 NumBits = -1) {
+  FBitWriter Writer{0, /*bAllowResize=*/true};
+  bool bSuccess = false;
+  Region.NetSerialize(Writer, nullptr, bSuccess);
+  FBitReader Reader{Writer.GetData(), NumBits < 0 ? Writer.GetNumBits() : FMath::Min(NumBits, Writer.GetNumBits())};
+  Received.NetSerialize(Reader, nullptr, bSuccess);
+  return bSuccess;
+}
+
+int64 NumBitsSent(FSelectionRegion Region) {
+  FBitWriter Writer{0, /*bAllowResize=*/true};
+  bool bSuccess = false;
+  Region.NetSerialize(Writer, nullptr, bSuccess);
+  return Writer.GetNumBits();
+}
+
+bool AreIdentical(const FSelectionRegion& A, const FSelectionRegion& B) {
+  return A.CameraOrigin == B.CameraOrigin && A.TopLeftRay == B.TopLeftRay && A.TopRightRay == B.TopRightRay &&
+         A.BottomLeftRay == B.BottomLeftRay && A.BottomRightRay == B.BottomRightRay &&
+         A.bOrthographic == B.bOrthographic && A.OrthoRightExtent == B.OrthoRightExtent &&
+         A.OrthoUpExtent == B.OrthoUpExtent && A.bHasViewProjection == B.bHasViewProjection &&
+         A.ViewProjectionMatrix == B.ViewProjectionMatrix && A.ScreenMin == B.ScreenMin &&
+         A.ScreenMax == B.ScreenMax && A.NearDistance == B.NearDistance && A.FarDistance == B.FarDistance &&
+         A.ViewDirection == B.ViewDirection && A.ExtraPlanes == B.ExtraPlanes;
+}
+
+// An actor whose only component is a registered box of half-size `Extent`.
+AActor* SpawnBoxActor(UWorld& World, const FVector& Location, const FVector& Extent) {
+  AActor* const Actor = World.SpawnActor<AActor>();
+  UBoxComponent* const Box = NewObject<UBoxComponent>(Actor);
+  Box->SetBoxExtent(Extent);
+  Actor->SetRootComponent(Box);
+  Box->RegisterComponent();
+  Actor->SetActorLocation(Location);
+  return Actor;
+}
+
+}  // namespace
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSelectionBoxNetRoundTripTest, "SelectionBox.Net.RoundTrip", TestFlags)
+
+bool FSelectionBoxNetRoundTripTest::RunTest(const FString& Parameters) {
+  const FSelectionRegion Perspective = MakePerspectiveRegion();
+  FSelectionRegion Received;
+  TestTrue(TEXT("Perspective region is sent"), SendRegion(Perspective, Received));
+  TestFalse(TEXT("Orthographic flag"), Received.bOrthographic);
+  TestTrue(TEXT("View-projection flag"), Received.bHasViewProjection);
+  TestTrue(TEXT("Camera origin"), Received.CameraOrigin.Equals(Perspective.CameraOrigin, 0.051));
+  TestTrue(TEXT("Top left ray"), Received.TopLeftRay.Equals(Perspective.TopLeftRay, 1.0e-4));
+  TestTrue(TEXT("Top right ray"), Received.TopRightRay.Equals(Perspective.TopRightRay, 1.0e-4));
+  TestTrue(TEXT("Bottom left ray"), Received.BottomLeftRay.Equals(Perspective.BottomLeftRay, 1.0e-4));
+  TestTrue(TEXT("Bottom right ray"), Received.BottomRightRay.Equals(Perspective.BottomRightRay, 1.0e-4));
+  TestTrue(TEXT("Screen min"), Received.ScreenMin.Equals(Perspective.ScreenMin, 1.0e-6));
+  TestTrue(TEXT("Screen max"), Received.ScreenMax.Equals(Perspective.ScreenMax, 1.0e-6));
+  TestEqual(TEXT("Near distance"), Received.NearDistance, Perspective.NearDistance);
+  TestEqual(TEXT("Far distance"), Received.FarDistance, Perspective.FarDistance);
+  TestTrue(TEXT("View direction"), Received.ViewDirection.Equals(Perspective.ViewDirection, 1.0e-4));
+  TestTrue(TEXT("Extra planes"), Received.ExtraPlanes == Perspective.ExtraPlanes);
+
+  const FSelectionRegion Orthographic = MakeOrthographicRegion();
+  TestTrue(TEXT("Orthographic region is sent"), SendRegion(Orthographic, Received));
+  TestTrue(TEXT("Orthographic flag"), Received.bOrthographic);
+  TestFalse(TEXT("No view-projection"), Received.bHasViewProjection);
+  TestTrue(TEXT("Ortho right extent"), Received.OrthoRightExtent.Equals(Orthographic.OrthoRightExtent, 0.051));
+  TestTrue(TEXT("Ortho up extent"), Received.OrthoUpExtent.Equals(Orthographic.OrthoUpExtent, 0.051));
+  TestEqual(TEXT("Orthographic near distance"), Received.NearDistance, Orthographic.NearDistance);
+  TestEqual(TEXT("Orthographic far distance"), Received.FarDistance, 0.0f);
+  TestEqual(TEXT("No extra planes"), Received.ExtraPlanes.Num(), 0);
+
+  // Whatever is cut off, reading past the end of the stream fails.
+  for (const FSelectionRegion* Region : {&Perspective, &Orthographic}) {
+    const int64 NumBits = NumBitsSent(*Region);
+    for (const int64 Kept : {int64{0}, int64{8}, NumBits / 2, NumBits - 1}) {
+      TestFalse(FString::Printf(TEXT("Stream of %lld bits cut to %lld fails"), NumBits, Kept),
+                SendRegion(*Region, Received, Kept));
+    }
+  }
+  return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSelectionBoxNetQuantizeTest, "SelectionBox.Net.QuantizeIsIdempotent", TestFlags)
+
+bool FSelectionBoxNetQuantizeTest::RunTest(const FString& Parameters) {
+  TArray<FSelectionRegion> Regions = {MakePerspectiveRegion(), MakeOrthographicRegion()};
+  FRandomStream Random{17};
+  for (int32 i = 0; i < 2000; ++i) {
+    FSelectionRegion& Region = Regions.Add_GetRef(MakePerspectiveRegion());
+    Region.CameraOrigin = FVector{Random.FRandRange(-5.0e5, 5.0e5), Random.FRandRange(-5.0e5, 5.0e5),
+                                  Random.FRandRange(-1.0e4, 1.0e4)};
+    for (FVector* const Ray : {&Region.TopLeftRay, &Region.TopRightRay, &Region.BottomLeftRay, &Region.BottomRightRay,
+                               &Region.ViewDirection}) {
+      *Ray = Random.GetUnitVector();
+    }
+    Region.ExtraPlanes[1] = FPlane{Random.GetUnitVector(), Random.FRandRange(-1.0e4, 1.0e4)};
+  }
+
+  for (int32 i = 0; i < Regions.Num(); ++i) {
+    FSelectionRegion Once = Regions[i];
+    Once.QuantizeForNetwork();
+    FSelectionRegion Twice = Once;
+    Twice.QuantizeForNetwork();
+    if (!AreIdentical(Once, Twice)) {
+      AddError(FString::Printf(TEXT("Region %d changed when quantized again"), i));
+    }
+    // And the quantized region is exactly what the server receives.
+    FSelectionRegion Received;
+    SendRegion(Once, Received);
+    if (!AreIdentical(Once, Received)) {
+      AddError(FString::Printf(TEXT("Region %d is not received as quantized"), i));
+    }
+  }
+  return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSelectionBoxNetValidateTest, "SelectionBox.Net.ValidateSelectedActors", TestFlags)
+
+bool FSelectionBoxNetValidateTest::RunTest(const FString& Parameters) {
+  UWorld* const World = UWorld::CreateWorld(EWorldType::Game, /*bInformEngineOfWorld=*/false);
+  FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+  WorldContext.SetCurrentWorld(World);
+
+  // A grid of boxes around the point the camera looks at.
+  TArray<AActor*> Actors;
+  for (int32 X = -5; X <= 5; ++X) {
+    for (int32 Y = -5; Y <= 5; ++Y) {
+      Actors.Add(SpawnBoxActor(*World, FVector{X * 600.0, Y * 600.0, 50}, FVector{50, 50, 50}));
+    }
+  }
+
+  // The client queries with the quantized region, and sends it along with what it selected.
+  FSelectionRegion Region = MakePerspectiveRegion();
+  Region.QuantizeForNetwork();
+  TArray<AActor*> Selected;
+  USelectionBoxFunctionLibrary::SelectionRegionOverlapsActors(Region, Actors, /*bIncludeFromNonColliding=*/true,
+                                                              /*bIncludeChildActors=*/false, {}, Selected);
+  TestTrue(TEXT("Some actors are selected"), Selected.Num() > 0);
+  TestTrue(TEXT("Some actors are not selected"), Selected.Num() < Actors.Num());
+
+  FSelectionRegion Received;
+  TestTrue(TEXT("Region is sent"), SendRegion(Region, Received));
+  TArray<AActor*> Rejected;
+  TestTrue(TEXT("Server accepts the client's selection"),
+           USelectionBoxFunctionLibrary::ValidateSelectedActors(Received, Selected, true, false, 0, Rejected));
+  TestEqual(TEXT("Nothing is rejected"), Rejected.Num(), 0);
+
+  // Claiming an actor outside the region gets exactly that actor rejected.
+  AActor* const* const Outside =
+      Actors.FindByPredicate([&](const AActor* const Actor) { return !Selected.Contains(Actor); });
+  if (TestNotNull(TEXT("An actor is outside the region"), Outside)) {
+    TArray<AActor*> Claimed = Selected;
+    Claimed.Add(*Outside);
+    TestFalse(TEXT("Server rejects an actor outside the region"),
+              USelectionBoxFunctionLibrary::ValidateSelectedActors(Received, Claimed, true, false, 0, Rejected));
+    TestTrue(TEXT("Only that actor is rejected"), Rejected.Num() == 1 && Rejected[0] == *Outside);
+  }
+
+  GEngine->DestroyWorldContext(World);
+  World->DestroyWorld(/*bInformEngineOfWorld=*/false);
+  return true;
+}
+
+#endif  // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,48 @@
+// Copyright 2021 Gareth Cross.
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "SelectionBoxFunctionLibrary.h"
+#include "SelectionBoxAsyncQuery.generated.h"
+
+class USelectionBoxSubsystem;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FSelectionBoxAsyncQueryCompleted, const TArray<AActor*>&, Actors,
+                                             const TArray<USceneComponent*>&, Components);
+
+/**
+ * Latent Blueprint nodes for the async queries of USelectionBoxSubsystem. Execution carries on from the node right
+ * away, and "On Completed" fires on the game thread once the results are ready, normally on the next frame.
+ */
+UCLASS()
+class SELECTIONBOX_API USelectionBoxAsyncQuery : public UBlueprintAsyncActionBase {
+  GENERATED_BODY()
+public:
+  // Find all actors registered with the selection box subsystem that overlap the region. Components is empty.
+  UFUNCTION(BlueprintCallable,
+            meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject",
+                    DisplayName = "Query Selection Box Actors Async"))
+  static USelectionBoxAsyncQuery* QueryActorsAsync(UObject* WorldContextObject, const FSelectionRegion& Region);
+
+  // Find all components registered with the selection box subsystem that overlap the region. Actors is empty.
+  UFUNCTION(BlueprintCallable,
+            meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject",
+                    DisplayName = "Query Selection Box Components Async"))
+  static USelectionBoxAsyncQuery* QueryComponentsAsync(UObject* WorldContextObject, const FSelectionRegion& Region);
+
+  UPROPERTY(BlueprintAssignable)
+  FSelectionBoxAsyncQueryCompleted OnCompleted;
+
+  // UBlueprintAsyncActionBase implementation
+  virtual void Activate() override;
+
+private:
+  static USelectionBoxAsyncQuery* Create(UObject* WorldContextObject, const FSelectionRegion& Region, bool bActors);
+
+  void Complete(const TArray<AActor*>& Actors, const TArray<USceneComponent*>& Components);
+
+  TWeakObjectPtr<USelectionBoxSubsystem> Subsystem;
+  FSelectionRegion Region;
+  bool bActors{true};
+};
@@ -0,0 +1,613 @@
+// Copyright 2021 Gareth Cross.
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+/**
+ * The geometry behind the selection tests, with no dependency on the engine.
+ *
+ * Everything is templated on the vector type, which only needs public `X`, `Y` and `Z` members and a constructor
+ * taking the three components. The scalar type is deduced from `X`. In the engine that means FVector (double) for
+ * accuracy, or FVector3f for tight loops over data that is already local to the camera. Outside of it, TVector3
+ * can be used, so the math can be unit tested and benchmarked without an editor. The automation tests in
+ * Private/Tests/SelectionBoxCoreTest.cpp only use TVector3.
+ *
+ * USelectionBoxFunctionLibrary is a thin adapter over these functions.
+ */
+#if defined(FORCEINLINE)
+#define SELECTIONBOX_CORE_INLINE FORCEINLINE
+#elif defined(_MSC_VER)
+#define SELECTIONBOX_CORE_INLINE __forceinline
+#else
+#define SELECTIONBOX_CORE_INLINE inline __attribute__((always_inline))
+#endif
+
+namespace SelectionBox {
+
+// Minimal vector type, for use of the core outside of the engine.
+template <typename T>
+struct TVector3 {
+  T X;
+  T Y;
+  T Z;
+
+  constexpr TVector3() : X(0), Y(0), Z(0) {}
+  constexpr TVector3(T InX, T InY, T InZ) : X(InX), Y(InY), Z(InZ) {}
+};
+
+// Scalar type of a vector type.
+template <typename VectorType>
+using TScalarOf = std::decay_t<decltype(std::declval<VectorType>().X)>;
+
+// Multipliers we apply to the box extent to get the corner points.
+inline constexpr float PointMultipliers[8][3] = {
+    {1, 1, 1},
+    {1, 1, -1},
+    {1, -1, -1},
+    {1, -1, 1},
+    {-1, 1, 1},
+    {-1, 1, -1},
+    {-1, -1, -1},
+    {-1, -1, 1},
+};
+
+struct IntPair {
+  int i;
+  int j;
+};
+
+// Defines the 12 unique edges of a box, given the offsets in PointMultipliers.
+inline constexpr IntPair BoxEdges[12] = {
+    {0, 1},
+    {0, 3},
+    {0, 4},
+    {1, 2},
+    {1, 5},
+    {2, 3},
+    {2, 6},
+    {3, 7},
+    {4, 5},
+    {4, 7},
+    {5, 6},
+    {6, 7},
+};
+
+// Bit assigned to each plane in the Cohen-Sutherland outcodes.
+enum EOutcodeBits : uint8_t {
+  OutcodeTop = 1,
+  OutcodeBottom = 2,
+  OutcodeRight = 4,
+  OutcodeLeft = 8,
+};
+
+// Same values as ESelectionOverlap. Ordered so that the classification against several planes is the minimum of the
+// classifications against each of them.
+enum class EOverlap : uint8_t {
+  Outside = 0,
+  Intersecting,
+  Inside,
+};
+
+// Same values as ETransformedBoxTestResult.
+enum class EBoxTestResult : uint8_t {
+  NoIntersection = 0,
+  BoxCornerInsideRegion,
+  SelectionCornerIntersectsBox,
+  BoxIntersectsPlane,
+  Overlaps,
+};
+
+namespace Vec {
+
+template <typename V>
+SELECTIONBOX_CORE_INLINE V Add(const V& A, const V& B) {
+  return V(A.X + B.X, A.Y + B.Y, A.Z + B.Z);
+}
+
+template <typename V>
+SELECTIONBOX_CORE_INLINE V Sub(const V& A, const V& B) {
+  return V(A.X - B.X, A.Y - B.Y, A.Z - B.Z);
+}
+
+template <typename V>
+SELECTIONBOX_CORE_INLINE V Scale(const V& A, const TScalarOf<V> S) {
+  return V(A.X * S, A.Y * S, A.Z * S);
+}
+
+template <typename V>
+SELECTIONBOX_CORE_INLINE TScalarOf<V> Dot(const V& A, const V& B) {
+  return A.X * B.X + A.Y * B.Y + A.Z * B.Z;
+}
+
+template <typename V>
+SELECTIONBOX_CORE_INLINE V Cross(const V& A, const V& B) {
+  return V(A.Y * B.Z - A.Z * B.Y, A.Z * B.X - A.X * B.Z, A.X * B.Y - A.Y * B.X);
+}
+
+// Unit vector in the direction of `A`, or zero if `A` is too short to normalize (like FVector::GetSafeNormal).
+template <typename V>
+SELECTIONBOX_CORE_INLINE V SafeNormal(const V& A) {
+  using T = TScalarOf<V>;
+  const T SquaredSize = Dot(A, A);
+  if (SquaredSize < static_cast<T>(1.0e-8)) {
+    return V(0, 0, 0);
+  }
+  return Scale(A, static_cast<T>(1) / std::sqrt(SquaredSize));
+}
+
+}  // namespace Vec
+
+// A plane with unit normal `Normal`, containing the points `P` where `Normal . P == W`. Same convention as FPlane.
+template <typename V>
+struct TPlane {
+  V Normal;
+  TScalarOf<V> W;
+
+  // Signed distance of `Pt` from the plane, positive on the side the normal points to.
+  SELECTIONBOX_CORE_INLINE TScalarOf<V> PlaneDot(const V& Pt) const { return Vec::Dot(Normal, Pt) - W; }
+
+  // Plane through `Point` with normal `InNormal`.
+  static SELECTIONBOX_CORE_INLINE TPlane FromPointAndNormal(const V& Point, const V& InNormal) {
+    return TPlane{InNormal, Vec::Dot(InNormal, Point)};
+  }
+};
+
+// The four planes bounding a selection region. The normals point out of the region.
+template <typename V>
+struct TRegionPlanes {
+  TPlane<V> Left;
+  TPlane<V> Right;
+  TPlane<V> Top;
+  TPlane<V> Bottom;
+};
+
+// Camera origin and corner rays of a selection region (see FSelectionRegion).
+template <typename V>
+struct TRegion {
+  V CameraOrigin;
+  V TopLeftRay;
+  V TopRightRay;
+  V BottomRightRay;
+  V BottomLeftRay;
+};
+
+// An oriented box: `Center + a * Axes[0] + b * Axes[1] + c * Axes[2]` for a, b, c in [-1, 1]. Each axis is the
+// unit axis of the box scaled by the matching half-extent.
+template <typename V>
+struct TOrientedBox {
+  V Center;
+  V Axes[3];
+};
+
+template <typename V>
+SELECTIONBOX_CORE_INLINE TRegionPlanes<V> ComputeRegionPlanes(const TRegion<V>& Region) {
+  const V& O = Region.CameraOrigin;
+  TRegionPlanes<V> Result;
+  Result.Left =
+      TPlane<V>::FromPointAndNormal(O, Vec::SafeNormal(Vec::Cross(Region.BottomLeftRay, Region.TopLeftRay)));
+  Result.Right =
+      TPlane<V>::FromPointAndNormal(O, Vec::SafeNormal(Vec::Cross(Region.TopRightRay, Region.BottomRightRay)));
+  Result.Top = TPlane<V>::FromPointAndNormal(O, Vec::SafeNormal(Vec::Cross(Region.TopLeftRay, Region.TopRightRay)));
+  Result.Bottom =
+      TPlane<V>::FromPointAndNormal(O, Vec::SafeNormal(Vec::Cross(Region.BottomRightRay, Region.BottomLeftRay)));
+  return Result;
+}
+
+// An orthographic selection region: the points `Center + a * Right + b * Up + t * Forward`, for |a| <= HalfWidth,
+// |b| <= HalfHeight and any t. `Right` and `Up` are orthogonal unit vectors, and `Forward` is implied by them.
+template <typename V>
+struct TOrthoRegion {
+  V Center;
+  V Right;
+  V Up;
+  TScalarOf<V> HalfWidth;
+  TScalarOf<V> HalfHeight;
+};
+
+// The side planes of an orthographic region come in parallel pairs, with the normals pointing out.
+template <typename V>
+SELECTIONBOX_CORE_INLINE TRegionPlanes<V> ComputeOrthoRegionPlanes(const TOrthoRegion<V>& Region) {
+  using T = TScalarOf<V>;
+  const V HalfRight = Vec::Scale(Region.Right, Region.HalfWidth);
+  const V HalfUp = Vec::Scale(Region.Up, Region.HalfHeight);
+  TRegionPlanes<V> Result;
+  Result.Left =
+      TPlane<V>::FromPointAndNormal(Vec::Sub(Region.Center, HalfRight), Vec::Scale(Region.Right, static_cast<T>(-1)));
+  Result.Right = TPlane<V>::FromPointAndNormal(Vec::Add(Region.Center, HalfRight), Region.Right);
+  Result.Top = TPlane<V>::FromPointAndNormal(Vec::Add(Region.Center, HalfUp), Region.Up);
+  Result.Bottom =
+      TPlane<V>::FromPointAndNormal(Vec::Sub(Region.Center, HalfUp), Vec::Scale(Region.Up, static_cast<T>(-1)));
+  return Result;
+}
+
+// True if the sphere is not entirely outside any of the planes. This is conservative: it can return true for
+// spheres near the corners of the region that do not actually overlap it.
+template <typename V>
+SELECTIONBOX_CORE_INLINE bool SphereOverlapsRegion(const TRegionPlanes<V>& Planes, const V& Center,
+                                                   const TScalarOf<V> Radius) {
+  return Planes.Left.PlaneDot(Center) < Radius && Planes.Right.PlaneDot(Center) < Radius &&
+         Planes.Top.PlaneDot(Center) < Radius && Planes.Bottom.PlaneDot(Center) < Radius;
+}
+
+// Classify a volume against a plane, given the signed distance `Distance` of its center from the plane and its
+// half-width `Radius` along the normal. Touching the plane from outside counts as outside, as in
+// SphereOverlapsRegion.
+template <typename T>
+SELECTIONBOX_CORE_INLINE EOverlap ClassifyDistance(const T Distance, const T Radius) {
+  if (Distance >= Radius) {
+    return EOverlap::Outside;
+  }
+  return Distance <= -Radius ? EOverlap::Inside : EOverlap::Intersecting;
+}
+
+// Classify a sphere against the four planes. Inside and Outside are exact, but like SphereOverlapsRegion this returns
+// Intersecting for some spheres near the corners of the region that do not actually overlap it.
+template <typename V>
+SELECTIONBOX_CORE_INLINE EOverlap ClassifySphere(const TRegionPlanes<V>& Planes, const V& Center,
+                                                 const TScalarOf<V> Radius) {
+  return std::min(std::min(ClassifyDistance(Planes.Left.PlaneDot(Center), Radius),
+                           ClassifyDistance(Planes.Right.PlaneDot(Center), Radius)),
+                  std::min(ClassifyDistance(Planes.Top.PlaneDot(Center), Radius),
+                           ClassifyDistance(Planes.Bottom.PlaneDot(Center), Radius)));
+}
+
+// Half-width of an axis-aligned box with half-extent `Extent` along `Normal`.
+template <typename V>
+SELECTIONBOX_CORE_INLINE TScalarOf<V> ProjectedRadius(const V& Normal, const V& Extent) {
+  return std::abs(Normal.X) * Extent.X + std::abs(Normal.Y) * Extent.Y + std::abs(Normal.Z) * Extent.Z;
+}
+
+// Half-width of an oriented box along `Normal`.
+template <typename V>
+SELECTIONBOX_CORE_INLINE TScalarOf<V> ProjectedRadius(const V& Normal, const V (&Axes)[3]) {
+  return std::abs(Vec::Dot(Normal, Axes[0])) + std::abs(Vec::Dot(Normal, Axes[1])) +
+         std::abs(Vec::Dot(Normal, Axes[2]));
+}
+
+// Classify an axis-aligned box against the four planes. Inside is exact, since the region is the intersection of
+// the half-spaces. Outside is only returned if the box is outside one of the planes, so some boxes that are outside
+// the region (near its corners) are classified as Intersecting.
+template <typename V>
+SELECTIONBOX_CORE_INLINE EOverlap ClassifyAlignedBox(const TRegionPlanes<V>& Planes, const V& Center,
+                                                     const V& Extent) {
+  EOverlap Result = EOverlap::Inside;
+  for (const TPlane<V>* Plane : {&Planes.Left, &Planes.Right, &Planes.Top, &Planes.Bottom}) {
+    Result = std::min(Result, ClassifyDistance(Plane->PlaneDot(Center), ProjectedRadius(Plane->Normal, Extent)));
+  }
+  return Result;
+}
+
+// Version of ClassifyAlignedBox for an oriented box.
+template <typename V>
+SELECTIONBOX_CORE_INLINE EOverlap ClassifyOrientedBox(const TRegionPlanes<V>& Planes, const TOrientedBox<V>& Box) {
+  EOverlap Result = EOverlap::Inside;
+  for (const TPlane<V>* Plane : {&Planes.Left, &Planes.Right, &Planes.Top, &Planes.Bottom}) {
+    Result = std::min(Result, ClassifyDistance(Plane->PlaneDot(Box.Center), ProjectedRadius(Plane->Normal, Box.Axes)));
+  }
+  return Result;
+}
+
+/**
+ * Classify an oriented box against an orthographic region. The region is a prism along the view direction, so the
+ * box overlaps it exactly when their projections onto the view plane do: a rectangle, and the hexagon (or
+ * parallelogram) spanned by the three projected box axes. In the view plane, that is a separating axis test with
+ * five axes: the two sides of the rectangle, and the normals of the projected box axes. The result is exact.
+ */
+template <typename V>
+SELECTIONBOX_CORE_INLINE EOverlap ClassifyOrthoBox(const TOrthoRegion<V>& Region, const TOrientedBox<V>& Box) {
+  using T = TScalarOf<V>;
+  // Move the box into view space, dropping the depth.
+  const V FromCenter = Vec::Sub(Box.Center, Region.Center);
+  const T CenterX = Vec::Dot(FromCenter, Region.Right);
+  const T CenterY = Vec::Dot(FromCenter, Region.Up);
+  T AxesX[3];
+  T AxesY[3];
+  T RadiusX = 0;
+  T RadiusY = 0;
+  for (int i = 0; i < 3; ++i) {
+    AxesX[i] = Vec::Dot(Box.Axes[i], Region.Right);
+    AxesY[i] = Vec::Dot(Box.Axes[i], Region.Up);
+    RadiusX += std::abs(AxesX[i]);
+    RadiusY += std::abs(AxesY[i]);
+  }
+
+  // The sides of the rectangle. These are the side planes, so touching one from outside counts as outside.
+  const T GapX = std::abs(CenterX) - Region.HalfWidth;
+  const T GapY = std::abs(CenterY) - Region.HalfHeight;
+  if (GapX >= RadiusX || GapY >= RadiusY) {
+    return EOverlap::Outside;
+  }
+  if (GapX <= -RadiusX && GapY <= -RadiusY) {
+    return EOverlap::Inside;
+  }
+
+  // Normals of the projected box axes. The other two axes contribute to the extent of the box along each one, and
+  // an axis seen end-on projects to a point, and so has no normal to test.
+  for (int i = 0; i < 3; ++i) {
+    const T NormalX = -AxesY[i];
+    const T NormalY = AxesX[i];
+    T BoxRadius = 0;
+    for (int j = 0; j < 3; ++j) {
+      BoxRadius += std::abs(NormalX * AxesX[j] + NormalY * AxesY[j]);
+    }
+    const T RectRadius = std::abs(NormalX) * Region.HalfWidth + std::abs(NormalY) * Region.HalfHeight;
+    if (std::abs(NormalX * CenterX + NormalY * CenterY) > BoxRadius + RectRadius) {
+      return EOverlap::Outside;
+    }
+  }
+  return EOverlap::Intersecting;
+}
+
+// Compute the corners of an oriented box, ordered as in PointMultipliers.
+template <typename V>
+SELECTIONBOX_CORE_INLINE void ComputeCorners(const TOrientedBox<V>& Box, V (&PtsOut)[8]) {
+  using T = TScalarOf<V>;
+  for (int i = 0; i < 8; ++i) {
+    V Pt = Box.Center;
+    for (int Axis = 0; Axis < 3; ++Axis) {
+      Pt = Vec::Add(Pt, Vec::Scale(Box.Axes[Axis], static_cast<T>(PointMultipliers[i][Axis])));
+    }
+    PtsOut[i] = Pt;
+  }
+}
+
+// Returns a 4-bit mask with the EOutcodeBits of every plane the point is strictly outside of.
+template <typename V>
+SELECTIONBOX_CORE_INLINE uint32_t OutsideMask(const TRegionPlanes<V>& Planes, const V& Pt) {
+  return static_cast<uint32_t>(Planes.Top.PlaneDot(Pt) > 0) * OutcodeTop |
+         static_cast<uint32_t>(Planes.Bottom.PlaneDot(Pt) > 0) * OutcodeBottom |
+         static_cast<uint32_t>(Planes.Right.PlaneDot(Pt) > 0) * OutcodeRight |
+         static_cast<uint32_t>(Planes.Left.PlaneDot(Pt) > 0) * OutcodeLeft;
+}
+
+// Convert an outside mask to a Cohen-Sutherland outcode. A point can be outside of both top and bottom (or left
+// and right) when it is behind the camera. In that case top takes precedence over bottom, and left over right.
+SELECTIONBOX_CORE_INLINE uint32_t OutcodeFromMask(const uint32_t Mask) {
+  // Clear bottom if top is set, and right if left is set.
+  return Mask & ~((Mask & OutcodeTop) << 1) & ~((Mask & OutcodeLeft) >> 1);
+}
+
+// Outcodes for the 8 corners of a box.
+struct FCornerOutcodes {
+  uint8_t Codes[8];
+  // Planes that every corner lies outside of. If non-zero, the box is entirely outside the region.
+  uint8_t AllOutside;
+  // Non-zero if at least one corner is inside all four planes.
+  uint8_t AnyInside;
+  // Non-zero if every corner is inside all four planes, in which case the whole box is inside the region.
+  uint8_t AllInside;
+};
+
+/**
+ * Determine which region each corner falls in. This is the Cohen Sutherland Algorithm. The four planes define a
+ * pyramid shape w/ flat sides. This breaks the space in front of the camera into 9 regions: the center, and 8
+ * volumes around the pyramid.
+ */
+template <typename V>
+SELECTIONBOX_CORE_INLINE FCornerOutcodes ClassifyCorners(const TRegionPlanes<V>& Planes, const V (&Pts)[8]) {
+  FCornerOutcodes Result;
+  uint32_t AllOutside = 0xF;
+  uint32_t AnyInside = 0;
+  uint32_t AnyOutside = 0;
+  for (int i = 0; i < 8; ++i) {
+    const uint32_t Mask = OutsideMask(Planes, Pts[i]);
+    AllOutside &= Mask;
+    AnyOutside |= Mask;
+    AnyInside |= static_cast<uint32_t>(Mask == 0);
+    Result.Codes[i] = static_cast<uint8_t>(OutcodeFromMask(Mask));
+  }
+  Result.AllOutside = static_cast<uint8_t>(AllOutside);
+  Result.AnyInside = static_cast<uint8_t>(AnyInside);
+  Result.AllInside = static_cast<uint8_t>(AnyOutside == 0);
+  return Result;
+}
+
+// Intersect the segment `A -> B` with a plane. Returns false if both ends are strictly on the same side, or if the
+// segment lies in the plane (like FMath::SegmentPlaneIntersection, which divides by zero in that case).
+template <typename V>
+SELECTIONBOX_CORE_INLINE bool SegmentPlaneIntersection(const V& A, const V& B, const TPlane<V>& Plane,
+                                                       V& IntersectionOut) {
+  const TScalarOf<V> DistA = Plane.PlaneDot(A);
+  const TScalarOf<V> DistB = Plane.PlaneDot(B);
+  if ((DistA > 0 && DistB > 0) || (DistA < 0 && DistB < 0) || DistA == DistB) {
+    return false;
+  }
+  IntersectionOut = Vec::Add(A, Vec::Scale(Vec::Sub(B, A), DistA / (DistA - DistB)));
+  return true;
+}
+
+/**
+ * Check the box edges for a crossing of one of the planes that lies between the two adjacent planes. `Outcodes`
+ * (from ClassifyCorners) let us skip edges with both ends outside the same plane. `bSkipOutsideEdges` only exists
+ * so that the benchmark commandlet can measure what that skip saves.
+ */
+template <bool bSkipOutsideEdges = true, typename V>
+SELECTIONBOX_CORE_INLINE bool EdgesIntersectRegion(const TRegionPlanes<V>& Planes, const V (&Pts)[8],
+                                                   const FCornerOutcodes& Outcodes) {
+  for (const IntPair& Line : BoxEdges) {
+    if (bSkipOutsideEdges && (Outcodes.Codes[Line.i] & Outcodes.Codes[Line.j]) != 0) {
+      // Cohen-Sutherland: both ends are outside the same plane, so this edge can't possibly intersect.
+      continue;
+    }
+    const V& A = Pts[Line.i];
+    const V& B = Pts[Line.j];
+    V IntersectionPt;
+    // Left and right planes: check that we are within the top/bottom planes (in the middle, horizontally).
+    if (SegmentPlaneIntersection(A, B, Planes.Left, IntersectionPt) && Planes.Top.PlaneDot(IntersectionPt) <= 0 &&
+        Planes.Bottom.PlaneDot(IntersectionPt) <= 0) {
+      return true;
+    }
+    if (SegmentPlaneIntersection(A, B, Planes.Right, IntersectionPt) && Planes.Top.PlaneDot(IntersectionPt) <= 0 &&
+        Planes.Bottom.PlaneDot(IntersectionPt) <= 0) {
+      return true;
+    }
+    // Top and bottom planes: check that we are within the left/right planes (in the middle, vertically).
+    if (SegmentPlaneIntersection(A, B, Planes.Top, IntersectionPt) && Planes.Left.PlaneDot(IntersectionPt) <= 0 &&
+        Planes.Right.PlaneDot(IntersectionPt) <= 0) {
+      return true;
+    }
+    if (SegmentPlaneIntersection(A, B, Planes.Bottom, IntersectionPt) && Planes.Left.PlaneDot(IntersectionPt) <= 0 &&
+        Planes.Right.PlaneDot(IntersectionPt) <= 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Check if the ray `P + t * L` hits the axis-aligned box [Min, Max] for some 0 <= t <= MaxT, with the slab method:
+ * intersect the parameter ranges over which the ray is between each pair of faces. On a hit, `TEntry` is the t at
+ * which the ray enters the box (0 if P is inside it). `L` does not need to be normalized.
+ */
+template <typename V>
+SELECTIONBOX_CORE_INLINE bool RayEntersLocalBox(const V& P, const V& L, const V& Min, const V& Max,
+                                                const TScalarOf<V> MaxT, TScalarOf<V>& TEntry) {
+  using T = TScalarOf<V>;
+  const T Origin[3] = {P.X, P.Y, P.Z};
+  const T Direction[3] = {L.X, L.Y, L.Z};
+  const T Lower[3] = {Min.X, Min.Y, Min.Z};
+  const T Upper[3] = {Max.X, Max.Y, Max.Z};
+  T TMin = 0;
+  T TMax = MaxT;
+  for (int Axis = 0; Axis < 3; ++Axis) {
+    if (std::abs(Direction[Axis]) < static_cast<T>(1.0e-8)) {
+      // Parallel to this pair of faces, so the origin must already be between them.
+      if (Origin[Axis] < Lower[Axis] || Origin[Axis] > Upper[Axis]) {
+        return false;
+      }
+      continue;
+    }
+    const T InvDirection = static_cast<T>(1) / Direction[Axis];
+    const T T0 = (Lower[Axis] - Origin[Axis]) * InvDirection;
+    const T T1 = (Upper[Axis] - Origin[Axis]) * InvDirection;
+    TMin = std::max(TMin, std::min(T0, T1));
+    TMax = std::min(TMax, std::max(T0, T1));
+    if (TMin > TMax) {
+      return false;
+    }
+  }
+  TEntry = TMin;
+  return true;
+}
+
+// Check if the ray `P + t * L` (t >= 0) hits the axis-aligned box [Min, Max]. See RayEntersLocalBox.
+template <typename V>
+SELECTIONBOX_CORE_INLINE bool RayIntersectsLocalBox(const V& P, const V& L, const V& Min, const V& Max) {
+  using T = TScalarOf<V>;
+  T TEntry;
+  return RayEntersLocalBox(P, L, Min, Max, std::numeric_limits<T>::max(), TEntry);
+}
+
+// Version of the above for an oriented box. The ray is expressed in the frame of the box first.
+template <typename V>
+SELECTIONBOX_CORE_INLINE bool RayIntersectsBox(const TOrientedBox<V>& Box, const V& P, const V& L) {
+  using T = TScalarOf<V>;
+  // Project onto the scaled axes, so that the box becomes [-1, 1] on every axis.
+  T LocalP[3];
+  T LocalL[3];
+  const V Offset = Vec::Sub(P, Box.Center);
+  for (int Axis = 0; Axis < 3; ++Axis) {
+    const T SquaredLength = Vec::Dot(Box.Axes[Axis], Box.Axes[Axis]);
+    if (SquaredLength <= 0) {
+      // A flat box has no volume for the ray to pass through.
+      return false;
+    }
+    LocalP[Axis] = Vec::Dot(Offset, Box.Axes[Axis]) / SquaredLength;
+    LocalL[Axis] = Vec::Dot(L, Box.Axes[Axis]) / SquaredLength;
+  }
+  return RayIntersectsLocalBox(V(LocalP[0], LocalP[1], LocalP[2]), V(LocalL[0], LocalL[1], LocalL[2]),
+                               V(-1, -1, -1), V(1, 1, 1));
+}
+
+/**
+ * The full test of an oriented box against a selection region:
+ *
+ *  1. If every corner is outside the same plane, there is no intersection. If any corner is inside, we're done.
+ *  2. If an edge of the box crosses one of the planes within the region, the box intersects a plane.
+ *  3. Otherwise the box either is hit by one of the corner rays of the region, or does not intersect it.
+ *
+ * `bSkipOutsideEdges` is passed on to EdgesIntersectRegion, and does not change the result.
+ */
+template <bool bSkipOutsideEdges = true, typename V>
+SELECTIONBOX_CORE_INLINE EBoxTestResult TestBox(const TRegion<V>& Region, const TRegionPlanes<V>& Planes,
+                                                const TOrientedBox<V>& Box) {
+  V Pts[8];
+  ComputeCorners(Box, Pts);
+  const FCornerOutcodes Outcodes = ClassifyCorners(Planes, Pts);
+  if (Outcodes.AllOutside) {
+    return EBoxTestResult::NoIntersection;
+  }
+  if (Outcodes.AnyInside) {
+    return EBoxTestResult::BoxCornerInsideRegion;
+  }
+  if (EdgesIntersectRegion<bSkipOutsideEdges>(Planes, Pts, Outcodes)) {
+    return EBoxTestResult::BoxIntersectsPlane;
+  }
+  const V& O = Region.CameraOrigin;
+  if (RayIntersectsBox(Box, O, Region.TopLeftRay) || RayIntersectsBox(Box, O, Region.TopRightRay) ||
+      RayIntersectsBox(Box, O, Region.BottomLeftRay) || RayIntersectsBox(Box, O, Region.BottomRightRay)) {
+    return EBoxTestResult::SelectionCornerIntersectsBox;
+  }
+  return EBoxTestResult::NoIntersection;
+}
+
+/**
+ * Octahedral encoding of a unit vector in two 16-bit integers, for sending directions over the network. The
+ * vector is projected onto the octahedron |x| + |y| + |z| = 1, the lower half is folded over the upper half, and
+ * the resulting square is quantized. The angular error is below 1e-4 radians.
+ */
+template <typename V>
+SELECTIONBOX_CORE_INLINE void OctahedralEncode(const V& N, uint16_t& UOut, uint16_t& VOut) {
+  using T = TScalarOf<V>;
+  const T L1 = std::abs(N.X) + std::abs(N.Y) + std::abs(N.Z);
+  T U = 0;
+  T W = 0;
+  if (L1 > 0) {
+    U = N.X / L1;
+    W = N.Y / L1;
+    if (N.Z < 0) {
+      const T FoldedU = (1 - std::abs(W)) * (U >= 0 ? 1 : -1);
+      W = (1 - std::abs(U)) * (W >= 0 ? 1 : -1);
+      U = FoldedU;
+    }
+  }
+  const auto Quantize = [](const T X) {
+    const long Q = std::lround((X + 1) * static_cast<T>(0.5) * static_cast<T>(65535));
+    return static_cast<uint16_t>(std::min(std::max(Q, 0L), 65535L));
+  };
+  UOut = Quantize(U);
+  VOut = Quantize(W);
+  // On the outer edge of the square, (U, W) and (U, -W) (or (-U, W)) decode to the same direction, so a decoded
+  // vector may encode to the mirrored code. Always picking the non-negative one makes encoding a decoded vector
+  // give back the same code.
+  if (UOut == 0 || UOut == 65535) {
+    VOut = std::max<uint16_t>(VOut, 65535 - VOut);
+  }
+  if (VOut == 0 || VOut == 65535) {
+    UOut = std::max<uint16_t>(UOut, 65535 - UOut);
+  }
+}
+
+// Inverse of OctahedralEncode. The result is unit length.
+template <typename V>
+SELECTIONBOX_CORE_INLINE V OctahedralDecode(const uint16_t UIn, const uint16_t VIn) {
+  using T = TScalarOf<V>;
+  T U = static_cast<T>(UIn) * static_cast<T>(2.0 / 65535.0) - 1;
+  T W = static_cast<T>(VIn) * static_cast<T>(2.0 / 65535.0) - 1;
+  const T Z = 1 - std::abs(U) - std::abs(W);
+  if (Z < 0) {
+    const T UnfoldedU = (1 - std::abs(W)) * (U >= 0 ? 1 : -1);
+    W = (1 - std::abs(U)) * (W >= 0 ? 1 : -1);
+    U = UnfoldedU;
+  }
+  const V Result(U, W, Z);
+  return Vec::Scale(Result, static_cast<T>(1) / std::sqrt(Vec::Dot(Result, Result)));
+}
+
+}  // namespace SelectionBox
@@ -0,0 +1,80 @@
+// Copyright 2021 Gareth Cross.
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SelectionBoxFunctionLibrary.h"
+
+/**
+ * Tracks which of a fixed set of boxes fall inside a selection region that is changing a little every frame, as
+ * it does while the player drags out a selection box.
+ *
+ * While the camera stays put, every region shares the same origin and only the plane normals move. Moving a unit
+ * normal by `d` changes the signed distance of a point at range `R` from the origin by at most `d * R`. So after
+ * testing a box we record how far the normals would have to move before its bounding sphere could cross a plane,
+ * and only test it again once the accumulated movement of the normals has caught up with that margin. Boxes
+ * straddling a plane are re-tested every update. The per-frame cost is therefore proportional to the number of
+ * boxes near the edges that moved.
+ *
+ * With an orthographic camera the normals stay put instead, and the planes slide along them as the selection box
+ * changes. The margins are then plain distances, and the movement is how far the planes slid.
+ *
+ * If the camera origin (or for orthographic regions, the view direction) changes, everything is re-classified with
+ * a full query.
+ *
+ * The candidate boxes are copied on Reset() and assumed not to move. Call Reset() again if they do.
+ */
+class SELECTIONBOX_API FSelectionBoxDragSelection {
+public:
+  // Start tracking a new set of candidates. The next Update() runs a full query.
+  void Reset(FSelectionBoxBatchData Candidates);
+
+  // Re-classify the candidates against a new region.
+  void Update(const FSelectionRegion& Region);
+
+  // Bit `i` is set if candidate `i` overlaps the region passed to the last Update().
+  const TBitArray<>& GetSelection() const { return Selection; }
+
+  // Indices of the selected candidates, ascending.
+  void GetSelectedIndices(TArray<int32>& IndicesOut) const;
+
+  const FSelectionBoxBatchData& GetCandidates() const { return Candidates; }
+
+  // Number of candidates that were actually tested by the last Update().
+  int32 GetNumTestedLastUpdate() const { return NumTestedLastUpdate; }
+
+private:
+  // A candidate that needs re-testing once the accumulated plane movement reaches `Threshold`.
+  struct FPending {
+    double Threshold;
+    int32 Index;
+
+    bool operator<(const FPending& Other) const { return Threshold < Other.Threshold; }
+  };
+
+  // Test one candidate, updating its selection bit. Returns how far the normals may move before it could change.
+  double Classify(const FSelectionRegion& Region, const FRegionPlanes& Planes, int32 Index);
+
+  // Run the exact test on one candidate. Returns a margin of 0, so it is tested again at the next update.
+  double ClassifyExact(const FSelectionRegion& Region, const FRegionPlanes& Planes, int32 Index);
+
+  static bool HaveSameClipPlanes(const FRegionPlanes& A, const FRegionPlanes& B);
+
+  void FullUpdate(const FSelectionRegion& Region, const FRegionPlanes& Planes);
+
+  FSelectionBoxBatchData Candidates;
+  TBitArray<> Selection;
+
+  // Min-heap of candidates, ordered by the accumulated plane movement at which they must be re-tested.
+  TArray<FPending> Pending;
+  TArray<FPending> Retest;
+
+  // The region and planes as of the last update.
+  FSelectionRegion LastRegion;
+  FRegionPlanes LastPlanes;
+  bool bHasLastRegion{false};
+
+  // Upper bound on how far any plane normal has moved since the last full update.
+  double AccumulatedMovement{0};
+
+  int32 NumTestedLastUpdate{0};
+};
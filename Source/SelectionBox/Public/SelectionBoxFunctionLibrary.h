@@ -2,6 +2,9 @@
 #pragma once
 #include "SelectionBoxFunctionLibrary.generated.h"
 
+class UInstancedStaticMeshComponent;
+class UPackageMap;
+
 /**
  * Types of intersections that can result from a frustum-box test.
  */
@@ -15,21 +18,84 @@ enum class ETransformedBoxTestResult : uint8 {
   SelectionCornerIntersectsBox UMETA(DisplayName="Selection Corner Intersects Box"),
   // Different types of intersects between box and region-bounding planes:
   BoxIntersectsPlane UMETA(DisplayName="Box Intersects Plane"),
+  // The box overlaps the region, but the test that was used does not say how (see ESelectionQueryMode).
+  Overlaps UMETA(DisplayName="Overlaps"),
+};
+
+/**
+ * Classification of a bounding volume against a selection region.
+ */
+UENUM(BlueprintType)
+enum class ESelectionOverlap : uint8 {
+  // No part of the volume is in the region.
+  Outside = 0 UMETA(DisplayName="Outside"),
+  // The volume straddles the boundary of the region.
+  Intersecting UMETA(DisplayName="Intersecting"),
+  // All of the volume is in the region, so everything it encloses is too.
+  FullyInside UMETA(DisplayName="Fully Inside"),
+};
+
+/**
+ * Strategies for testing boxes against a selection region.
+ */
+UENUM(BlueprintType)
+enum class ESelectionQueryMode : uint8 {
+  // Test boxes against the 4 planes of the region in world space. Works for any region.
+  Frustum = 0 UMETA(DisplayName="Frustum"),
+  // Project box corners to the screen once and test them against the selection rectangle in 2D. Requires a
+  // region with a view-projection matrix (see FSelectionRegion::bHasViewProjection), and falls back to Frustum
+  // otherwise.
+  ScreenSpace UMETA(DisplayName="Screen Space"),
+  // Search for a separating axis between the box and the pyramid formed by the region planes. Does a fixed amount
+  // of work per box, and only reports BoxCornerInsideRegion or Overlaps for boxes that intersect.
+  SeparatingAxis UMETA(DisplayName="Separating Axis"),
+};
+
+/**
+ * Orders in which the capped queries prefer boxes. Every key only depends on the center of the box, so it is known
+ * before the box is tested.
+ */
+UENUM(BlueprintType)
+enum class ESelectionPriority : uint8 {
+  // Smallest angle between the center of the box and the ray through the center of the selection box first.
+  ScreenCenter = 0 UMETA(DisplayName="Screen Center"),
+  // Smallest depth along the view direction first.
+  CameraDepth UMETA(DisplayName="Camera Depth"),
+  // Highest caller-supplied score first.
+  Score UMETA(DisplayName="Score"),
 };
 
 /**
  * Planes computed from FSelectionRegion. These planes define the frustum (only in 4 dimensions, since we
  * omit the near/far planes) in which the selection must fall.
+ *
+ * Optional clip planes (near, far and user planes) may further bound the region. They are used for culling: a box
+ * entirely outside one of them is rejected, and any other box is tested against the four side planes as usual.
  */
 USTRUCT(BlueprintType)
 struct SELECTIONBOX_API FRegionPlanes {
   GENERATED_BODY()
 public:
-  // TODO(gareth): Pack these in FMatrix so we can test all w/ TransformPosition()
+  // The box tests transpose these into SIMD registers (see SelectionBoxKernels.h) to test all four at once.
   FPlane LeftPlane;
   FPlane RightPlane;
   FPlane TopPlane;
   FPlane BottomPlane;
+
+  // Near and far planes, followed by FSelectionRegion::ExtraPlanes. Points with positive PlaneDot are outside.
+  static constexpr int32 MaxClipPlanes = 6;
+  int32 NumClipPlanes{0};
+  FPlane ClipPlanes[MaxClipPlanes];
+
+  bool HasClipPlanes() const { return NumClipPlanes > 0; }
+
+  // Send the plane normals in octahedral form (see SelectionBox::OctahedralEncode), and the distances as doubles.
+  bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess);
+};
+
+template <>
+struct TStructOpsTypeTraits<FRegionPlanes> : public TStructOpsTypeTraitsBase2<FRegionPlanes> {
+  enum { WithNetSerializer = true };
 };
 
 /**
@@ -38,6 +104,9 @@ public:
  *
  * Together, these specify 4 planes which can be used to test whether bounding boxes fall inside the
  * selection region.
+ *
+ * With an orthographic camera the corner rays are parallel, and each starts from a different point, so the region
+ * is a rectangular prism instead (see bOrthographic). Every query supports both.
  */
 USTRUCT(BlueprintType)
 struct SELECTIONBOX_API FSelectionRegion {
@@ -63,8 +132,154 @@ public:
   UPROPERTY(BlueprintReadWrite)
   FVector BottomRightRay{FVector::ZeroVector};
 
+  // True for a region made with an orthographic camera. CameraOrigin is then the center of the selection box on
+  // the view plane, ViewDirection must be set, and the region is the prism swept by the selection box along
+  // ViewDirection (in both directions: use NearDistance to drop what is behind the camera). The corner rays are
+  // not used.
+  UPROPERTY(BlueprintReadWrite)
+  bool bOrthographic{false};
+
+  // For orthographic regions: vector from CameraOrigin to the middle of the right edge of the selection box.
+  UPROPERTY(BlueprintReadWrite)
+  FVector OrthoRightExtent{FVector::ZeroVector};
+
+  // For orthographic regions: vector from CameraOrigin to the middle of the top edge of the selection box. Must
+  // be orthogonal to OrthoRightExtent and ViewDirection.
+  UPROPERTY(BlueprintReadWrite)
+  FVector OrthoUpExtent{FVector::ZeroVector};
+
+  // True if the fields below were filled in, which enables ESelectionQueryMode::ScreenSpace.
+  UPROPERTY(BlueprintReadWrite)
+  bool bHasViewProjection{false};
+
+  // View-projection matrix of the camera when the selection box was defined.
+  UPROPERTY(BlueprintReadWrite)
+  FMatrix ViewProjectionMatrix{FMatrix::Identity};
+
+  // Lower-left corner of the selection box in normalized device coordinates (X right, Y up, both in [-1, 1]).
+  UPROPERTY(BlueprintReadWrite)
+  FVector2D ScreenMin{FVector2D::ZeroVector};
+
+  // Upper-right corner of the selection box in normalized device coordinates.
+  UPROPERTY(BlueprintReadWrite)
+  FVector2D ScreenMax{FVector2D::ZeroVector};
+
+  // If positive, boxes entirely closer to the camera than this (along ViewDirection) are not selected.
+  UPROPERTY(BlueprintReadWrite)
+  float NearDistance{0};
+
+  // If positive, boxes entirely further from the camera than this (along ViewDirection) are not selected.
+  UPROPERTY(BlueprintReadWrite)
+  float FarDistance{0};
+
+  // Unit forward vector of the camera, for NearDistance and FarDistance. If zero, the average of the corner rays
+  // is used instead.
+  UPROPERTY(BlueprintReadWrite)
+  FVector ViewDirection{FVector::ZeroVector};
+
+  // Additional planes that bound the region, for example to ignore anything below the ground. Points with a
+  // positive PlaneDot are outside. At most MaxExtraPlanes are used.
+  UPROPERTY(BlueprintReadWrite)
+  TArray<FPlane> ExtraPlanes;
+
+  static constexpr int32 MaxExtraPlanes = FRegionPlanes::MaxClipPlanes - 2;
+
   // Compute the bounding planes from the rays.
   FRegionPlanes ComputePlanes() const;
+
+  /**
+   * Compact encoding for RPCs, for example to have the server re-run a selection made by a client. The camera
+   * origin (and orthographic extents) are quantized to 0.1 units, and the rays and view direction are sent in
+   * octahedral form (32 bits each), so a plain region takes under 30 bytes instead of 120. The view-projection
+   * matrix is sent in single precision if present, and the extra planes in full.
+   */
+  bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess);
+
+  /**
+   * Round the region the same way as NetSerialize. A client that sends its region to the server should query with
+   * the quantized region too, so that both sides test the same region.
+   */
+  void QuantizeForNetwork();
+};
+
+template <>
+struct TStructOpsTypeTraits<FSelectionRegion> : public TStructOpsTypeTraitsBase2<FSelectionRegion> {
+  enum { WithNetSerializer = true };
+};
+
+/**
+ * Structure-of-arrays view over many oriented boxes, used to test them all against one selection region in a
+ * single call.
+ *
+ * Box `i` is the axis-aligned box `Origins[i] +/- Extents[i]` in its local frame, rotated by `Rotations[i]` and
+ * then translated by `Positions[i]`. There is no separate scale: fold it into the local box beforehand
+ * (`Origin * Scale`, `Extent * Scale.GetAbs()`).
+ *
+ * All views must have the same length. The batch does not own the memory it points at.
+ */
+struct SELECTIONBOX_API FSelectionBoxBatch {
+  TArrayView<const FVector> Positions;
+  TArrayView<const FQuat> Rotations;
+  TArrayView<const FVector> Origins;
+  TArrayView<const FVector> Extents;
+
+  int32 Num() const { return Positions.Num(); }
+
+  // True if all of the views have matching lengths.
+  bool IsValid() const {
+    return Rotations.Num() == Positions.Num() && Origins.Num() == Positions.Num() &&
+           Extents.Num() == Positions.Num();
+  }
+};
+
+/**
+ * Owning storage for the arrays of a FSelectionBoxBatch.
+ */
+struct SELECTIONBOX_API FSelectionBoxBatchData {
+  TArray<FVector> Positions;
+  TArray<FQuat> Rotations;
+  TArray<FVector> Origins;
+  TArray<FVector> Extents;
+
+  int32 Num() const { return Positions.Num(); }
+
+  // Empty all arrays, keeping room for `ExpectedNum` boxes.
+  void Reset(int32 ExpectedNum = 0);
+
+  // Append a box, specified the same way as for SelectionRegionOverlapsTransformedBox. Any scale in the
+  // transform is folded into the local origin and extent. Returns the index of the new box.
+  int32 Add(const FTransform& BoxTransform, const FVector& Origin, const FVector& Extent);
+
+  FSelectionBoxBatch GetView() const { return FSelectionBoxBatch{Positions, Rotations, Origins, Extents}; }
+};
+
+/**
+ * Settings shared by the queries that test many boxes at once.
+ */
+USTRUCT(BlueprintType)
+struct SELECTIONBOX_API FSelectionQueryOptions {
+  GENERATED_BODY()
+public:
+  // Which box test to run.
+  UPROPERTY(EditAnywhere, BlueprintReadWrite)
+  ESelectionQueryMode Mode{ESelectionQueryMode::Frustum};
+
+  // Smallest number of boxes handed to a worker thread by the parallel queries. If not positive, the value of
+  // the `SelectionBox.ParallelMinBatchSize` console variable is used.
+  UPROPERTY(EditAnywhere, BlueprintReadWrite)
+  int32 MinParallelBatchSize{0};
+
+  // If set, actors whose box straddles the region are only selected if one of their components overlaps it (see
+  // SelectionRegionOverlapsActorComponents). Only used by the queries that take actors.
+  UPROPERTY(EditAnywhere, BlueprintReadWrite)
+  bool bRefineComponents{false};
+
+  // If set, the frustum test moves every box into the frame of the camera, in double precision, and then tests it
+  // in single precision. This is faster, and precision only depends on the distance from the camera, not from the
+  // world origin. Boxes that touch the region within a rounding error of float may be classified differently from
+  // the default (double precision) test. Only used with ESelectionQueryMode::Frustum.
+  UPROPERTY(EditAnywhere, BlueprintReadWrite)
+  bool bCameraRelative{false};
 };
 
 /**
@@ -91,7 +306,8 @@ public:
    *
    * The `Origin` and `Extent` parameters are expressed in the local frame of the box.
    *
-   * `RayDirection` will be normalized, but must have non-zero length.
+   * `RayDirection` will be normalized, but must have non-zero length. Only the part of the ray in front of
+   * `RayOrigin` counts, so a box behind the origin is not hit.
    *
    * This function only checks for an intersection, and does not return the exact intersection point.
    */
@@ -102,6 +318,19 @@ public:
                                           const FVector& Origin,
                                           const FVector& Extent);
 
+  /**
+   * Version of RayIntersectsTransformedBox that also returns the distance along the ray to the point where it
+   * enters the box (0 if `RayOrigin` is inside the box). Boxes entered further away than `MaxDistance` are not hit,
+   * which lets a search for the nearest box give up on a box early.
+   */
+  static bool RayIntersectsTransformedBoxDistance(const FVector& RayOrigin,
+                                                  const FVector& RayDirection,
+                                                  const FTransform& BoxTransform,
+                                                  const FVector& Origin,
+                                                  const FVector& Extent,
+                                                  double& DistanceOut,
+                                                  double MaxDistance = TNumericLimits<double>::Max());
+
   /**
    * Check if the provided region contains any part of the specified transformed box. The region is defined
    * by the camera origin, and 4 vectors that specify the bounds of a frustum-like shape. It is not a full frustum
@@ -126,6 +355,196 @@ public:
                                                                           const FVector& Origin,
                                                                           const FVector& Extent);
 
+  /**
+   * Classify the transformed box (specified as for SelectionRegionOverlapsTransformedBox) against the region,
+   * including the clip planes. The bounding sphere is tried first, then the box against each plane, and either can
+   * settle the result without testing the corners. Only boxes that straddle a plane get the full test, which tells
+   * Intersecting apart from Outside.
+   *
+   * A FullyInside result lets the caller accept everything the box encloses (such as the components of an actor)
+   * without testing any of it.
+   */
+  UFUNCTION(BlueprintCallable, BlueprintPure)
+  static ESelectionOverlap SelectionRegionClassifyTransformedBox(const FSelectionRegion& Region,
+                                                                 const FRegionPlanes& Planes,
+                                                                 const FTransform& BoxTransform,
+                                                                 const FVector& Origin,
+                                                                 const FVector& Extent);
+
+  /**
+   * Classify world-space bounds (such as UPrimitiveComponent::Bounds) against the region: first by the sphere,
+   * then by the box. The result is exact for the box.
+   */
+  UFUNCTION(BlueprintCallable, BlueprintPure)
+  static ESelectionOverlap SelectionRegionClassifyBounds(const FSelectionRegion& Region,
+                                                         const FRegionPlanes& Planes,
+                                                         const FBoxSphereBounds& Bounds);
+
+  /**
+   * Check if the region overlaps the transformed box by projecting the box to the screen, instead of testing it
+   * against the region planes in 3D. The 8 corners are projected once with the region's view-projection matrix
+   * (box edges that cross the near plane are clipped to it first), and the convex hull of the projected points is
+   * tested against the selection rectangle.
+   *
+   * Arguments are the same as for SelectionRegionOverlapsTransformedBox. The region must have
+   * `bHasViewProjection` set, otherwise this returns NoIntersection.
+   */
+  UFUNCTION(BlueprintCallable, BlueprintPure)
+  static ETransformedBoxTestResult SelectionRegionOverlapsTransformedBoxScreenSpace(const FSelectionRegion& Region,
+                                                                                    const FTransform& BoxTransform,
+                                                                                    const FVector& Origin,
+                                                                                    const FVector& Extent);
+
+  /**
+   * Check if the region overlaps the transformed box with the separating axis theorem. The region is the
+   * (unbounded) pyramid formed by the four planes, so the candidate axes are the 4 plane normals, the 3 box axes,
+   * and the 12 cross products of box axes with corner rays. Each axis costs a handful of dot products, so unlike
+   * SelectionRegionOverlapsTransformedBox2 the cost does not depend on how the box straddles the planes.
+   *
+   * Boxes with a corner inside the region report BoxCornerInsideRegion. Other overlapping boxes report Overlaps.
+   */
+  UFUNCTION(BlueprintCallable, BlueprintPure)
+  static ETransformedBoxTestResult SelectionRegionOverlapsTransformedBoxSeparatingAxis(const FSelectionRegion& Region,
+                                                                                       const FRegionPlanes& Planes,
+                                                                                       const FTransform& BoxTransform,
+                                                                                       const FVector& Origin,
+                                                                                       const FVector& Extent);
+
+  // Run SelectionRegionOverlapsTransformedBox2, or one of the alternatives above, depending on `Mode`.
+  UFUNCTION(BlueprintCallable, BlueprintPure)
+  static ETransformedBoxTestResult SelectionRegionOverlapsTransformedBoxWithMode(const FSelectionRegion& Region,
+                                                                                 const FRegionPlanes& Planes,
+                                                                                 const FTransform& BoxTransform,
+                                                                                 const FVector& Origin,
+                                                                                 const FVector& Extent,
+                                                                                 ESelectionQueryMode Mode);
+
+  /**
+   * Test every box in `Boxes` against the region, writing one bit per box into `ResultsOut` (which is resized to
+   * `Boxes.Num()`). A set bit means the box intersects or overlaps the region.
+   *
+   * Each box is first culled with its bounding sphere, so there is no need to do that beforehand. The boxes are
+   * visited in order, so the cost is dominated by streaming the input arrays rather than by per-call overhead.
+   */
+  static void SelectionRegionOverlapsTransformedBoxBatch(const FSelectionRegion& Region,
+                                                         const FRegionPlanes& Planes,
+                                                         const FSelectionBoxBatch& Boxes,
+                                                         TBitArray<>& ResultsOut,
+                                                         const FSelectionQueryOptions& Options = {});
+
+  // Version of the above that writes the (ascending) indices of the overlapping boxes into `IndicesOut`.
+  static void SelectionRegionOverlapsTransformedBoxBatch(const FSelectionRegion& Region,
+                                                         const FRegionPlanes& Planes,
+                                                         const FSelectionBoxBatch& Boxes,
+                                                         TArray<int32>& IndicesOut,
+                                                         const FSelectionQueryOptions& Options = {});
+
+  /**
+   * Multi-threaded version of SelectionRegionOverlapsTransformedBoxBatch. The boxes are split into contiguous
+   * chunks of at least `Options.MinParallelBatchSize` boxes, which are tested on worker threads into separate
+   * buffers. The buffers are then concatenated in chunk order, so `IndicesOut` is ascending regardless of how the
+   * work was scheduled.
+   *
+   * Batches too small to fill two chunks are tested on the calling thread.
+   */
+  static void SelectionRegionOverlapsTransformedBoxBatchParallel(const FSelectionRegion& Region,
+                                                                 const FRegionPlanes& Planes,
+                                                                 const FSelectionBoxBatch& Boxes,
+                                                                 TArray<int32>& IndicesOut,
+                                                                 const FSelectionQueryOptions& Options = {});
+
+  /**
+   * Find the box of the batch that the ray `RayOrigin + t * RayDirection` (t >= 0) enters first, for picking the
+   * unit under the cursor. Returns its index, or INDEX_NONE if the ray misses every box, and the distance to it in
+   * `DistanceOut`.
+   *
+   * Box `HintIndex` is tested first, if valid. Passing the result of the previous frame usually finds the answer
+   * straight away, and every other box is then rejected by its bounding sphere unless it could be nearer. The
+   * bounding spheres of all boxes are checked, so the cost stays linear in the size of the batch. But the boxes
+   * whose spheres the ray enters are tested in order of where it enters them, stopping once that is beyond the
+   * nearest hit, so only the few boxes along the ray in front of the hit get the full test.
+   */
+  static int32 PickTransformedBoxBatch(const FVector& RayOrigin,
+                                       const FVector& RayDirection,
+                                       const FSelectionBoxBatch& Boxes,
+                                       double& DistanceOut,
+                                       int32 HintIndex = INDEX_NONE);
+
+  /**
+   * Check which of the provided actors overlap the selection region, using the same test as
+   * SelectionRegionOverlapsActor. Bounds are gathered on the calling thread, and large sets of actors are then
+   * tested in parallel (see SelectionRegionOverlapsTransformedBoxBatchParallel).
+   *
+   * `ActorsOut` preserves the order of `Actors`. Invalid actors are skipped. With `Options.bRefineComponents`,
+   * actors that pass are then checked against their components on the calling thread.
+   */
+  UFUNCTION(BlueprintCallable, meta=(AutoCreateRefTerm="Options"))
+  static void SelectionRegionOverlapsActors(const FSelectionRegion& Region, const TArray<AActor*>& Actors,
+                                            bool bIncludeFromNonColliding, bool bIncludeChildActors,
+                                            const FSelectionQueryOptions& Options,
+                                            TArray<AActor*>& ActorsOut);
+
+  /**
+   * Check which instances of an instanced static mesh component overlap the selection region, writing their
+   * (ascending) instance indices into `InstancesOut`. Each instance is the local bounds of the mesh under the
+   * instance transform, and they are tested as a batch (see SelectionRegionOverlapsTransformedBoxBatchParallel).
+   *
+   * For a hierarchical component whose cluster tree is up to date, the tree is walked first: clusters entirely
+   * outside the region are skipped, and clusters entirely inside it are selected, without testing their instances.
+   */
+  UFUNCTION(BlueprintCallable, meta=(AutoCreateRefTerm="Options"))
+  static void SelectionRegionOverlapsInstances(const FSelectionRegion& Region,
+                                               const UInstancedStaticMeshComponent* Component,
+                                               const FSelectionQueryOptions& Options,
+                                               TArray<int32>& InstancesOut);
+
+  /**
+   * Version of SelectionRegionOverlapsTransformedBoxBatch that selects at most `MaxCount` boxes, preferring them in
+   * the order given by `Priority`. With ESelectionPriority::Score, `Scores` holds one score per box. `IndicesOut`
+   * is in priority order, best first.
+   *
+   * The boxes are culled by their bounding spheres and put in a heap by priority. They are then popped and tested in
+   * order, stopping once `MaxCount` of them have passed. So a large region over a dense group costs about `MaxCount`
+   * full tests, rather than one per box.
+   */
+  static void SelectionRegionOverlapsTransformedBoxBatchTopK(const FSelectionRegion& Region,
+                                                             const FRegionPlanes& Planes,
+                                                             const FSelectionBoxBatch& Boxes,
+                                                             int32 MaxCount,
+                                                             ESelectionPriority Priority,
+                                                             TArrayView<const float> Scores,
+                                                             TArray<int32>& IndicesOut,
+                                                             const FSelectionQueryOptions& Options = {});
+
+  /**
+   * Version of SelectionRegionOverlapsActors that selects at most `MaxCount` actors, in the order given by
+   * `Priority` (see SelectionRegionOverlapsTransformedBoxBatchTopK). With ESelectionPriority::Score, `Scores`
+   * holds one score per entry of `Actors`. `ActorsOut` is in priority order, best first.
+   */
+  UFUNCTION(BlueprintCallable, meta=(AutoCreateRefTerm="Scores,Options"))
+  static void SelectionRegionOverlapsActorsTopK(const FSelectionRegion& Region, const TArray<AActor*>& Actors,
+                                                bool bIncludeFromNonColliding, bool bIncludeChildActors,
+                                                int32 MaxCount, ESelectionPriority Priority,
+                                                const TArray<float>& Scores, const FSelectionQueryOptions& Options,
+                                                TArray<AActor*>& ActorsOut);
+
+  /**
+   * Check a selection claimed by a client, on the server. The boxes of all the claimed actors are tested against
+   * the region in one batch, with the same bounds as SelectionRegionOverlapsActors, each grown by `Tolerance` on
+   * every side to allow for the client having seen the actors in slightly different places. Claimed actors that
+   * fail the test are written to `RejectedOut`, and ones that no longer exist are ignored.
+   *
+   * The planes are always derived from the region here, rather than received from the client, so that they
+   * cannot disagree with it. Returns true if no actor was rejected.
+   */
+  UFUNCTION(BlueprintCallable)
+  static bool ValidateSelectedActors(const FSelectionRegion& Region,
+                                     const TArray<AActor*>& ClaimedActors,
+                                     bool bIncludeFromNonColliding,
+                                     bool bIncludeChildActors,
+                                     float Tolerance,
+                                     TArray<AActor*>& RejectedOut);
+
   /**
    * Check if the provided region contains any part of the specified world-aligned sphere.
    */
@@ -140,13 +559,25 @@ public:
                                              const FVector& SphereOrigin,
                                              float Radius);
 
+  /**
+   * Classify a world-aligned sphere against the region, including the clip planes. FullyInside and Outside are
+   * exact, but like SelectionRegionOverlapsSphere2, spheres near the corners of the region may be classified as
+   * Intersecting without overlapping it.
+   */
+  UFUNCTION(BlueprintCallable, BlueprintPure)
+  static ESelectionOverlap SelectionRegionClassifySphere(const FRegionPlanes& Planes,
+                                                         const FVector& SphereOrigin,
+                                                         float Radius);
+
   /**
    * Create FSelectionRegion from a pair of pixel coordinates that define a selection box in screen space.
    *
    * De-projects the corners of the box into world-space unit vectors. The pixel coordinates just need to specify
-   * two opposing corners of the bounding box, in any order.
+   * two opposing corners of the bounding box, in any order. An orthographic projection produces an orthographic
+   * region (see FSelectionRegion::bOrthographic).
    *
-   * Should return true provided you pass a valid controller w/ a valid viewport.
+   * Should return true provided you pass a valid controller w/ a valid viewport. ViewDirection is filled in from the
+   * center of the viewport. Set NearDistance, FarDistance and ExtraPlanes on the result afterwards, if needed.
    */
   UFUNCTION(BlueprintCallable, BlueprintPure)
   static bool CreateSelectionRegionForBoxCorners(APlayerController* Controller,
@@ -154,6 +585,16 @@ public:
                                                  const FVector2D& PixelCoordinates2,
                                                  FSelectionRegion& RegionOut);
 
+  /**
+   * Version of the above that takes the view-projection matrix and view rectangle directly, for use without a
+   * player controller (for example on a server, or in a benchmark).
+   */
+  static void CreateSelectionRegionFromViewProjection(const FMatrix& ViewProjectionMatrix,
+                                                      const FIntRect& ViewRect,
+                                                      const FVector2D& PixelCoordinates1,
+                                                      const FVector2D& PixelCoordinates2,
+                                                      FSelectionRegion& RegionOut);
+
   /**
    * Check if the provided selection region overlaps the oriented bounding box of the given component.
    *
@@ -163,17 +604,53 @@ public:
   UFUNCTION(BlueprintCallable, BlueprintPure)
   static bool SelectionRegionOverlapsComponent(const FSelectionRegion& Region, const USceneComponent* Component);
 
+  // Version of the above that accepts the pre-computed planes as an argument.
+  UFUNCTION(BlueprintCallable, BlueprintPure)
+  static bool SelectionRegionOverlapsComponent2(const FSelectionRegion& Region, const FRegionPlanes& Planes,
+                                                const USceneComponent* Component);
+
   /**
    * Check if the provided selection region overlaps the oriented bounding box of the given actor.
    *
    * Computes the local-space bounding box of the actor's components, and then checks if that box intersects
    * or overlaps the provided selection region. If it does, returns true.
+   *
+   * The local-space box is cached between calls (see SelectionBox.CacheActorBounds). Engine events drop it when
+   * components are registered, unregistered, attached, moved within the actor or given a new mesh. Actors with
+   * skinned meshes are not cached.
    */
   UFUNCTION(BlueprintCallable, BlueprintPure)
   static bool SelectionRegionOverlapsActor(const FSelectionRegion& Region, const AActor* Actor,
                                            bool bIncludeFromNonColliding,
                                            bool bIncludeChildActors);
 
+  /**
+   * Hierarchical version of SelectionRegionOverlapsActor, for actors whose components leave a lot of empty space
+   * inside the actor box (bases, vehicles with turrets, etc).
+   *
+   * The actor box is tested first. Actors entirely inside the region are accepted, and actors entirely outside of
+   * one of the planes are rejected, without looking at their components. Otherwise the actor is selected only if
+   * the oriented box of one of its primitive components overlaps the region. Components are picked with the same
+   * flags as for the actor box.
+   */
+  UFUNCTION(BlueprintCallable, BlueprintPure)
+  static bool SelectionRegionOverlapsActorComponents(const FSelectionRegion& Region, const AActor* Actor,
+                                                     bool bIncludeFromNonColliding, bool bIncludeChildActors);
+
+  // Version of the above that accepts the pre-computed planes as an argument.
+  UFUNCTION(BlueprintCallable, BlueprintPure)
+  static bool SelectionRegionOverlapsActorComponents2(const FSelectionRegion& Region, const FRegionPlanes& Planes,
+                                                      const AActor* Actor, bool bIncludeFromNonColliding,
+                                                      bool bIncludeChildActors);
+
+  // Drop the cached local-space bounds of an actor, so they are recomputed by the next query.
+  UFUNCTION(BlueprintCallable)
+  static void InvalidateCachedActorBounds(const AActor* Actor);
+
+  // Drop the cached local-space bounds of every actor.
+  UFUNCTION(BlueprintCallable)
+  static void ClearCachedActorBounds();
+
   // Pre-compute the planes for a given selection region.
   UFUNCTION(BlueprintCallable, BlueprintPure)
   static FRegionPlanes ComputePlanesForRegion(const FSelectionRegion& Region) {
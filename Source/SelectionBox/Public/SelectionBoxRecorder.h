@@ -0,0 +1,72 @@
+// Copyright 2021 Gareth Cross.
+#pragma once
+
+#include <atomic>
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "SelectionBoxFunctionLibrary.h"
+
+/**
+ * One batch query, as captured by FSelectionBoxRecorder: everything needed to run it again, and what it returned.
+ */
+struct SELECTIONBOX_API FSelectionBoxRecord {
+  FSelectionRegion Region;
+  FRegionPlanes Planes;
+  FSelectionQueryOptions Options;
+  FSelectionBoxBatchData Boxes;
+  // Ascending indices of the boxes that the query selected.
+  TArray<int32> Indices;
+};
+
+/**
+ * Opt-in capture of the selection queries made by a real session, so they can be replayed offline with the
+ * SelectionBoxReplay commandlet (in the SelectionBoxTools module).
+ *
+ * While recording, every call to SelectionRegionOverlapsTransformedBoxBatch(Parallel) appends one record to the
+ * file. Since the actor, async, subsystem validation and Mass queries all end up there, this covers nearly every
+ * query. The calling thread only copies the record into a buffer. Compressing and writing it happens on a
+ * background thread, and if the disk falls more than `SelectionBox.RecordMaxPendingMB` behind, records are
+ * dropped (and counted) rather than stalling the game.
+ *
+ * Start and stop with the console commands `SelectionBox.StartRecording [Filename]` and
+ * `SelectionBox.StopRecording`, or record a whole session with `-SelectionBoxRecord=<Filename>` on the command
+ * line. Relative filenames are placed in the profiling directory.
+ *
+ * The file holds a short header followed by one zlib-compressed block per record. Boxes and results are stored
+ * at full precision, so a replay in the same build selects exactly the same boxes.
+ */
+class SELECTIONBOX_API FSelectionBoxRecorder {
+public:
+  static FSelectionBoxRecorder& Get();
+
+  // Start recording to `Filename`, ending any recording in progress. Returns false if the file can't be created.
+  bool Start(const FString& Filename);
+
+  // Write out the pending records and close the file. Blocks until the writer thread is done.
+  void Stop();
+
+  // Cheap enough to check before every query.
+  bool IsRecording() const { return bRecording.load(std::memory_order_relaxed); }
+
+  // Append a query to the recording, if there is one. Safe to call from any thread.
+  void Record(const FSelectionRegion& Region, const FRegionPlanes& Planes, const FSelectionQueryOptions& Options,
+              const FSelectionBoxBatch& Boxes, TArrayView<const int32> Indices);
+
+  /**
+   * Read every record of a file made by the recorder. A file cut short (for example by a crash) yields the
+   * records before the damaged one, with a warning. Returns false if the file could not be read at all.
+   */
+  static bool LoadFile(const FString& Filename, TArray<FSelectionBoxRecord>& RecordsOut);
+
+private:
+  class FWriter;
+
+  FSelectionBoxRecorder();
+  ~FSelectionBoxRecorder();
+
+  // Held for reading while queueing a record, and for writing while the writer is replaced.
+  FRWLock WriterLock;
+  TUniquePtr<FWriter> Writer;
+  std::atomic<bool> bRecording{false};
+};
@@ -0,0 +1,289 @@
+// Copyright 2021 Gareth Cross.
+#pragma once
+
+#include "Async/Future.h"
+#include "CoreMinimal.h"
+#include "SelectionBoxFunctionLibrary.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "SelectionBoxSubsystem.generated.h"
+
+struct FSelectionBoxAsyncSnapshot;
+
+namespace SelectionBox {
+struct FPackedRegionPlanes;
+}
+
+/**
+ * The nearest registered object hit by a pick ray.
+ */
+USTRUCT(BlueprintType)
+struct SELECTIONBOX_API FSelectionBoxPickResult {
+  GENERATED_BODY()
+public:
+  // The hit object. Only one of these is set, depending on how it was registered.
+  UPROPERTY(BlueprintReadOnly)
+  TObjectPtr<AActor> Actor{nullptr};
+
+  UPROPERTY(BlueprintReadOnly)
+  TObjectPtr<USceneComponent> Component{nullptr};
+
+  // Distance along the ray to the point where it enters the box of the object.
+  UPROPERTY(BlueprintReadOnly)
+  double Distance{0};
+
+  // World location of that point.
+  UPROPERTY(BlueprintReadOnly)
+  FVector Location{FVector::ZeroVector};
+};
+
+/**
+ * Keeps a spatial index of the selectable actors and components in a world, so that selection queries only have
+ * to test the candidates near the selection region.
+ *
+ * Objects are bucketed into a loose grid over the XY plane, by the center of their world bounds. Each cell tracks
+ * the box enclosing everything in it. The cells are grouped into coarser blocks of 4x4, which are grouped again,
+ * for a few levels, and each block tracks the box enclosing its cells. A query culls the blocks against the region
+ * planes from the top down, so its cost follows the number of cells near the region rather than the number of
+ * occupied cells in the world. It then runs the sphere and OBB tests on the entries of the cells that survive. The
+ * index is kept up to date by listening for transform updates on each registered object (the root component, for
+ * actors), so moving units only touch their own cell and the blocks above it.
+ *
+ * The local-space bounds are captured at registration. Re-register an object if its shape changes. Actors are
+ * removed when they are destroyed. Destroyed components (and actors that went away without being destroyed, for
+ * example with a streamed out level) are skipped by queries, and removed after the next garbage collection.
+ *
+ * The async queries only cull cells on the game thread. They copy the transforms and bounds of the surviving
+ * entries into a pooled snapshot, and run the box tests on a worker thread.
+ */
+UCLASS()
+class SELECTIONBOX_API USelectionBoxSubsystem : public UWorldSubsystem {
+  GENERATED_BODY()
+public:
+  // Add an actor to the index, using the same bounds as SelectionRegionOverlapsActor.
+  UFUNCTION(BlueprintCallable)
+  void RegisterActor(AActor* Actor, bool bIncludeFromNonColliding, bool bIncludeChildActors);
+
+  // Remove an actor that was added with RegisterActor.
+  UFUNCTION(BlueprintCallable)
+  void UnregisterActor(AActor* Actor);
+
+  // Add a component to the index, using the same bounds as SelectionRegionOverlapsComponent.
+  UFUNCTION(BlueprintCallable)
+  void RegisterComponent(USceneComponent* Component);
+
+  // Remove a component that was added with RegisterComponent.
+  UFUNCTION(BlueprintCallable)
+  void UnregisterComponent(USceneComponent* Component);
+
+  // Find all registered actors that overlap the selection region.
+  UFUNCTION(BlueprintCallable)
+  void QueryActors(const FSelectionRegion& Region, TArray<AActor*>& ActorsOut);
+
+  // Find all registered components that overlap the selection region.
+  UFUNCTION(BlueprintCallable)
+  void QueryComponents(const FSelectionRegion& Region, TArray<USceneComponent*>& ComponentsOut);
+
+  /**
+   * Asynchronous version of QueryActors. The candidates are copied on the calling (game) thread and tested on a
+   * worker thread. `OnCompleted` is then called on the game thread, normally on the next frame. Actors destroyed in
+   * the meantime are left out of the results.
+   *
+   * The candidates are copied into pooled snapshots, which keep their arrays between queries, and are carried
+   * between threads by tasks from the task graph's pooled allocator. What a query still allocates is the result
+   * array handed to `OnCompleted`, the shared state of the future (for the TFuture overloads), and snapshot storage
+   * when a query has more candidates, or more queries are in flight, than ever before.
+   */
+  void QueryActorsAsync(const FSelectionRegion& Region, TUniqueFunction<void(TArray<AActor*>&&)> OnCompleted);
+
+  // Version of the above that returns a future. It is fulfilled on the game thread.
+  TFuture<TArray<AActor*>> QueryActorsAsync(const FSelectionRegion& Region);
+
+  // Asynchronous version of QueryComponents. See QueryActorsAsync.
+  void QueryComponentsAsync(const FSelectionRegion& Region,
+                            TUniqueFunction<void(TArray<USceneComponent*>&&)> OnCompleted);
+
+  TFuture<TArray<USceneComponent*>> QueryComponentsAsync(const FSelectionRegion& Region);
+
+  /**
+   * Find the registered object whose box the ray `RayOrigin + t * RayDirection` (t >= 0) enters first. This is
+   * much cheaper than a query with a tiny selection region, which makes it suitable for hover highlights.
+   *
+   * `LastHit` (the actor or component picked on the previous frame, if any) is tested first. It is usually still
+   * under the cursor, and the distance to it lets everything behind it be skipped. The cells are then visited
+   * nearest first, stopping at the first cell that starts behind the best hit so far.
+   */
+  UFUNCTION(BlueprintCallable)
+  bool Pick(const FVector& RayOrigin, const FVector& RayDirection, const UObject* LastHit,
+            FSelectionBoxPickResult& ResultOut);
+
+  // Pick with the ray through a pixel of the player's viewport. See Pick.
+  UFUNCTION(BlueprintCallable)
+  bool PickAtScreenPosition(const APlayerController* Controller, const FVector2D& PixelCoordinates,
+                            const UObject* LastHit, FSelectionBoxPickResult& ResultOut);
+
+  // Number of objects currently in the index.
+  UFUNCTION(BlueprintCallable, BlueprintPure)
+  int32 GetNumRegistered() const { return Entries.Num(); }
+
+  /**
+   * Edge length (in world units) of the grid cells. Should be a few times larger than a typical unit, so that
+   * cells are culled in bulk without holding too many candidates each. Changing it re-buckets every entry.
+   */
+  UFUNCTION(BlueprintCallable)
+  void SetCellSize(float NewCellSize);
+
+  UFUNCTION(BlueprintCallable, BlueprintPure)
+  float GetCellSize() const { return CellSize; }
+
+  // USubsystem implementation
+  virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+  virtual void Deinitialize() override;
+
+private:
+  // One registered actor or component.
+  struct FEntry {
+    // The registered object. Exactly one of these is set.
+    TWeakObjectPtr<AActor> Actor;
+    TWeakObjectPtr<USceneComponent> Component;
+    // Its key in EntryLookup, which outlives the object.
+    FObjectKey Key;
+
+    // The component whose transform we follow (the root component, for actors).
+    TWeakObjectPtr<USceneComponent> TransformSource;
+    FDelegateHandle TransformUpdatedHandle;
+
+    // Box in the local frame of TransformSource.
+    FVector LocalOrigin{FVector::ZeroVector};
+    FVector LocalExtent{FVector::ZeroVector};
+
+    // World transform and bounds as of the last update.
+    FTransform Transform;
+    FBoxSphereBounds WorldBounds;
+
+    // Location in the grid.
+    FIntPoint Cell{0, 0};
+    int32 IndexInCell{INDEX_NONE};
+  };
+
+  struct FCell {
+    TArray<int32> Entries;
+    // Encloses the world bounds of every entry in the cell. May be loose after removals until recomputed.
+    FBox Bounds{ForceInit};
+    bool bBoundsDirty{false};
+  };
+
+  // A block of level `L` covers 4x4 blocks of level `L - 1`, or 4x4 cells for level 0.
+  struct FBlock {
+    // Keys of the occupied cells (or blocks) that it covers.
+    TArray<FIntPoint, TInlineAllocator<16>> Children;
+    // Encloses the bounds of the children. Dirty if one of them is.
+    FBox Bounds{ForceInit};
+    bool bBoundsDirty{false};
+  };
+
+  static constexpr int32 NumBlockLevels = 3;
+  // A block's key is the key of its children, shifted right by this (rounding down for negative keys too).
+  static constexpr int32 BlockShift = 2;
+
+  // An entry of the queue that Pick visits cells and blocks in. Level is INDEX_NONE for a cell.
+  struct FPickNode {
+    double Distance;
+    int32 Level;
+    FIntPoint Key;
+
+    bool operator<(const FPickNode& Other) const { return Distance < Other.Distance; }
+  };
+
+  // Create an entry and insert it in the grid. Returns its index.
+  int32 AddEntry(FEntry&& Entry, const UObject* Key);
+
+  // Unbind, remove from the grid and free the entry registered under `Key`, if any.
+  void RemoveEntry(const UObject* Key);
+  void RemoveEntryAt(int32 EntryIndex);
+
+  // Refresh the cached transform of an entry, moving it between cells if required.
+  void UpdateEntry(int32 EntryIndex);
+
+  void InsertIntoCell(int32 EntryIndex);
+  void RemoveFromCell(int32 EntryIndex);
+
+  // Publish the memory used by the entries and the grid. Called whenever entries, cells or blocks are added or
+  // removed, so that queries don't pay for it.
+  void UpdateMemoryStat() const;
+
+  FIntPoint CellForLocation(const FVector& Location) const;
+
+  static FIntPoint ParentKey(const FIntPoint& Key) { return FIntPoint{Key.X >> BlockShift, Key.Y >> BlockShift}; }
+
+  // Add a new cell to the blocks above it, creating them as needed.
+  void LinkCell(const FIntPoint& CellKey);
+
+  // Remove an empty cell from the blocks above it, freeing those that become empty.
+  void UnlinkCell(const FIntPoint& CellKey);
+
+  // Grow the bounds of a cell, and of the blocks above it, to enclose `Box`.
+  void GrowBounds(const FIntPoint& CellKey, const FBox& Box);
+
+  // Mark the blocks above a cell for recomputing their bounds.
+  void MarkBlocksDirty(const FIntPoint& CellKey);
+
+  void HandleTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags,
+                              ETeleportType Teleport, int32 EntryIndex);
+
+  UFUNCTION()
+  void HandleActorDestroyed(AActor* DestroyedActor);
+
+  // Remove the entries whose object (or transform source) no longer exists.
+  void HandlePostGarbageCollect();
+
+  // Recompute the bounds of a cell, if entries have left it since they were last computed.
+  void RefreshCellBounds(FCell& Cell) const;
+
+  // Recompute the bounds of a block (and of its dirty children) if needed.
+  void RefreshBlockBounds(int32 Level, FBlock& Block);
+
+  // Up to date bounds of a cell (if Level is INDEX_NONE) or of a block.
+  const FBox& GetNodeBounds(int32 Level, const FIntPoint& Key);
+
+  // Make `EntryIndex` the best hit if the ray enters its box before `BestDistance`.
+  void PickEntry(int32 EntryIndex, const FVector& RayOrigin, const FVector& Direction, double& BestDistance,
+                 int32& BestEntry) const;
+
+  // Invoke `Visitor` with every entry that overlaps the region.
+  void ForEachOverlappingEntry(const FSelectionRegion& Region, TFunctionRef<void(const FEntry&)> Visitor);
+
+  // Invoke `Visitor` with every live entry in the cells that are not culled by the planes, and whether its cell is
+  // entirely inside the region (in which case the entry is too).
+  void ForEachCandidateEntry(const FRegionPlanes& Planes, TFunctionRef<void(const FEntry&, bool)> Visitor);
+
+  // Recursive part of ForEachCandidateEntry, for a cell (if Level is INDEX_NONE) or a block. `bInside` is set if a
+  // block above it is already known to be inside the region.
+  void VisitCandidates(int32 Level, const FIntPoint& Key, const FRegionPlanes& Planes,
+                       const SelectionBox::FPackedRegionPlanes& PackedPlanes, bool bInside,
+                       TFunctionRef<void(const FEntry&, bool)> Visitor);
+
+  // Fill `Snapshot` with the candidates for `Region` (actors, or components if `bActors` is false) and test them on
+  // a worker thread. The results are then delivered to the callback or promise of the snapshot on the game thread.
+  void LaunchAsyncQuery(const FSelectionRegion& Region, bool bActors,
+                        const TSharedRef<FSelectionBoxAsyncSnapshot, ESPMode::ThreadSafe>& Snapshot);
+
+  // Return a snapshot that no query is using, creating one only if all of them are in flight.
+  TSharedRef<FSelectionBoxAsyncSnapshot, ESPMode::ThreadSafe> AcquireSnapshot();
+
+  TSparseArray<FEntry> Entries;
+  TMap<FObjectKey, int32> EntryLookup;
+  TMap<FIntPoint, FCell> Cells;
+  TMap<FIntPoint, FBlock> Blocks[NumBlockLevels];
+
+  // Snapshots are recycled so that their arrays keep their allocations between queries. A snapshot is free when
+  // the pool holds the only reference to it.
+  TArray<TSharedRef<FSelectionBoxAsyncSnapshot, ESPMode::ThreadSafe>> SnapshotPool;
+
+  // Scratch space for Pick: a heap of the cells and blocks hit by the ray, nearest first.
+  TArray<FPickNode> PickQueue;
+
+  FDelegateHandle PostGarbageCollectHandle;
+
+  float CellSize{2000.0f};
+};
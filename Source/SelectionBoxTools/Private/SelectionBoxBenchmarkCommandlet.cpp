@@ -0,0 +1,388 @@
+// Copyright 2021 Gareth Cross.
+#include "SelectionBoxBenchmarkCommandlet.h"
+
+#include "Misc/FileHelper.h"
+#include "SelectionBoxCore.h"
+#include "SelectionBoxFunctionLibrary.h"
+#include "SelectionBoxTiming.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogSelectionBoxBenchmark, Log, All);
+
+namespace {
+
+enum class EBoxRotation { None, Yaw, Full };
+
+struct FBenchmarkSettings {
+  int32 Seed{1};
+  int32 Units{20000};
+  int32 Clusters{0};
+  float Spread{20000};
+  float MinExtent{30};
+  float MaxExtent{150};
+  EBoxRotation Rotation{EBoxRotation::Yaw};
+  float CameraHeight{3000};
+  float CameraPitch{-55};
+  float Fov{90};
+  float OrthoWidth{0};
+  float SelectWidth{0.3f};
+  float SelectHeight{0.3f};
+  int32 TopK{100};
+  int32 Iterations{10};
+  FString CsvPath;
+
+  void Parse(const TCHAR* const Params) {
+    FParse::Value(Params, TEXT("Seed="), Seed);
+    FParse::Value(Params, TEXT("Units="), Units);
+    FParse::Value(Params, TEXT("Clusters="), Clusters);
+    FParse::Value(Params, TEXT("Spread="), Spread);
+    FParse::Value(Params, TEXT("MinExtent="), MinExtent);
+    FParse::Value(Params, TEXT("MaxExtent="), MaxExtent);
+    FParse::Value(Params, TEXT("CameraHeight="), CameraHeight);
+    FParse::Value(Params, TEXT("CameraPitch="), CameraPitch);
+    FParse::Value(Params, TEXT("Fov="), Fov);
+    FParse::Value(Params, TEXT("OrthoWidth="), OrthoWidth);
+    FParse::Value(Params, TEXT("SelectWidth="), SelectWidth);
+    FParse::Value(Params, TEXT("SelectHeight="), SelectHeight);
+    FParse::Value(Params, TEXT("TopK="), TopK);
+    FParse::Value(Params, TEXT("Iterations="), Iterations);
+    FParse::Value(Params, TEXT("Csv="), CsvPath);
+    FString RotationName;
+    if (FParse::Value(Params, TEXT("Rotation="), RotationName)) {
+      Rotation = RotationName == TEXT("None") ? EBoxRotation::None
+                 : RotationName == TEXT("Full") ? EBoxRotation::Full
+                 : EBoxRotation::Yaw;
+    }
+    Units = FMath::Max(Units, 1);
+    TopK = FMath::Max(TopK, 1);
+    Iterations = FMath::Max(Iterations, 1);
+    MaxExtent = FMath::Max(MaxExtent, MinExtent);
+  }
+};
+
+// A generated scene: the boxes, both as transforms and in batch form, and the selection region.
+struct FBenchmarkScene {
+  TArray<FTransform> Transforms;
+  TArray<FVector> Origins;
+  TArray<FVector> Extents;
+  TArray<FBoxSphereBounds> WorldBounds;
+  FSelectionBoxBatchData Batch;
+
+  FSelectionRegion Region;
+  FRegionPlanes Planes;
+
+  void Generate(const FBenchmarkSettings& Settings) {
+    FRandomStream Random{Settings.Seed};
+
+    TArray<FVector2D> ClusterCenters;
+    for (int32 i = 0; i < Settings.Clusters; ++i) {
+      ClusterCenters.Emplace(Random.FRandRange(-Settings.Spread, Settings.Spread),
+                             Random.FRandRange(-Settings.Spread, Settings.Spread));
+    }
+    const float ClusterRadius = Settings.Clusters > 0 ? Settings.Spread / FMath::Sqrt(Settings.Clusters) : 0;
+
+    Batch.Reset(Settings.Units);
+    for (int32 i = 0; i < Settings.Units; ++i) {
+      FVector2D Location;
+      if (ClusterCenters.Num() > 0) {
+        const FVector2D& Center = ClusterCenters[Random.RandHelper(ClusterCenters.Num())];
+        const float Angle = Random.FRandRange(0, 2 * PI);
+        const float Distance = ClusterRadius * FMath::Sqrt(Random.FRand());
+        Location = Center + FVector2D{FMath::Cos(Angle), FMath::Sin(Angle)} * Distance;
+      } else {
+        Location = FVector2D{Random.FRandRange(-Settings.Spread, Settings.Spread),
+                             Random.FRandRange(-Settings.Spread, Settings.Spread)};
+      }
+
+      const FVector Extent{Random.FRandRange(Settings.MinExtent, Settings.MaxExtent),
+                           Random.FRandRange(Settings.MinExtent, Settings.MaxExtent),
+                           Random.FRandRange(Settings.MinExtent, Settings.MaxExtent)};
+      FQuat Rotation = FQuat::Identity;
+      if (Settings.Rotation == EBoxRotation::Yaw) {
+        Rotation = FRotator{0, Random.FRandRange(-180, 180), 0}.Quaternion();
+      } else if (Settings.Rotation == EBoxRotation::Full) {
+        Rotation = FRotationMatrix::MakeFromX(Random.GetUnitVector()).ToQuat() *
+                   FQuat{FVector::ForwardVector, Random.FRandRange(-PI, PI)};
+      }
+
+      // Boxes sit on the ground, with their local origin at the bottom like a typical unit mesh.
+      const FVector Origin{0, 0, Extent.Z};
+      const FTransform Transform{Rotation, FVector{Location, 0}};
+      Transforms.Add(Transform);
+      Origins.Add(Origin);
+      Extents.Add(Extent);
+      WorldBounds.Add(FBoxSphereBounds{FBox{Origin - Extent, Origin + Extent}}.TransformBy(Transform));
+      Batch.Add(Transform, Origin, Extent);
+    }
+
+    // Camera looking at the middle of the field.
+    const FIntRect ViewRect{0, 0, 1920, 1080};
+    const float Pitch = FMath::Clamp(Settings.CameraPitch, -89.0f, -1.0f);
+    const FVector CameraLocation{-Settings.CameraHeight / FMath::Tan(FMath::DegreesToRadians(-Pitch)), 0,
+                                 Settings.CameraHeight};
+    const FMatrix ViewMatrix = FTranslationMatrix{-CameraLocation} *
+                               FInverseRotationMatrix{FRotator{Pitch, 0, 0}} *
+                               FMatrix{FPlane{0, 0, 1, 0}, FPlane{1, 0, 0, 0}, FPlane{0, 1, 0, 0}, FPlane{0, 0, 0, 1}};
+    const FMatrix ProjectionMatrix =
+        Settings.OrthoWidth > 0
+            ? FMatrix{FReversedZOrthoMatrix{Settings.OrthoWidth / 2,
+                                            Settings.OrthoWidth / 2 * ViewRect.Height() / ViewRect.Width(),
+                                            1.0e-6f, 0.0f}}
+            : FMatrix{FReversedZPerspectiveMatrix{FMath::DegreesToRadians(Settings.Fov) / 2,
+                                                  static_cast<float>(ViewRect.Width()),
+                                                  static_cast<float>(ViewRect.Height()), 10.0f}};
+
+    const FVector2D ScreenCenter{ViewRect.Width() / 2.0, ViewRect.Height() / 2.0};
+    const FVector2D HalfSize{ViewRect.Width() * Settings.SelectWidth / 2,
+                             ViewRect.Height() * Settings.SelectHeight / 2};
+    USelectionBoxFunctionLibrary::CreateSelectionRegionFromViewProjection(
+        ViewMatrix * ProjectionMatrix, ViewRect, ScreenCenter - HalfSize, ScreenCenter + HalfSize, Region);
+    Planes = Region.ComputePlanes();
+  }
+};
+
+// Timing and outcome of one query path.
+struct FBenchmarkResult {
+  FString Name;
+  double Seconds{0};
+  int32 NumBoxes{0};
+  TBitArray<> Selected;
+  // Filters and partial tests are not expected to agree with the full test.
+  bool bCompareToReference{true};
+  // Paths that may differ from the full test on boxes touching the region within float rounding. Disagreements are
+  // still logged, but don't fail the run.
+  bool bExact{true};
+};
+
+}  // namespace
+
+USelectionBoxBenchmarkCommandlet::USelectionBoxBenchmarkCommandlet() {
+  IsClient = false;
+  IsServer = false;
+  IsEditor = false;
+  LogToConsole = true;
+}
+
+int32 USelectionBoxBenchmarkCommandlet::Main(const FString& Params) {
+  using SelectionBoxTools::TimeFastest;
+  FBenchmarkSettings Settings;
+  Settings.Parse(*Params);
+
+  FBenchmarkScene Scene;
+  Scene.Generate(Settings);
+  const int32 Num = Settings.Units;
+  using Lib = USelectionBoxFunctionLibrary;
+
+  TArray<FBenchmarkResult> Results;
+  const auto AddResult = [&Results, Num](const TCHAR* Name, const double Seconds, TBitArray<>&& Selected) {
+    Results.Add(FBenchmarkResult{Name, Seconds, Num, MoveTemp(Selected)});
+  };
+
+  // Per-box calls, exactly as SelectionRegionOverlapsActor makes them.
+  {
+    TBitArray<> Selected;
+    const double Seconds = TimeFastest(Settings.Iterations, [&] {
+      Selected.Init(false, Num);
+      for (int32 i = 0; i < Num; ++i) {
+        Selected[i] = Lib::SelectionRegionOverlapsSphere2(Scene.Planes, Scene.WorldBounds[i].Origin,
+                                                          Scene.WorldBounds[i].SphereRadius);
+      }
+    });
+    Results.Add(FBenchmarkResult{TEXT("SelectionRegionOverlapsSphere2"), Seconds, Num, MoveTemp(Selected), false});
+  }
+  {
+    TBitArray<> Selected;
+    const double Seconds = TimeFastest(Settings.Iterations, [&] {
+      Selected.Init(false, Num);
+      for (int32 i = 0; i < Num; ++i) {
+        Selected[i] = Lib::SelectionRegionOverlapsTransformedBox2(Scene.Region, Scene.Planes, Scene.Transforms[i],
+                                                                  Scene.Origins[i], Scene.Extents[i]) !=
+                      ETransformedBoxTestResult::NoIntersection;
+      }
+    });
+    AddResult(TEXT("SelectionRegionOverlapsTransformedBox2"), Seconds, MoveTemp(Selected));
+  }
+  {
+    TBitArray<> Selected;
+    const double Seconds = TimeFastest(Settings.Iterations, [&] {
+      Selected.Init(false, Num);
+      for (int32 i = 0; i < Num; ++i) {
+        Selected[i] = Lib::RayIntersectsTransformedBox(Scene.Region.CameraOrigin, Scene.Region.TopLeftRay,
+                                                       Scene.Transforms[i], Scene.Origins[i], Scene.Extents[i]);
+      }
+    });
+    Results.Add(FBenchmarkResult{TEXT("RayIntersectsTransformedBox"), Seconds, Num, MoveTemp(Selected), false});
+  }
+
+  const TPair<const TCHAR*, ESelectionQueryMode> Modes[] = {
+      {TEXT("Frustum"), ESelectionQueryMode::Frustum},
+      {TEXT("ScreenSpace"), ESelectionQueryMode::ScreenSpace},
+      {TEXT("SeparatingAxis"), ESelectionQueryMode::SeparatingAxis},
+  };
+  for (const TPair<const TCHAR*, ESelectionQueryMode>& Mode : Modes) {
+    TBitArray<> Selected;
+    const double Seconds = TimeFastest(Settings.Iterations, [&] {
+      Selected.Init(false, Num);
+      for (int32 i = 0; i < Num; ++i) {
+        const FBoxSphereBounds& Bounds = Scene.WorldBounds[i];
+        Selected[i] = Lib::SelectionRegionOverlapsSphere2(Scene.Planes, Bounds.Origin, Bounds.SphereRadius) &&
+                      Lib::SelectionRegionOverlapsTransformedBoxWithMode(Scene.Region, Scene.Planes,
+                                                                         Scene.Transforms[i], Scene.Origins[i],
+                                                                         Scene.Extents[i], Mode.Value) !=
+                          ETransformedBoxTestResult::NoIntersection;
+      }
+    });
+    AddResult(*FString::Printf(TEXT("Sphere2 + %s"), Mode.Key), Seconds, MoveTemp(Selected));
+  }
+
+  // Batch paths:
+  const FSelectionBoxBatch BatchView = Scene.Batch.GetView();
+  for (const TPair<const TCHAR*, ESelectionQueryMode>& Mode : Modes) {
+    FSelectionQueryOptions Options;
+    Options.Mode = Mode.Value;
+    TBitArray<> Selected;
+    const double Seconds = TimeFastest(Settings.Iterations, [&] {
+      Lib::SelectionRegionOverlapsTransformedBoxBatch(Scene.Region, Scene.Planes, BatchView, Selected, Options);
+    });
+    AddResult(*FString::Printf(TEXT("Batch %s"), Mode.Key), Seconds, MoveTemp(Selected));
+  }
+  {
+    FSelectionQueryOptions Options;
+    Options.bCameraRelative = true;
+    TBitArray<> Selected;
+    const double Seconds = TimeFastest(Settings.Iterations, [&] {
+      Lib::SelectionRegionOverlapsTransformedBoxBatch(Scene.Region, Scene.Planes, BatchView, Selected, Options);
+    });
+    AddResult(TEXT("Batch Frustum (camera-relative)"), Seconds, MoveTemp(Selected));
+    Results.Last().bExact = false;
+  }
+  {
+    TArray<int32> Indices;
+    const double Seconds = TimeFastest(Settings.Iterations, [&] {
+      Lib::SelectionRegionOverlapsTransformedBoxBatchParallel(Scene.Region, Scene.Planes, BatchView, Indices);
+    });
+    TBitArray<> Selected(false, Num);
+    for (const int32 Index : Indices) {
+      Selected[Index] = true;
+    }
+    AddResult(TEXT("BatchParallel Frustum"), Seconds, MoveTemp(Selected));
+  }
+  {
+    // Selects a subset of the region, so it can't be compared with the other paths.
+    TArray<int32> Indices;
+    const double Seconds = TimeFastest(Settings.Iterations, [&] {
+      Lib::SelectionRegionOverlapsTransformedBoxBatchTopK(Scene.Region, Scene.Planes, BatchView, Settings.TopK,
+                                                          ESelectionPriority::ScreenCenter, {}, Indices);
+    });
+    TBitArray<> Selected(false, Num);
+    for (const int32 Index : Indices) {
+      Selected[Index] = true;
+    }
+    Results.Add(FBenchmarkResult{FString::Printf(TEXT("BatchTopK %d ScreenCenter"), Settings.TopK), Seconds, Num,
+                                 MoveTemp(Selected), false});
+  }
+
+  // The engine-free full test, with and without the Cohen-Sutherland skip of edges that have both ends outside the
+  // same plane. It only handles perspective regions.
+  if (!Scene.Region.bOrthographic) {
+    using namespace SelectionBox;
+    const TRegion<FVector> CoreRegion{Scene.Region.CameraOrigin, Scene.Region.TopLeftRay, Scene.Region.TopRightRay,
+                                      Scene.Region.BottomRightRay, Scene.Region.BottomLeftRay};
+    const TRegionPlanes<FVector> CorePlanes = ComputeRegionPlanes(CoreRegion);
+    TArray<TOrientedBox<FVector>> CoreBoxes;
+    CoreBoxes.Reserve(Num);
+    for (int32 i = 0; i < Num; ++i) {
+      const FQuat& Rotation = Scene.Batch.Rotations[i];
+      const FVector& Extent = Scene.Batch.Extents[i];
+      CoreBoxes.Add(TOrientedBox<FVector>{
+          Scene.Batch.Positions[i] + Rotation.RotateVector(Scene.Batch.Origins[i]),
+          {Rotation.GetAxisX() * Extent.X, Rotation.GetAxisY() * Extent.Y, Rotation.GetAxisZ() * Extent.Z}});
+    }
+    const auto TimeCoreTestBox = [&](const auto& Test, const TCHAR* Name) {
+      TBitArray<> Selected;
+      const double Seconds = TimeFastest(Settings.Iterations, [&] {
+        Selected.Init(false, Num);
+        for (int32 i = 0; i < Num; ++i) {
+          const FBoxSphereBounds& Bounds = Scene.WorldBounds[i];
+          Selected[i] = SphereOverlapsRegion(CorePlanes, Bounds.Origin, Bounds.SphereRadius) &&
+                        Test(CoreRegion, CorePlanes, CoreBoxes[i]) != EBoxTestResult::NoIntersection;
+        }
+      });
+      AddResult(Name, Seconds, MoveTemp(Selected));
+    };
+    TimeCoreTestBox([](const auto&... Args) { return TestBox(Args...); }, TEXT("Sphere + Core TestBox"));
+    TimeCoreTestBox([](const auto&... Args) { return TestBox</*bSkipOutsideEdges=*/false>(Args...); },
+                    TEXT("Sphere + Core TestBox (no edge skip)"));
+  }
+
+  // How did the frustum test exit? (Counted outside of the timed loops.)
+  int32 NumSphereRejected = 0;
+  int32 Exits[5] = {0, 0, 0, 0, 0};
+  static_assert(static_cast<int32>(ETransformedBoxTestResult::Overlaps) == 4, "Update Exits");
+  for (int32 i = 0; i < Num; ++i) {
+    const FBoxSphereBounds& Bounds = Scene.WorldBounds[i];
+    if (!Lib::SelectionRegionOverlapsSphere2(Scene.Planes, Bounds.Origin, Bounds.SphereRadius)) {
+      ++NumSphereRejected;
+      continue;
+    }
+    ++Exits[static_cast<int32>(Lib::SelectionRegionOverlapsTransformedBox2(
+        Scene.Region, Scene.Planes, Scene.Transforms[i], Scene.Origins[i], Scene.Extents[i]))];
+  }
+
+  // Report:
+  UE_LOG(LogSelectionBoxBenchmark, Display, TEXT("Scene: seed %d, %d units, %d clusters, %d iterations."),
+         Settings.Seed, Num, Settings.Clusters, Settings.Iterations);
+  const auto Percent = [Num](const int32 Count) { return 100.0 * Count / Num; };
+  UE_LOG(LogSelectionBoxBenchmark, Display, TEXT("Frustum test exits:"));
+  UE_LOG(LogSelectionBoxBenchmark, Display, TEXT("  Rejected by sphere:             %6.2f%%"),
+         Percent(NumSphereRejected));
+  UE_LOG(LogSelectionBoxBenchmark, Display, TEXT("  Box corner inside region:       %6.2f%%"),
+         Percent(Exits[static_cast<int32>(ETransformedBoxTestResult::BoxCornerInsideRegion)]));
+  UE_LOG(LogSelectionBoxBenchmark, Display, TEXT("  Box intersects plane:           %6.2f%%"),
+         Percent(Exits[static_cast<int32>(ETransformedBoxTestResult::BoxIntersectsPlane)]));
+  UE_LOG(LogSelectionBoxBenchmark, Display, TEXT("  Selection corner intersects box: %5.2f%%"),
+         Percent(Exits[static_cast<int32>(ETransformedBoxTestResult::SelectionCornerIntersectsBox)]));
+  UE_LOG(LogSelectionBoxBenchmark, Display, TEXT("  Rejected after full test:       %6.2f%%"),
+         Percent(Exits[static_cast<int32>(ETransformedBoxTestResult::NoIntersection)]));
+
+  const auto FindResult = [&Results](const TCHAR* Name) {
+    return Results.FindByPredicate([Name](const FBenchmarkResult& Result) { return Result.Name == Name; });
+  };
+  const FBenchmarkResult* WithSkip = FindResult(TEXT("Sphere + Core TestBox"));
+  const FBenchmarkResult* WithoutSkip = FindResult(TEXT("Sphere + Core TestBox (no edge skip)"));
+  if (WithSkip && WithoutSkip && WithoutSkip->Seconds > 0) {
+    UE_LOG(LogSelectionBoxBenchmark, Display, TEXT("Cohen-Sutherland edge skip saves %.1f%% of the core test."),
+           100.0 * (WithoutSkip->Seconds - WithSkip->Seconds) / WithoutSkip->Seconds);
+  }
+
+  const FBenchmarkResult* Reference = FindResult(TEXT("Sphere2 + Frustum"));
+  int32 ReturnCode = 0;
+  FString Csv = TEXT("Path,Seconds,NsPerBox,BoxesPerSec,Selected,Mismatches\n");
+  for (const FBenchmarkResult& Result : Results) {
+    const double NsPerBox = Result.Seconds * 1.0e9 / Result.NumBoxes;
+    const double BoxesPerSec = Result.Seconds > 0 ? Result.NumBoxes / Result.Seconds : 0;
+    const int32 NumSelected = Result.Selected.CountSetBits();
+    int32 NumMismatches = 0;
+    if (Reference && Result.bCompareToReference) {
+      for (int32 i = 0; i < Result.Selected.Num(); ++i) {
+        NumMismatches += Result.Selected[i] != Reference->Selected[i];
+      }
+    }
+    UE_LOG(LogSelectionBoxBenchmark, Display, TEXT("%-40s %9.2f ns/box %12.0f boxes/sec %7d selected"),
+           *Result.Name, NsPerBox, BoxesPerSec, NumSelected);
+    if (NumMismatches > 0) {
+      UE_LOG(LogSelectionBoxBenchmark, Warning, TEXT("%s disagrees with the frustum test on %d boxes."),
+             *Result.Name, NumMismatches);
+      if (Result.bExact) {
+        ReturnCode = 1;
+      }
+    }
+    Csv += FString::Printf(TEXT("%s,%.9f,%.3f,%.0f,%d,%d\n"), *Result.Name, Result.Seconds, NsPerBox, BoxesPerSec,
+                           NumSelected, NumMismatches);
+  }
+
+  if (!Settings.CsvPath.IsEmpty() && !FFileHelper::SaveStringToFile(Csv, *Settings.CsvPath)) {
+    UE_LOG(LogSelectionBoxBenchmark, Error, TEXT("Failed to write %s"), *Settings.CsvPath);
+    ReturnCode = 1;
+  }
+  return ReturnCode;
+}
@@ -0,0 +1,270 @@
+// Copyright 2021 Gareth Cross.
+#include "SelectionBoxReplayCommandlet.h"
+
+#include "Misc/FileHelper.h"
+#include "SelectionBoxFunctionLibrary.h"
+#include "SelectionBoxRecorder.h"
+#include "SelectionBoxTiming.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogSelectionBoxReplay, Log, All);
+
+namespace {
+
+struct FReplaySettings {
+  FString FilePath;
+  int32 Iterations{5};
+  FString CsvPath;
+
+  void Parse(const TCHAR* const Params) {
+    FParse::Value(Params, TEXT("File="), FilePath);
+    FParse::Value(Params, TEXT("Iterations="), Iterations);
+    FParse::Value(Params, TEXT("Csv="), CsvPath);
+    Iterations = FMath::Max(Iterations, 1);
+  }
+};
+
+// A recorded query, with the arguments of the single-box functions worked out ahead of time.
+struct FReplayQuery {
+  const FSelectionBoxRecord* Record{nullptr};
+  TArray<FTransform> Transforms;
+  TArray<FVector> SphereCenters;
+  TArray<float> SphereRadii;
+  // What the query selected when it was recorded.
+  TBitArray<> Recorded;
+
+  explicit FReplayQuery(const FSelectionBoxRecord& InRecord) : Record(&InRecord) {
+    const FSelectionBoxBatchData& Boxes = InRecord.Boxes;
+    Transforms.Reserve(Boxes.Num());
+    SphereCenters.Reserve(Boxes.Num());
+    SphereRadii.Reserve(Boxes.Num());
+    for (int32 i = 0; i < Boxes.Num(); ++i) {
+      const FTransform& Transform = Transforms.Emplace_GetRef(Boxes.Rotations[i], Boxes.Positions[i]);
+      SphereCenters.Add(Transform.TransformPosition(Boxes.Origins[i]));
+      SphereRadii.Add(Boxes.Extents[i].Size());
+    }
+    Recorded.Init(false, Boxes.Num());
+    for (const int32 Index : InRecord.Indices) {
+      if (Recorded.IsValidIndex(Index)) {
+        Recorded[Index] = true;
+      }
+    }
+  }
+
+  int32 Num() const { return Transforms.Num(); }
+};
+
+// One way of running a query, and its totals over the whole recording.
+struct FReplayPath {
+  FString Name;
+  // Run the query, writing one bit per box into `Selected`.
+  TFunction<void(const FReplayQuery& Query, TBitArray<>& Selected)> Run;
+  // Compare to the recorded result, instead of to the frustum test.
+  bool bCompareToRecording{false};
+  // Paths that may differ from the frustum test on boxes touching the region within float rounding. Disagreements
+  // are still logged, but don't fail the replay.
+  bool bExact{true};
+
+  double Seconds{0};
+  int64 NumSelected{0};
+  int64 NumMismatches{0};
+  int32 NumQueriesMismatched{0};
+  int32 FirstMismatch{INDEX_NONE};
+};
+
+void IndicesToBits(const TArray<int32>& Indices, const int32 Num, TBitArray<>& Selected) {
+  Selected.Init(false, Num);
+  for (const int32 Index : Indices) {
+    Selected[Index] = true;
+  }
+}
+
+}  // namespace
+
+USelectionBoxReplayCommandlet::USelectionBoxReplayCommandlet() {
+  IsClient = false;
+  IsServer = false;
+  IsEditor = false;
+  LogToConsole = true;
+}
+
+int32 USelectionBoxReplayCommandlet::Main(const FString& Params) {
+  using Lib = USelectionBoxFunctionLibrary;
+  using SelectionBoxTools::TimeFastest;
+  FReplaySettings Settings;
+  Settings.Parse(*Params);
+  if (Settings.FilePath.IsEmpty()) {
+    UE_LOG(LogSelectionBoxReplay, Error, TEXT("Pass the recording to replay with -File=<path>."));
+    return 1;
+  }
+
+  TArray<FSelectionBoxRecord> Records;
+  if (!FSelectionBoxRecorder::LoadFile(Settings.FilePath, Records)) {
+    return 1;
+  }
+  if (Records.Num() == 0) {
+    UE_LOG(LogSelectionBoxReplay, Error, TEXT("%s contains no queries."), *Settings.FilePath);
+    return 1;
+  }
+  TArray<FReplayQuery> Queries;
+  Queries.Reserve(Records.Num());
+  int64 NumBoxes = 0;
+  int64 NumRecordedSelected = 0;
+  int32 MaxBoxes = 0;
+  int32 NumOrthographic = 0;
+  for (const FSelectionBoxRecord& Record : Records) {
+    const FReplayQuery& Query = Queries.Emplace_GetRef(Record);
+    NumBoxes += Query.Num();
+    NumRecordedSelected += Record.Indices.Num();
+    MaxBoxes = FMath::Max(MaxBoxes, Query.Num());
+    NumOrthographic += Record.Region.bOrthographic;
+  }
+
+  // The first path is the reference that the others are compared to.
+  TArray<FReplayPath> Paths;
+  const TPair<const TCHAR*, ESelectionQueryMode> Modes[] = {
+      {TEXT("Frustum"), ESelectionQueryMode::Frustum},
+      {TEXT("ScreenSpace"), ESelectionQueryMode::ScreenSpace},
+      {TEXT("SeparatingAxis"), ESelectionQueryMode::SeparatingAxis},
+  };
+  // Per-box calls, exactly as SelectionRegionOverlapsActor makes them.
+  for (const TPair<const TCHAR*, ESelectionQueryMode>& Mode : Modes) {
+    const ESelectionQueryMode QueryMode = Mode.Value;
+    Paths.Add(FReplayPath{FString::Printf(TEXT("Sphere2 + %s"), Mode.Key),
+                          [QueryMode](const FReplayQuery& Query, TBitArray<>& Selected) {
+                            const FSelectionBoxRecord& Record = *Query.Record;
+                            Selected.Init(false, Query.Num());
+                            for (int32 i = 0; i < Query.Num(); ++i) {
+                              Selected[i] = Lib::SelectionRegionOverlapsSphere2(Record.Planes, Query.SphereCenters[i],
+                                                                                Query.SphereRadii[i]) &&
+                                            Lib::SelectionRegionOverlapsTransformedBoxWithMode(
+                                                Record.Region, Record.Planes, Query.Transforms[i],
+                                                Record.Boxes.Origins[i], Record.Boxes.Extents[i], QueryMode) !=
+                                                ETransformedBoxTestResult::NoIntersection;
+                            }
+                          }});
+  }
+  Paths.Add(FReplayPath{TEXT("SelectionRegionClassifyTransformedBox"),
+                        [](const FReplayQuery& Query, TBitArray<>& Selected) {
+                          const FSelectionBoxRecord& Record = *Query.Record;
+                          Selected.Init(false, Query.Num());
+                          for (int32 i = 0; i < Query.Num(); ++i) {
+                            Selected[i] = Lib::SelectionRegionClassifyTransformedBox(
+                                              Record.Region, Record.Planes, Query.Transforms[i],
+                                              Record.Boxes.Origins[i],
+                                              Record.Boxes.Extents[i]) != ESelectionOverlap::Outside;
+                          }
+                        }});
+
+  // Batch paths:
+  for (const TPair<const TCHAR*, ESelectionQueryMode>& Mode : Modes) {
+    FSelectionQueryOptions Options;
+    Options.Mode = Mode.Value;
+    Paths.Add(FReplayPath{FString::Printf(TEXT("Batch %s"), Mode.Key),
+                          [Options](const FReplayQuery& Query, TBitArray<>& Selected) {
+                            const FSelectionBoxRecord& Record = *Query.Record;
+                            Lib::SelectionRegionOverlapsTransformedBoxBatch(Record.Region, Record.Planes,
+                                                                            Record.Boxes.GetView(), Selected,
+                                                                            Options);
+                          }});
+  }
+  {
+    FSelectionQueryOptions Options;
+    Options.bCameraRelative = true;
+    Paths.Add(FReplayPath{TEXT("Batch Frustum (camera relative)"),
+                          [Options](const FReplayQuery& Query, TBitArray<>& Selected) {
+                            const FSelectionBoxRecord& Record = *Query.Record;
+                            Lib::SelectionRegionOverlapsTransformedBoxBatch(Record.Region, Record.Planes,
+                                                                            Record.Boxes.GetView(), Selected,
+                                                                            Options);
+                          }});
+    Paths.Last().bExact = false;
+  }
+  Paths.Add(FReplayPath{TEXT("BatchParallel Frustum"), [](const FReplayQuery& Query, TBitArray<>& Selected) {
+                          const FSelectionBoxRecord& Record = *Query.Record;
+                          TArray<int32> Indices;
+                          Lib::SelectionRegionOverlapsTransformedBoxBatchParallel(Record.Region, Record.Planes,
+                                                                                  Record.Boxes.GetView(), Indices);
+                          IndicesToBits(Indices, Query.Num(), Selected);
+                        }});
+  // With no limit, the top-K query must select the same boxes, only in a different order.
+  Paths.Add(FReplayPath{TEXT("BatchTopK CameraDepth (unlimited)"),
+                        [](const FReplayQuery& Query, TBitArray<>& Selected) {
+                          const FSelectionBoxRecord& Record = *Query.Record;
+                          TArray<int32> Indices;
+                          Lib::SelectionRegionOverlapsTransformedBoxBatchTopK(
+                              Record.Region, Record.Planes, Record.Boxes.GetView(), Query.Num(),
+                              ESelectionPriority::CameraDepth, {}, Indices);
+                          IndicesToBits(Indices, Query.Num(), Selected);
+                        }});
+  // The query exactly as it was made. Disagreeing with the recording means this build selects differently.
+  Paths.Add(FReplayPath{TEXT("Batch (as recorded)"),
+                        [](const FReplayQuery& Query, TBitArray<>& Selected) {
+                          const FSelectionBoxRecord& Record = *Query.Record;
+                          TArray<int32> Indices;
+                          Lib::SelectionRegionOverlapsTransformedBoxBatch(Record.Region, Record.Planes,
+                                                                          Record.Boxes.GetView(), Indices,
+                                                                          Record.Options);
+                          IndicesToBits(Indices, Query.Num(), Selected);
+                        },
+                        true});
+
+  TBitArray<> Reference;
+  TBitArray<> Selected;
+  for (int32 q = 0; q < Queries.Num(); ++q) {
+    const FReplayQuery& Query = Queries[q];
+    for (int32 p = 0; p < Paths.Num(); ++p) {
+      FReplayPath& Path = Paths[p];
+      Path.Seconds += TimeFastest(Settings.Iterations, [&] { Path.Run(Query, Selected); });
+      Path.NumSelected += Selected.CountSetBits();
+      if (p == 0) {
+        Reference = Selected;
+        continue;
+      }
+      const TBitArray<>& Expected = Path.bCompareToRecording ? Query.Recorded : Reference;
+      int32 NumMismatches = 0;
+      for (int32 i = 0; i < Query.Num(); ++i) {
+        NumMismatches += Selected[i] != Expected[i];
+      }
+      if (NumMismatches > 0) {
+        if (Path.NumQueriesMismatched++ == 0) {
+          Path.FirstMismatch = q;
+        }
+        Path.NumMismatches += NumMismatches;
+      }
+    }
+  }
+
+  // Report:
+  UE_LOG(LogSelectionBoxReplay, Display, TEXT("Recording: %s, %d iterations."), *Settings.FilePath,
+         Settings.Iterations);
+  UE_LOG(LogSelectionBoxReplay, Display,
+         TEXT("  %d queries (%d orthographic), %lld boxes: %.0f per query, at most %d. %.2f%% were selected."),
+         Queries.Num(), NumOrthographic, NumBoxes, static_cast<double>(NumBoxes) / Queries.Num(), MaxBoxes,
+         NumBoxes > 0 ? 100.0 * NumRecordedSelected / NumBoxes : 0.0);
+
+  int32 ReturnCode = 0;
+  FString Csv = TEXT("Path,Seconds,NsPerBox,BoxesPerSec,Selected,Mismatches,QueriesMismatched\n");
+  for (const FReplayPath& Path : Paths) {
+    const double NsPerBox = NumBoxes > 0 ? Path.Seconds * 1.0e9 / NumBoxes : 0;
+    const double BoxesPerSec = Path.Seconds > 0 ? NumBoxes / Path.Seconds : 0;
+    UE_LOG(LogSelectionBoxReplay, Display, TEXT("%-40s %9.2f ns/box %12.0f boxes/sec %10lld selected"), *Path.Name,
+           NsPerBox, BoxesPerSec, Path.NumSelected);
+    if (Path.NumMismatches > 0) {
+      UE_LOG(LogSelectionBoxReplay, Warning,
+             TEXT("%s disagrees with %s on %lld boxes in %d queries, starting with query %d."), *Path.Name,
+             Path.bCompareToRecording ? TEXT("the recording") : *Paths[0].Name, Path.NumMismatches,
+             Path.NumQueriesMismatched, Path.FirstMismatch);
+      if (Path.bExact) {
+        ReturnCode = 1;
+      }
+    }
+    Csv += FString::Printf(TEXT("%s,%.9f,%.3f,%.0f,%lld,%lld,%d\n"), *Path.Name, Path.Seconds, NsPerBox,
+                           BoxesPerSec, Path.NumSelected, Path.NumMismatches, Path.NumQueriesMismatched);
+  }
+
+  if (!Settings.CsvPath.IsEmpty() && !FFileHelper::SaveStringToFile(Csv, *Settings.CsvPath)) {
+    UE_LOG(LogSelectionBoxReplay, Error, TEXT("Failed to write %s"), *Settings.CsvPath);
+    ReturnCode = 1;
+  }
+  return ReturnCode;
+}
@@ -0,0 +1,20 @@
+// Copyright 2021 Gareth Cross.
+#pragma once
+
+#include "CoreMinimal.h"
+
+namespace SelectionBoxTools {
+
+// Run `Body` several times, returning the fastest time in seconds.
+template <typename Func>
+double TimeFastest(const int32 Iterations, Func&& Body) {
+  double Fastest = TNumericLimits<double>::Max();
+  for (int32 i = 0; i < Iterations; ++i) {
+    const uint64 Start = FPlatformTime::Cycles64();
+    Body();
+    Fastest = FMath::Min(Fastest, FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - Start));
+  }
+  return Fastest;
+}
+
+}  // namespace SelectionBoxTools
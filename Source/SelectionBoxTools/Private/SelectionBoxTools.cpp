@@ -0,0 +1,4 @@
+// Copyright 2021 Gareth Cross.
+#include "Modules/ModuleManager.h"
+
+IMPLEMENT_MODULE(FDefaultModuleImpl, SelectionBoxTools)
@@ -0,0 +1,51 @@
+// Copyright 2021 Gareth Cross.
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "SelectionBoxBenchmarkCommandlet.generated.h"
+
+/**
+ * Times every selection query path on a reproducible, randomly generated RTS-style scene: a field of boxes on the
+ * ground, viewed by a tilted camera, with a selection rectangle in the middle of the screen. Needs no rendering,
+ * so it runs on a headless machine:
+ *
+ *   UnrealEditor-Cmd <Project>.uproject -run=SelectionBoxBenchmark -nullrhi -unattended [options]
+ *
+ * Options, with defaults:
+ *   -Seed=1              Random seed. The same seed and options always produce the same scene.
+ *   -Units=20000         Number of boxes.
+ *   -Clusters=0          Group units into this many blobs, like armies. 0 scatters them uniformly.
+ *   -Spread=20000        Half-width (cm) of the square the units are placed in.
+ *   -MinExtent=30        Smallest half-extent (cm) of a box along each axis.
+ *   -MaxExtent=150       Largest half-extent (cm) of a box along each axis.
+ *   -Rotation=Yaw        How boxes are rotated: None, Yaw, or Full (uniformly random orientation).
+ *   -CameraHeight=3000   Height (cm) of the camera above the ground.
+ *   -CameraPitch=-55     Pitch of the camera in degrees (negative looks down).
+ *   -Fov=90              Horizontal field of view in degrees.
+ *   -OrthoWidth=0        If positive, use an orthographic camera that shows this many cm across, instead of -Fov.
+ *   -SelectWidth=0.3     Width of the selection rectangle, as a fraction of the screen.
+ *   -SelectHeight=0.3    Height of the selection rectangle, as a fraction of the screen.
+ *   -TopK=100            Number of boxes selected by the SelectionRegionOverlapsTransformedBoxBatchTopK path.
+ *   -Iterations=10       Times each path is run. The fastest run is reported.
+ *   -Csv=<path>          Also write the results to a CSV file.
+ *
+ * For every path this reports ns/box and boxes/sec, and it breaks down how the frustum test exited, so the
+ * effect of each early-out can be tracked between releases. For perspective cameras, the engine-free TestBox
+ * from SelectionBoxCore.h is also timed with and without its Cohen-Sutherland skip of edges outside a plane, and
+ * the difference is reported.
+ *
+ * Paths that disagree with the frustum test are logged as warnings, and make the commandlet return a non-zero
+ * code. The camera-relative batch path is the exception: it may differ on boxes that touch the region within
+ * float rounding, so its disagreements are only logged. The TopK path selects a subset of the region, so it is
+ * not compared.
+ */
+UCLASS()
+class USelectionBoxBenchmarkCommandlet : public UCommandlet {
+  GENERATED_BODY()
+public:
+  USelectionBoxBenchmarkCommandlet();
+
+  // UCommandlet implementation
+  virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,34 @@
+// Copyright 2021 Gareth Cross.
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "SelectionBoxReplayCommandlet.generated.h"
+
+/**
+ * Runs the selection queries captured by FSelectionBoxRecorder (see `SelectionBox.StartRecording`) through every
+ * query path, so that changes can be measured against what players actually do rather than a synthetic scene.
+ * Needs no rendering, so it runs on a headless machine:
+ *
+ *   UnrealEditor-Cmd <Project>.uproject -run=SelectionBoxReplay -nullrhi -unattended -File=<path> [options]
+ *
+ * Options, with defaults:
+ *   -File=<path>         Recording to replay. Required.
+ *   -Iterations=5        Times each record is run on each path. The fastest run of each record is counted.
+ *   -Csv=<path>          Also write the results to a CSV file.
+ *
+ * For every path this reports the total time, ns/box and boxes/sec over the whole recording. Paths that disagree
+ * with the frustum test on any box are logged as warnings, along with the first record they disagree on. So is a
+ * replay of each query with its recorded options that no longer selects what the recording did. Either makes the
+ * commandlet return a non-zero code, except for the camera-relative path: like in the benchmark, it may disagree on
+ * boxes that touch the region within float rounding, so its disagreements are only logged.
+ */
+UCLASS()
+class USelectionBoxReplayCommandlet : public UCommandlet {
+  GENERATED_BODY()
+public:
+  USelectionBoxReplayCommandlet();
+
+  // UCommandlet implementation
+  virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,27 @@
+// Copyright 2021 Gareth Cross.
+
+using UnrealBuildTool;
+
+public class SelectionBoxTools : ModuleRules
+{
+	public SelectionBoxTools(ReadOnlyTargetRules Target) : base(Target)
+	{
+		PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
+
+		PublicDependencyModuleNames.AddRange(
+			new string[]
+			{
+				"Core",
+				"CoreUObject",
+				"Engine",
+			}
+			);
+
+		PrivateDependencyModuleNames.AddRange(
+			new string[]
+			{
+				"SelectionBox",
+			}
+			);
+	}
+}